@@ -1,8 +1,11 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
+#include "pico/flash.h"
 #include "pico/sync.h"
 #include "tmf8828_app.h"
+#include "tmf8828_gesture.h"
+#include "tmf8828_tracker.h"
 #include "st7789.h"
 #ifndef LED_DELAY_MS
 #define LED_DELAY_MS 250
@@ -80,6 +83,8 @@ int get_random()
 #define SENSOR_HEIGHT_MAX 2000  // 传感器最大高度 (2000mm = 2m)
 #define DISPLAY_HEIGHT_MIN 0
 #define DISPLAY_HEIGHT_MAX 220  // 显示高度范围
+// the hand height is drawn where the tracker predicts it for the time of drawing, at most this far ahead
+#define DISPLAY_PREDICT_MAX_US 100000
 
 
 // Game States
@@ -94,6 +99,9 @@ int get_random()
 #define DIRECTION_RIGHT 2
 #define DIRECTION_UP 3
 #define DIRECTION_DOWN 4
+#define DIRECTION_PUSH 5    // select
+#define DIRECTION_PULL 6    // back
+#define DIRECTION_HOVER 7   // select by holding the hand still, once the hand left after the last state change
 
 // Game parameters
 typedef struct
@@ -108,8 +116,8 @@ typedef struct
     bool option_selected;
     int config_selected_option; // 0-Easy, 1-Medium, 2-Hard
     int last_direction;
-    uint32_t last_direction_time;
-    uint32_t direction_debounce_ms; // Debounce time for direction changes
+    uint32_t last_direction_time;   // capture time (us) of the frame that completed the last gesture
+    bool hover_armed;               // the hand left the sensor since the last state change, a hover may select
 }GAME;
 
 static GAME game = 
@@ -125,9 +133,15 @@ static GAME game =
     .config_selected_option = 0,
     .last_direction = DIRECTION_NONE,
     .last_direction_time = 0,
-    .direction_debounce_ms = 800
+    .hover_armed = false
 };
 
+// A hand still held over the sensor would hover-select right away on the new screen
+static void set_state(int state) {
+    game.state = state;
+    game.hover_armed = false;
+}
+
 // // 动态范围调整参数
 // static struct {
 //     int min_height_seen = SENSOR_HEIGHT_MAX;
@@ -249,7 +263,7 @@ void draw_menu(ST7789* display) {
     // Draw instructions
     uint8_t small_font[] = {0x20, 0x7f, 8, 8, 8};
     display->text(small_font, "Move hand up/down to select", 20, 190, YELLOW, BLACK);
-    display->text(small_font, "Move hand left to select", 20, 210, YELLOW, BLACK);
+    display->text(small_font, "Push or hold still to pick", 20, 210, YELLOW, BLACK);
 }
 
 
@@ -329,14 +343,8 @@ void reset_game() {
 }
 
 
-// Process direction input with debounce
-void process_direction(char direction) {
-    uint32_t current_time = to_ms_since_boot(get_absolute_time());
-    
-    // Debounce direction changes
-    if (current_time - game.last_direction_time < game.direction_debounce_ms) {
-        return;
-    }
+// Process a gesture event, the gesture engine reports each gesture once so there is no debounce
+void process_direction(char direction, uint32_t timestamp) {
     // printf("process direction=%c gamestate=%d gameoption=%d\n",direction,game.state,game.config_selected_option);
     int direction_value = DIRECTION_NONE;
     
@@ -349,12 +357,27 @@ void process_direction(char direction) {
         direction_value = DIRECTION_UP;
     } else if (direction == 'd') {
         direction_value = DIRECTION_DOWN;
+    } else if (direction == GESTURE_EVENT_PUSH) {
+        direction_value = DIRECTION_PUSH;
+    } else if (direction == GESTURE_EVENT_PULL) {
+        direction_value = DIRECTION_PULL;
+    } else if (direction == GESTURE_EVENT_HOVER) {
+        direction_value = DIRECTION_HOVER;
+    } else if (direction == 'U') {      // a double swipe replaces the event of its second swipe
+        direction_value = DIRECTION_DOWN;
+    } else if (direction == 'D') {
+        direction_value = DIRECTION_UP;
+    } else if (direction == 'L') {
+        direction_value = DIRECTION_RIGHT;
+    } else if (direction == 'R') {
+        direction_value = DIRECTION_LEFT;
     }
+    bool select = (direction_value == DIRECTION_PUSH || (direction_value == DIRECTION_HOVER && game.hover_armed));
     
     // Only process if direction changed
     if (direction_value != DIRECTION_NONE) {
         game.last_direction = direction_value;
-        game.last_direction_time = current_time;
+        game.last_direction_time = timestamp;
         
         if (game.state == STATE_MENU) {
             // Toggle between Start and Config
@@ -364,11 +387,11 @@ void process_direction(char direction) {
                 game.selected_option = 1;
             // } else if (direction_value == DIRECTION_LEFT) {
             //     game.selected_option = 1;
-            } else if (direction_value == DIRECTION_LEFT && game.selected_option == 0) {
+            } else if (select && game.selected_option == 0) {
                 reset_game();
-                game.state = STATE_GAME;
-            } else if (direction_value == DIRECTION_LEFT && game.selected_option == 1) {
-                game.state = STATE_CONFIG;
+                set_state(STATE_GAME);
+            } else if (select && game.selected_option == 1) {
+                set_state(STATE_CONFIG);
             }
         } else if (game.state == STATE_CONFIG) {
             // Cycle through difficulty options
@@ -394,8 +417,8 @@ void process_direction(char direction) {
                     game.config_selected_option = 2;
                     game.difficulty = 3;
                 } 
-            } else if (direction_value == DIRECTION_LEFT) {
-                game.state = STATE_MENU;
+            } else if (direction_value == DIRECTION_LEFT || direction_value == DIRECTION_PULL || select) {
+                set_state(STATE_MENU);
             } 
             printf("config_selected_option %d  difficulty %d", game.config_selected_option,game.difficulty);
         } else if (game.state == STATE_GAME_OVER) {
@@ -404,11 +427,11 @@ void process_direction(char direction) {
                 game.selected_option = 0;
             } else if (direction_value == DIRECTION_DOWN) {
                 game.selected_option = 1;
-            } else if (direction_value == DIRECTION_LEFT && game.selected_option == 0) {
+            } else if (select && game.selected_option == 0) {
                 reset_game();
-                game.state = STATE_GAME;
-            } else if (direction_value == DIRECTION_LEFT && game.selected_option == 1) {
-                game.state = STATE_MENU;
+                set_state(STATE_GAME);
+            } else if ((select && game.selected_option == 1) || direction_value == DIRECTION_PULL) {
+                set_state(STATE_MENU);
             }
         }
     }
@@ -458,7 +481,7 @@ void update_game_display(ST7789* display, int mapped_height, int bar_height) {
     {
         game.match_score -= 2;
         if (game.match_score <=0)
-            game.state = STATE_GAME_OVER;
+            set_state(STATE_GAME_OVER);
     }
     
     // Draw sensor height bar
@@ -476,58 +499,74 @@ void update_game_display(ST7789* display, int mapped_height, int bar_height) {
 
 // Shared data structure between cores
 struct SharedHeight {
-    int height;
+    TrackState hand;        // tracked hand, hand.timestamp is the host time (us since boot) of its last frame
+    bool hand_left;         // a frame without close targets came since the last read
     bool new_data_available;
     mutex_t mutex;
 };
 
+// Gesture events from core 1, a few are queued so that a swipe and the double swipe right after it both arrive
+#define GESTURE_QUEUE_LENGTH 8
 struct SharedDirection {
     mutex_t mutex;
-    bool new_data_available;
-    char direction;
+    GestureEvent event[GESTURE_QUEUE_LENGTH];
+    uint8_t head;           // oldest event
+    uint8_t count;
 };
 
 static SharedHeight shared_height;
 static SharedDirection shared_direction;
 
-void update_shared_direction(char direction) {
+// Queue a gesture event, a full queue drops the oldest one
+void update_shared_direction(char direction, uint32_t timestamp) {
     mutex_enter_blocking(&shared_direction.mutex);
-    shared_direction.direction = direction;
-    shared_direction.new_data_available = true;
+    if (shared_direction.count == GESTURE_QUEUE_LENGTH) {
+        shared_direction.head = (shared_direction.head + 1) % GESTURE_QUEUE_LENGTH;
+        shared_direction.count--;
+    }
+    GestureEvent &event = shared_direction.event[(shared_direction.head + shared_direction.count) % GESTURE_QUEUE_LENGTH];
+    event.type = direction;
+    event.timestamp = timestamp;
+    shared_direction.count++;
     mutex_exit(&shared_direction.mutex);
 }
 
-char get_shared_direction(bool *new_data) {
-    char direction;
+// Take the oldest gesture event, new_data tells if there was one
+GestureEvent get_shared_direction(bool *new_data) {
+    GestureEvent event = { GESTURE_EVENT_NONE, 0 };
     mutex_enter_blocking(&shared_direction.mutex);
-    direction = shared_direction.direction;
-    if (new_data) {
-        *new_data = shared_direction.new_data_available;
-        shared_direction.new_data_available = false;
+    *new_data = (shared_direction.count > 0);
+    if (shared_direction.count) {
+        event = shared_direction.event[shared_direction.head];
+        shared_direction.head = (shared_direction.head + 1) % GESTURE_QUEUE_LENGTH;
+        shared_direction.count--;
     }
     mutex_exit(&shared_direction.mutex);
-    return direction;
+    return event;
 }
 
 // Function to safely update the sensor data
-void update_shared_sensor_data(int height) {
+void update_shared_sensor_data(const TrackState &hand, bool close) {
     mutex_enter_blocking(&shared_height.mutex);
-    shared_height.height = height;
+    shared_height.hand = hand;
+    shared_height.hand_left = shared_height.hand_left || !close;
     shared_height.new_data_available = true;
     mutex_exit(&shared_height.mutex);
 }
 
 // Function to safely retrieve the sensor data
-int get_shared_sensor_data(bool *new_data) {
-    int height;
+TrackState get_shared_sensor_data(bool *new_data, bool *hand_left) {
+    TrackState hand;
     mutex_enter_blocking(&shared_height.mutex);
-    height = shared_height.height;
+    hand = shared_height.hand;
+    *hand_left = shared_height.hand_left;
+    shared_height.hand_left = false;
     if (new_data) {
         *new_data = shared_height.new_data_available;
         shared_height.new_data_available = false;
     }
     mutex_exit(&shared_height.mutex);
-    return height;
+    return hand;
 }
 bool core1_separate_stack = true;
 
@@ -538,14 +577,14 @@ void core1_sensor_acquisition() {
         SensorData sensor_data;
         loopFnforTMF882x(&sensor_data);
         // printf("--Core 1: Height: %d, Direction: %c\n", sensor_data.average_height, sensor_data.direction);
-        if (sensor_data.direction != '-') {
-            update_shared_direction(sensor_data.direction);
+        if (sensor_data.gesture != GESTURE_EVENT_NONE) {
+            update_shared_direction(sensor_data.gesture, sensor_data.timestamp);
         }
-        if (sensor_data.valid) {
-            update_shared_sensor_data(sensor_data.average_height);
+        if (sensor_data.timestamp) {        // a frame was processed, also pass on the end of a track
+            update_shared_sensor_data(sensor_data.hand, sensor_data.close);
         }
         // printf("Core 1: Height: %d, Direction: %c\n", sensor_data.average_height, sensor_data.direction);
-        sleep_ms(10);
+        waitForTMF882x();   // sleeps until the sensor interrupt fires (or the poll period in polling mode)
     }
 
 }
@@ -566,7 +605,9 @@ int main() {
     // Initialize the mutex before both cores try to use it
     mutex_init(&shared_height.mutex);
     mutex_init(&shared_direction.mutex);
-    shared_direction.new_data_available = false;
+    shared_direction.head = 0;
+    shared_direction.count = 0;
+    shared_height.hand_left = false;
     shared_height.new_data_available = false;
     
     hard_assert(rc == PICO_OK);
@@ -576,6 +617,7 @@ int main() {
     // Launch Core 1 task for sensor data acquisition
     // We're on Core 0 by default, so launch on Core 1
     multicore_launch_core1(core1_sensor_acquisition);
+    flash_safe_execute_core_init(); // core 1 writes the calibration store, core 0 must park while it erases/programs flash
     sleep_ms(1000); // Give Core 1 time to start up
     printf("Core 0: Core 1 launched\n");
     
@@ -586,24 +628,39 @@ int main() {
     static int mapped_height = 0;
     uint32_t last_debug_time = 0;
     uint32_t current_time = 0;
+    // sensor-to-screen latency: from the capture of a height to the end of the frame that draws it
+    uint32_t height_timestamp = 0;
+    bool height_drawn = true;
+    uint32_t latency_sum = 0;
+    uint32_t latency_max = 0;
+    uint32_t latency_count = 0;
     static GAME last_game = game;
     while (true) {
         current_time = to_ms_since_boot(get_absolute_time());
         
-        // Get sensor data from shared structure
+        // Get sensor data from shared structure, the height is predicted for now as the tracker moves the hand on
         bool new_height = false;
-        int height = get_shared_sensor_data(&new_height);
-        if (new_height) {
-            mapped_height = map_height_to_display(height);
+        bool hand_left = false;
+        TrackState hand = get_shared_sensor_data(&new_height, &hand_left);
+        if (hand_left) {
+            game.hover_armed = true;
+        }
+        if (hand.valid) {
+            mapped_height = map_height_to_display(track_predict(hand, 2, time_us_32(), DISPLAY_PREDICT_MAX_US));
+        }
+        if (new_height && hand.valid) {
+            height_timestamp = hand.timestamp;
+            height_drawn = false;
             // printf("height: %d\n", height);
         }
         
-        // Get direction data from shared structure
+        // Get the gesture events from the shared queue
         bool new_direction = false;
-        char direction = get_shared_direction(&new_direction);
-        if (new_direction) {
-            process_direction(direction);
-            printf("direction: %c\n", direction);
+        GestureEvent event = get_shared_direction(&new_direction);
+        while (new_direction) {
+            process_direction(event.type, event.timestamp);
+            printf("gesture: %c after %lu us\n", event.type, (unsigned long)(time_us_32() - event.timestamp));
+            event = get_shared_direction(&new_direction);
         }
         
         // Update action height for the game
@@ -624,6 +681,15 @@ int main() {
             if(last_game.state != game.state)
                 display->test_pic();
             update_game_display(display, mapped_height, bar_height);
+            if (!height_drawn) {
+                uint32_t latency = time_us_32() - height_timestamp;
+                height_drawn = true;
+                latency_sum += latency;
+                latency_count++;
+                if (latency > latency_max) {
+                    latency_max = latency;
+                }
+            }
             sleep_ms(50);
         }
         if (game.state == STATE_GAME_OVER) 
@@ -650,6 +716,16 @@ int main() {
         //         draw_game_over(display);
         //         break;
         // }
+        // Latency report every 5 seconds: #Lat,<average us>,<max us>,<heights drawn>
+        if (current_time - last_debug_time > 5000) {
+            if (latency_count) {
+                printf("#Lat,%lu,%lu,%lu\n", (unsigned long)(latency_sum / latency_count), (unsigned long)latency_max, (unsigned long)latency_count);
+            }
+            latency_sum = 0;
+            latency_max = 0;
+            latency_count = 0;
+            last_debug_time = current_time;
+        }
         // // Debug output every 5 seconds
         // if (current_time - last_debug_time > 5000) {
         //     printf("Core 0: Game running\n");
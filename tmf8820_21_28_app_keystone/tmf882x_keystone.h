@@ -0,0 +1,158 @@
+/** @file Keystone correction for tmf8820/21/28 zone frames.
+ * Every zone looks along its own ray. The module turns the distance a zone reports into a metric point:
+ * x to the right (growing column), y down (growing row), z along the optical axis, all in mm. The rays 
+ * are the zone centres of the nominal field of view of each SPAD map, the tables are computed by the 
+ * compiler, at run time a point costs three multiply-shifts.
+ */
+
+#ifndef TMF882X_KEYSTONE_H
+#define TMF882X_KEYSTONE_H
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace keystone {
+
+// ---------------------------------------------- types -------------------------------------------
+
+// Unit vector of a zone centre, Q14 (16384 is 1.0)
+struct ZoneRay {
+    int16_t kx;
+    int16_t ky;
+    int16_t kz;
+};
+
+// Metric position of a target
+struct Point {
+    int16_t x;      // mm, to the right
+    int16_t y;      // mm, down
+    uint16_t z;     // mm, along the optical axis (height above the sensor)
+};
+
+// Ray table of one SPAD map, zone index is row * cols + col as in the frame assembler
+struct Map {
+    uint8_t spadMapId;
+    uint8_t rows;
+    uint8_t cols;
+    const ZoneRay *ray;
+};
+
+// ---------------------------------------------- compile time tables -----------------------------
+
+namespace detail {
+
+constexpr double PI = 3.14159265358979323846;
+
+// Series expansions, the zone angles are below 0.5 rad
+constexpr double sin_series(double x) {
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 8; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double cos_series(double x) {
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 8; n++) {
+        term *= -x * x / ((2 * n - 1) * (2 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double sqrt_newton(double v) {
+    double r = v > 1.0 ? v : 1.0;
+    for (int i = 0; i < 30; i++) {
+        r = 0.5 * (r + v / r);
+    }
+    return r;
+}
+
+constexpr int16_t q14(double v) {
+    return static_cast<int16_t>(v * 16384.0 + (v >= 0 ? 0.5 : -0.5));
+}
+
+template <uint8_t Rows, uint8_t Cols>
+struct RayTable {
+    ZoneRay ray[Rows * Cols];
+};
+
+// fovX/fovY: full field of view in degrees, split evenly between the columns/rows
+template <uint8_t Rows, uint8_t Cols>
+constexpr RayTable<Rows, Cols> make_rays(double fovX, double fovY) {
+    RayTable<Rows, Cols> table{};
+    for (int r = 0; r < Rows; r++) {
+        for (int c = 0; c < Cols; c++) {
+            double ax = ((c + 0.5) / Cols - 0.5) * fovX * PI / 180.0;
+            double ay = ((r + 0.5) / Rows - 0.5) * fovY * PI / 180.0;
+            double tx = sin_series(ax) / cos_series(ax);
+            double ty = sin_series(ay) / cos_series(ay);
+            double n = sqrt_newton(tx * tx + ty * ty + 1.0);
+            table.ray[r * Cols + c] = ZoneRay{ q14(tx / n), q14(ty / n), q14(1.0 / n) };
+        }
+    }
+    return table;
+}
+
+// Nominal fields of view (horizontal x vertical) from the SPAD map descriptions
+inline constexpr auto map1 = make_rays<3, 3>(29.0, 29.0);       // 3x3 normal mode
+inline constexpr auto map2 = make_rays<3, 3>(29.0, 43.5);       // 3x3 macro mode
+inline constexpr auto map7 = make_rays<4, 4>(44.0, 48.0);       // 4x4 time-multiplexed normal mode
+inline constexpr auto map15 = make_rays<8, 8>(44.0, 48.0);      // tmf8828 8x8, same SPAD area as map 7
+
+static_assert(map1.ray[4].kx == 0 && map1.ray[4].ky == 0 && map1.ray[4].kz == 16384, "centre zone looks straight ahead");
+static_assert(map7.ray[0].kx == -map7.ray[3].kx && map7.ray[0].ky == -map7.ray[12].ky, "rays are symmetric");
+
+} // namespace detail
+
+inline constexpr Map maps[] = {
+    { 1, 3, 3, detail::map1.ray },
+    { 2, 3, 3, detail::map2.ray },
+    { 7, 4, 4, detail::map7.ray },
+    { 15, 8, 8, detail::map15.ray },
+};
+
+// ---------------------------------------------- functions ---------------------------------------
+
+// Table of the SPAD map. A map without its own table gets the one of a map with the same layout, 
+// nullptr if there is none.
+inline const Map *find_map(uint8_t spadMapId, uint8_t rows, uint8_t cols) {
+    const Map *same_layout = nullptr;
+    for (const Map &m : maps) {
+        if (m.rows != rows || m.cols != cols) {
+            continue;
+        }
+        if (m.spadMapId == spadMapId) {
+            return &m;
+        }
+        if (!same_layout) {
+            same_layout = &m;
+        }
+    }
+    return same_layout;
+}
+
+inline Point project(const Map &map, int zone, uint16_t distance) {
+    const ZoneRay &r = map.ray[zone];
+    int32_t d = distance;
+    return Point{ static_cast<int16_t>((r.kx * d + (1 << 13)) >> 14),
+                  static_cast<int16_t>((r.ky * d + (1 << 13)) >> 14),
+                  static_cast<uint16_t>((r.kz * d + (1 << 13)) >> 14) };
+}
+
+// Projects all zones of one target, distance 0 (no target) gives the point 0/0/0
+inline void project_frame(const Map &map, const uint16_t *distance, Point *points) {
+    for (int zone = 0; zone < map.rows * map.cols; zone++) {
+        points[zone] = project(map, zone, distance[zone]);
+    }
+}
+
+} // namespace keystone
+
+#endif // TMF882X_KEYSTONE_H
@@ -0,0 +1,87 @@
+/* Host benchmark of the descattering filter: microseconds per frame for 3x3, 4x4 and 8x8 frames.
+ * Every frame has a bright near object in a few zones and weak ghosts at its distance in the others.
+ * Usage: descatter_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tmf882x_descatter.h"
+
+#define MAX_ZONES   64
+#define VARIANTS    16      // different frames, cycled through so the branch pattern is not constant
+
+typedef struct
+{
+  uint16_t distance[ TMF882X_DESCATTER_TARGETS ][ MAX_ZONES ];
+  uint8_t confidence[ TMF882X_DESCATTER_TARGETS ][ MAX_ZONES ];
+} zoneFrame;
+
+static zoneFrame input[ VARIANTS ];
+static zoneFrame work;
+
+static void makeFrame ( zoneFrame * f, uint8_t nrZones, unsigned seed )
+{
+  uint16_t object = 150 + seed % 300;
+  uint8_t z;
+  srand( seed );
+  for ( z = 0; z < nrZones; z++ )
+  {
+    if ( z % 5 == seed % 5 )                  // zones that see the object
+    {
+      f->distance[0][z] = object + rand( ) % 10;
+      f->confidence[0][z] = 230 + rand( ) % 25;
+      f->distance[1][z] = 1200 + rand( ) % 300;
+      f->confidence[1][z] = 40 + rand( ) % 40;
+    }
+    else                                      // background plus a ghost at the object distance
+    {
+      f->distance[0][z] = object + rand( ) % 20;
+      f->confidence[0][z] = 20 + rand( ) % 40;
+      f->distance[1][z] = 1200 + rand( ) % 300;
+      f->confidence[1][z] = 60 + rand( ) % 60;
+    }
+  }
+}
+
+static double nowUs ( void )
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void run ( const char * name, uint8_t nrZones, long iterations )
+{
+  tmf882xDescatterFrame frame = { { work.distance[0], work.distance[1] }, { work.confidence[0], work.confidence[1] }, nrZones };
+  unsigned long removed = 0;
+  double start;
+  double elapsed;
+  long i;
+  for ( i = 0; i < VARIANTS; i++ )
+  {
+    makeFrame( &input[i], nrZones, (unsigned)i );
+  }
+  start = nowUs( );
+  for ( i = 0; i < iterations; i++ )
+  {
+    memcpy( &work, &input[ i % VARIANTS ], sizeof( work ) );
+    removed += tmf882xDescatter( &tmf882xDescatterDefaultConfig, &frame );
+  }
+  elapsed = nowUs( ) - start;
+  printf( "%s: %.3f us/frame, %.1f ghosts removed/frame (%ld frames)\n", name, elapsed / iterations, (double)removed / iterations, iterations );
+}
+
+int main ( int argc, char ** argv )
+{
+  long iterations = ( argc > 1 ? atol( argv[1] ) : 1000000 );
+  if ( iterations <= 0 )
+  {
+    iterations = 1;
+  }
+  run( "3x3", 9, iterations );
+  run( "4x4", 16, iterations );
+  run( "8x8", 64, iterations );
+  return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf882x_descatter.h"
+
+// ---------------------------------------------- types -------------------------------------------
+
+typedef struct _aggressor
+{
+  uint16_t low;                             // distance window
+  uint16_t high;
+  uint16_t confidenceLimit;                 // confidence * 256 of a ghost is below this
+  uint8_t zone;
+} aggressor;
+
+// ---------------------------------------------- variables -----------------------------------------
+
+const tmf882xDescatterConfig tmf882xDescatterDefaultConfig =
+{ .aggressorMaxDistanceMm = 600
+, .aggressorMinConfidence = 200
+, .ghostRatioQ8 = 96                        // 0.375
+, .windowMm = 20
+, .windowShift = 4                          // 1/16 of the distance
+};
+
+// ---------------------------------------------- functions -----------------------------------------
+
+// insert the target into the list of the strongest aggressors, sorted by confidence
+static uint8_t descatterAddAggressor ( uint8_t * zone, uint8_t * confidence, uint8_t count, uint8_t z, uint8_t c )
+{
+  uint8_t i = ( count < TMF882X_DESCATTER_MAX_AGGRESSORS ? count : TMF882X_DESCATTER_MAX_AGGRESSORS - 1 );
+  if ( count == TMF882X_DESCATTER_MAX_AGGRESSORS && c <= confidence[i] )
+  {
+    return count;
+  }
+  for ( ; i > 0 && confidence[i-1] < c; i-- )
+  {
+    zone[i] = zone[i-1];
+    confidence[i] = confidence[i-1];
+  }
+  zone[i] = z;
+  confidence[i] = c;
+  return ( count < TMF882X_DESCATTER_MAX_AGGRESSORS ? count + 1 : count );
+}
+
+uint8_t tmf882xDescatter ( const tmf882xDescatterConfig * config, tmf882xDescatterFrame * frame )
+{
+  aggressor agg[ TMF882X_DESCATTER_MAX_AGGRESSORS ];
+  uint8_t aggZone[ TMF882X_DESCATTER_MAX_AGGRESSORS ];
+  uint8_t aggConfidence[ TMF882X_DESCATTER_MAX_AGGRESSORS ];
+  uint16_t * d0 = frame->distance[0];
+  uint16_t * d1 = frame->distance[1];
+  uint8_t * c0 = frame->confidence[0];
+  uint8_t * c1 = frame->confidence[1];
+  uint8_t nrAgg = 0;
+  uint8_t removed = 0;
+  uint8_t z;
+  uint8_t a;
+
+  for ( z = 0; z < frame->nrZones; z++ )        // aggressors are always the first (strongest) target of a zone
+  {
+    if ( d0[z] && d0[z] <= config->aggressorMaxDistanceMm && c0[z] >= config->aggressorMinConfidence )
+    {
+      nrAgg = descatterAddAggressor( aggZone, aggConfidence, nrAgg, z, c0[z] );
+    }
+  }
+  if ( nrAgg == 0 )
+  {
+    return 0;
+  }
+  for ( a = 0; a < nrAgg; a++ )
+  {
+    uint16_t d = d0[ aggZone[a] ];
+    uint16_t w = config->windowMm + ( d >> config->windowShift );
+    agg[a].low = ( d > w ? d - w : 1 );
+    agg[a].high = d + w;
+    agg[a].confidenceLimit = (uint16_t)aggConfidence[a] * config->ghostRatioQ8;
+    agg[a].zone = aggZone[a];
+  }
+
+  for ( z = 0; z < frame->nrZones; z++ )
+  {
+    for ( a = 0; a < nrAgg; a++ )
+    {
+      if ( z == agg[a].zone )
+      {
+        continue;
+      }
+      if ( d1[z] >= agg[a].low && d1[z] <= agg[a].high && ( (uint16_t)c1[z] << 8 ) < agg[a].confidenceLimit )
+      {
+        d1[z] = 0;
+        c1[z] = 0;
+        removed++;
+      }
+      if ( d0[z] >= agg[a].low && d0[z] <= agg[a].high && ( (uint16_t)c0[z] << 8 ) < agg[a].confidenceLimit )
+      {
+        d0[z] = d1[z];                                  // second target moves up
+        c0[z] = c1[z];
+        d1[z] = 0;
+        c1[z] = 0;
+        removed++;
+        a = (uint8_t)-1;                                // the moved up target has to be checked against all aggressors
+      }
+    }
+  }
+  return removed;
+}
+
+void tmf882xDescatterHistogram ( uint32_t * bins, const uint32_t * reference, uint16_t nrBins, uint16_t coefficientQ12 )
+{
+  uint16_t i;
+  for ( i = 0; i < nrBins; i++ )
+  {
+    uint32_t s = (uint32_t)( ( (uint64_t)reference[i] * coefficientQ12 ) >> 12 );
+    bins[i] = ( bins[i] > s ? bins[i] - s : 0 );
+  }
+}
@@ -0,0 +1,99 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+#ifndef TMF882X_DESCATTER_H
+#define TMF882X_DESCATTER_H
+
+/** @file Descattering filter for tmf8820/21/28 zone frames.
+ * A bright object close to the sensor scatters light inside the module and the cover glass into all 
+ * zones. Zones that do not see the object then report a weak ghost target at about the object's 
+ * distance. The filter picks the strongest near targets of a frame as aggressors and removes every 
+ * target in another zone that is at an aggressor's distance (within a window) but much weaker than it.
+ * If the first target of a zone is removed, the second one moves up.
+ * All arithmetic is integer, the cost is zones * targets * aggressors compares.
+ * The histogram variant subtracts a scaled reference (aggressor) histogram from a channel histogram.
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define TMF882X_DESCATTER_MAX_AGGRESSORS      2     /**< strongest near targets checked against */
+#define TMF882X_DESCATTER_TARGETS             2     /**< targets per zone */
+
+// ---------------------------------------------- types -------------------------------------------
+
+/** @brief Filter parameters, see tmf882xDescatterDefaultConfig.
+ */
+typedef struct _tmf882xDescatterConfig
+{
+  uint16_t aggressorMaxDistanceMm;          /**< only targets closer than this can be aggressors */
+  uint8_t aggressorMinConfidence;           /**< only targets with at least this confidence can be aggressors */
+  uint8_t ghostRatioQ8;                     /**< a target is a ghost if its confidence is below aggressor confidence * ratio / 256 */
+  uint16_t windowMm;                        /**< fixed part of the distance window around the aggressor distance */
+  uint8_t windowShift;                      /**< distance dependent part of the window: aggressor distance >> windowShift */
+} tmf882xDescatterConfig;
+
+/** @brief One zone frame, in the layout of the frame assembler: per target an array of distances
+ * and confidences indexed by zone. Distance 0 means no target.
+ */
+typedef struct _tmf882xDescatterFrame
+{
+  uint16_t * distance[ TMF882X_DESCATTER_TARGETS ];     /**< distance in mm per zone */
+  uint8_t * confidence[ TMF882X_DESCATTER_TARGETS ];    /**< confidence per zone */
+  uint8_t nrZones;                                      /**< zones in the frame */
+} tmf882xDescatterFrame;
+
+// ---------------------------------------------- variables -----------------------------------------
+
+/** parameters that suit the tmf882x evaluation module without cover glass */
+extern const tmf882xDescatterConfig tmf882xDescatterDefaultConfig;
+
+// ---------------------------------------------- functions ---------------------------------------
+
+/** @brief Function removes the scattering ghosts from a frame, in place.
+ * @param[in] config ... filter parameters
+ * @param[in,out] frame ... the zone frame
+ * \return number of targets removed
+ */
+uint8_t tmf882xDescatter( const tmf882xDescatterConfig * config, tmf882xDescatterFrame * frame );
+
+/** @brief Function subtracts the scattered part of a reference histogram from a channel histogram, in place.
+ * bin[i] = max( 0, bin[i] - ( reference[i] * coefficientQ12 ) / 4096 )
+ * @param[in,out] bins ... histogram of the channel to be corrected
+ * @param[in] reference ... histogram of the channel that sees the aggressor
+ * @param[in] nrBins ... number of bins of both histograms
+ * @param[in] coefficientQ12 ... scattering coefficient from the reference to this channel, 4096 is 1.0
+ */
+void tmf882xDescatterHistogram( uint32_t * bins, const uint32_t * reference, uint16_t nrBins, uint16_t coefficientQ12 );
+
+#ifdef __cplusplus
+}
+#endif  
+
+#endif // TMF882X_DESCATTER_H
@@ -265,6 +265,9 @@
 #define BL_CMD_W_RAM_TIMEOUT_MS       1
 #define BL_CMD_RAM_REMAP_TIMEOUT_MS   1
 
+// the bootloader handles a RAM write within tens of microseconds, so its status is polled at a finer interval than 1 ms
+#define BL_CMD_POLL_INTERVAL_US       20
+
 // wait time for clock source select change to take effect
 #define CLK_SRC_SELECT_WAIT_MS        1
 // wait for version readout, to switch from ROM to RAM (and have the version published on I2C)
@@ -323,10 +326,8 @@
 
 // -------------------------------------------------------- some checks --------------------------------------------
 
-// check that we can read a complete result page also in the dataBuffer
-#define DATA_BUFFER_SIZE                  (TMF8828_COM_CONFIG_FACTORY_CALIB__factory_calibration_size)
-
-#if ( ( (BL_HEADER + BL_MAX_DATA_PAYLOAD + BL_FOOTER + 1) > DATA_BUFFER_SIZE ) || ( (TMF8828_COM_CONFIG_RESULT__measurement_result_size) > DATA_BUFFER_SIZE ) )
+// check that we can read a complete result page also in the driver->dataBuffer
+#if ( ( (BL_HEADER + BL_MAX_DATA_PAYLOAD + BL_FOOTER + 1) > TMF8828_DATA_BUFFER_SIZE ) || ( (TMF8828_COM_CONFIG_RESULT__measurement_result_size) > TMF8828_DATA_BUFFER_SIZE ) || ( (TMF8828_COM_HISTOGRAM_PACKET_SIZE) > TMF8828_DATA_BUFFER_SIZE ) )
   #error "Increase data buffer size"
 #endif
 
@@ -367,10 +368,6 @@ const tmf8828DeviceInfo tmf8828DeviceInfoReset =
 , .chipVersion = { 0, 0}
 };
 
-// -------------------------------------------------------- variables ----------------------------------------------
-
-uint8_t dataBuffer[ DATA_BUFFER_SIZE ];           // transfer/receive buffer
-
 // -------------------------------------------------------- functions ----------------------------------------------
 
 static void tmf8828ResetClockCorrection( tmf8828Driver * driver );
@@ -402,19 +399,19 @@ void tmf8828ClkCorrection ( tmf8828Driver * driver, uint8_t enable )
 // Function executes a reset of the device 
 void tmf8828Reset ( tmf8828Driver * driver ) 
 {
-  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, dataBuffer );      // read the enable register to determine if chip can handle i2c communication to registers != 0xE0
-  if ( dataBuffer[0] & TMF8828_ENABLE__pon__MASK )  
+  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, driver->dataBuffer );      // read the enable register to determine if chip can handle i2c communication to registers != 0xE0
+  if ( driver->dataBuffer[0] & TMF8828_ENABLE__pon__MASK )  
   {
     // make sure that the PLL is off before performing a reset
-    i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_CLOCK, 1, dataBuffer );
-    dataBuffer[0] &= (TMF8828_CLOCK__pll_on__MASK | TMF8828_CLOCK__enab_pllclk__MASK ); // clear pll as clock source
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_CLOCK, 1, dataBuffer );
+    i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_CLOCK, 1, driver->dataBuffer );
+    driver->dataBuffer[0] &= (TMF8828_CLOCK__pll_on__MASK | TMF8828_CLOCK__enab_pllclk__MASK ); // clear pll as clock source
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_CLOCK, 1, driver->dataBuffer );
     delayInMicroseconds( CLK_SRC_SELECT_WAIT_MS * 1000UL );
-    dataBuffer[0] = 0;
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_CLOCK, 1, dataBuffer );            // switch off pll
+    driver->dataBuffer[0] = 0;
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_CLOCK, 1, driver->dataBuffer );            // switch off pll
  
-  	dataBuffer[0] = TMF8828_RESETREASON__soft_reset__MASK;
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_RESETREASON, 1, dataBuffer );
+  	driver->dataBuffer[0] = TMF8828_RESETREASON__soft_reset__MASK;
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_RESETREASON, 1, driver->dataBuffer );
   	if ( driver->logLevel >=TMF8828_LOG_LEVEL_VERBOSE ) 
   	{
       PRINT_STR( "reset" );
@@ -448,12 +445,12 @@ void tmf8828Disable ( tmf8828Driver * driver )
 // Function checks if the CPU becomes ready within the given time
 int8_t tmf8828IsCpuReady ( tmf8828Driver * driver, uint8_t waitInMs )
 {
-  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, dataBuffer );        // Need to read it twice after a PON=0, so do it 1 additional time 
+  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, driver->dataBuffer );        // Need to read it twice after a PON=0, so do it 1 additional time 
   do 
   {
-    dataBuffer[0] = 0;                                        // clear before reading
-    i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, dataBuffer );      // read the enable register to determine cpu ready
-    if ( !!( dataBuffer[0] & TMF8828_ENABLE__cpu_ready__MASK ) )
+    driver->dataBuffer[0] = 0;                                        // clear before reading
+    i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, driver->dataBuffer );      // read the enable register to determine cpu ready
+    if ( !!( driver->dataBuffer[0] & TMF8828_ENABLE__cpu_ready__MASK ) )
     {
       if ( driver->logLevel >=TMF8828_LOG_LEVEL_VERBOSE )
       {
@@ -480,12 +477,12 @@ int8_t tmf8828IsCpuReady ( tmf8828Driver * driver, uint8_t waitInMs )
 // Function attemps a wakeup of the device 
 void tmf8828Wakeup ( tmf8828Driver * driver ) 
 {
-  dataBuffer[0] = 0;                                         // clear before reading
-  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, dataBuffer );      // read the enable register to dermine power state
-  if ( ( dataBuffer[0] & TMF8828_ENABLE__cpu_ready__MASK ) == 0 )                  
+  driver->dataBuffer[0] = 0;                                         // clear before reading
+  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, driver->dataBuffer );      // read the enable register to dermine power state
+  if ( ( driver->dataBuffer[0] & TMF8828_ENABLE__cpu_ready__MASK ) == 0 )                  
   {
-    dataBuffer[0] = dataBuffer[0] | TMF8828_ENABLE__pon__MASK;      // make sure to keep the remap bits
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, dataBuffer );    // set PON bit in enable register
+    driver->dataBuffer[0] = driver->dataBuffer[0] | TMF8828_ENABLE__pon__MASK;      // make sure to keep the remap bits
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, driver->dataBuffer );    // set PON bit in enable register
     if ( driver->logLevel >=TMF8828_LOG_LEVEL_VERBOSE ) 
     {
       PRINT_STR( "PON=1" );
@@ -497,7 +494,7 @@ void tmf8828Wakeup ( tmf8828Driver * driver )
     if ( driver->logLevel >=TMF8828_LOG_LEVEL_VERBOSE ) 
     {
       PRINT_STR( "awake TMF8828_ENABLE=0x" );
-      PRINT_UINT_HEX( dataBuffer[0] );
+      PRINT_UINT_HEX( driver->dataBuffer[0] );
       PRINT_LN( );
     }  
   }
@@ -506,12 +503,12 @@ void tmf8828Wakeup ( tmf8828Driver * driver )
 // Function puts the device in standby state
 void tmf8828Standby ( tmf8828Driver * driver ) 
 {
-  dataBuffer[0] = 0;                                                   // clear before reading
-  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, dataBuffer );      // read the enable register to determine power state
-  if ( ( dataBuffer[0] & TMF8828_ENABLE__cpu_ready__MASK ) != 0 )                  
+  driver->dataBuffer[0] = 0;                                                   // clear before reading
+  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, driver->dataBuffer );      // read the enable register to determine power state
+  if ( ( driver->dataBuffer[0] & TMF8828_ENABLE__cpu_ready__MASK ) != 0 )                  
   {
-    dataBuffer[0] = dataBuffer[0] & ~TMF8828_ENABLE__pon__MASK;                         // clear only the PON bit
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, dataBuffer );   // clear PON bit in enable register
+    driver->dataBuffer[0] = driver->dataBuffer[0] & ~TMF8828_ENABLE__pon__MASK;                         // clear only the PON bit
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_ENABLE, 1, driver->dataBuffer );   // clear PON bit in enable register
     if ( driver->logLevel >=TMF8828_LOG_LEVEL_VERBOSE ) 
     {
       PRINT_STR( "PON=0" );
@@ -523,31 +520,32 @@ void tmf8828Standby ( tmf8828Driver * driver )
     if ( driver->logLevel >=TMF8828_LOG_LEVEL_VERBOSE ) 
     {
       PRINT_STR( "standby TMF8828_ENABLE=0x" );
-      PRINT_UINT_HEX( dataBuffer[0] );
+      PRINT_UINT_HEX( driver->dataBuffer[0] );
       PRINT_LN( );
     }  
   }
 }
 
-// function to check if a register has a specific value
-static int8_t tmf8828CheckRegister ( tmf8828Driver * driver, uint8_t regAddr, uint8_t expected, uint8_t len, uint16_t timeoutInMs )
+// function to check if a register has a specific value, reads len bytes into buf and polls every pollIntervalInUs
+static int8_t tmf8828PollRegister ( tmf8828Driver * driver, uint8_t regAddr, uint8_t expected, uint8_t len, uint8_t * buf, uint32_t timeoutInUs, uint16_t pollIntervalInUs )
 {
   uint8_t i;
   uint32_t t = getSysTick();
-  do 
+  while ( 1 ) 
   {
-    dataBuffer[0] = ~expected;
-    i2cRxReg( driver, driver->i2cSlaveAddress, regAddr, len, dataBuffer );
-    //printf("dataBuffer[0] = %d expected = %d\n", dataBuffer[0], expected);
-    if ( dataBuffer[0] == expected )
+    buf[0] = ~expected;
+    i2cRxReg( driver, driver->i2cSlaveAddress, regAddr, len, buf );
+    //printf("buf[0] = %d expected = %d\n", buf[0], expected);
+    if ( buf[0] == expected )
     {
       return APP_SUCCESS_OK; 
     }
-    else if ( timeoutInMs )                             // do not wait if timeout is 0
+    if ( getSysTick() - t >= timeoutInUs * HOST_TICKS_PER_US )
     {
-      delayInMicroseconds(1000);  
+      break;
     }
-  } while ( timeoutInMs-- > 0 );
+    delayInMicroseconds( pollIntervalInUs );  
+  }
   if ( driver->logLevel >=TMF8828_LOG_LEVEL_ERROR ) 
   {
     t = getSysTick() - t;
@@ -562,13 +560,19 @@ static int8_t tmf8828CheckRegister ( tmf8828Driver * driver, uint8_t regAddr, ui
     for ( i = 0; i < len; i++ )
     {
       PRINT_STR( " 0x" );
-      PRINT_UINT_HEX( dataBuffer[i] );
+      PRINT_UINT_HEX( buf[i] );
     }
     PRINT_LN( );
   }      
   return APP_ERROR_TIMEOUT;        // error timeout
 }
 
+// function to check if a register has a specific value
+static int8_t tmf8828CheckRegister ( tmf8828Driver * driver, uint8_t regAddr, uint8_t expected, uint8_t len, uint16_t timeoutInMs )
+{
+  return tmf8828PollRegister( driver, regAddr, expected, len, driver->dataBuffer, timeoutInMs * 1000UL, 1000 );
+}
+
 
 // --------------------------------------- bootloader ------------------------------------------
 
@@ -588,33 +592,34 @@ static uint8_t tmf8828BootloaderChecksum ( uint8_t * data, uint8_t len )
 // execute command to set the RAM address pointer for RAM read/writes
 static int8_t tmf8828BootloaderSetRamAddr ( tmf8828Driver * driver, uint16_t addr )
 {
-  dataBuffer[0] = TMF8828_COM_CMD_STAT__bl_cmd_addr_ram;
-  dataBuffer[1] = 2;
-  dataBuffer[2] = (uint8_t)addr;        // LSB of addr
-  dataBuffer[3] = (uint8_t)(addr>>8);    // MSB of addr
-  dataBuffer[4] = tmf8828BootloaderChecksum( dataBuffer, 4 );
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 5, dataBuffer );
-  return tmf8828CheckRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__bl_cmd_ok, 3, BL_CMD_SET_ADDR_TIMEOUT_MS );      // many BL errors only have 3 bytes 
+  driver->dataBuffer[0] = TMF8828_COM_CMD_STAT__bl_cmd_addr_ram;
+  driver->dataBuffer[1] = 2;
+  driver->dataBuffer[2] = (uint8_t)addr;        // LSB of addr
+  driver->dataBuffer[3] = (uint8_t)(addr>>8);    // MSB of addr
+  driver->dataBuffer[4] = tmf8828BootloaderChecksum( driver->dataBuffer, 4 );
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 5, driver->dataBuffer );
+  return tmf8828PollRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__bl_cmd_ok, 3, driver->dataBuffer, BL_CMD_SET_ADDR_TIMEOUT_MS * 1000UL, BL_CMD_POLL_INTERVAL_US );      // many BL errors only have 3 bytes 
 }
 
-// execute command to write a chunk of data to RAM
-static int8_t tmf8828BootloaderWriteRam ( tmf8828Driver * driver, uint8_t len )
+// copy the next chunk of the image into the data buffer and add header and checksum for a RAM write, returns the chunk length
+static uint8_t tmf8828BootloaderPrepareWriteRam ( tmf8828Driver * driver, const uint8_t * image, int32_t remaining )
 {
-  dataBuffer[0] = TMF8828_COM_CMD_STAT__bl_cmd_w_ram;
-  dataBuffer[1] = len;
-  dataBuffer[BL_HEADER+len] = tmf8828BootloaderChecksum( dataBuffer, BL_HEADER+len );
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, BL_HEADER+len+BL_FOOTER, dataBuffer );
-  return tmf8828CheckRegister( driver, TMF8828_COM_CMD_STAT,TMF8828_COM_CMD_STAT__bl_cmd_ok, 3, BL_CMD_W_RAM_TIMEOUT_MS );    // many BL errors only have 3 bytes 
+  uint8_t len = ( remaining > BL_MAX_DATA_PAYLOAD ? BL_MAX_DATA_PAYLOAD : (uint8_t)remaining );
+  driver->dataBuffer[0] = TMF8828_COM_CMD_STAT__bl_cmd_w_ram;
+  driver->dataBuffer[1] = len;
+  readProgramMemory( driver->dataBuffer + BL_HEADER, image, len );                 // one block copy, no per byte access
+  driver->dataBuffer[BL_HEADER+len] = tmf8828BootloaderChecksum( driver->dataBuffer, BL_HEADER+len );
+  return len;
 }
 
 // execute command RAM remap to address 0 and continue running from RAM 
 static int8_t tmf8828BootloaderRamRemap ( tmf8828Driver * driver, uint8_t appId )
 {
   int8_t stat;
-  dataBuffer[0] = TMF8828_COM_CMD_STAT__bl_cmd_ramremap;
-  dataBuffer[1] = 0;
-  dataBuffer[BL_HEADER] = tmf8828BootloaderChecksum( dataBuffer, BL_HEADER );
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, BL_HEADER+BL_FOOTER, dataBuffer );
+  driver->dataBuffer[0] = TMF8828_COM_CMD_STAT__bl_cmd_ramremap;
+  driver->dataBuffer[1] = 0;
+  driver->dataBuffer[BL_HEADER] = tmf8828BootloaderChecksum( driver->dataBuffer, BL_HEADER );
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, BL_HEADER+BL_FOOTER, driver->dataBuffer );
   delayInMicroseconds( APP_PUBLISH_VERSION_WAIT_TIME_MS * 1000 );
   // ram remap -> the bootloader will not answer to this command if successfull, so check the application id register instead
   stat = tmf8828CheckRegister( driver, TMF8828_COM_APP_ID, appId, 4, BL_CMD_RAM_REMAP_TIMEOUT_MS );  // tmf8828 application has 4 verion bytes
@@ -623,13 +628,13 @@ static int8_t tmf8828BootloaderRamRemap ( tmf8828Driver * driver, uint8_t appId
   {
     PRINT_STR( "#Vers" );
     PRINT_CHAR( SEPARATOR );
-    PRINT_INT( dataBuffer[0] );
+    PRINT_INT( driver->dataBuffer[0] );
     PRINT_CHAR(  '.' );
-    PRINT_INT( dataBuffer[1] );
+    PRINT_INT( driver->dataBuffer[1] );
     PRINT_CHAR(  '.' );
-    PRINT_INT( dataBuffer[2] );
+    PRINT_INT( driver->dataBuffer[2] );
     PRINT_CHAR(  '.' );
-    PRINT_INT( dataBuffer[3] );
+    PRINT_INT( driver->dataBuffer[3] );
     PRINT_LN( );
   }
   return stat;
@@ -640,7 +645,7 @@ int8_t tmf8828DownloadFirmware ( tmf8828Driver * driver, uint32_t imageStartAddr
 {
   int32_t idx = 0;
   int8_t stat = BL_SUCCESS_OK;
-  uint8_t chunkLen;
+  uint8_t chunkLen = 0;
   if ( driver->logLevel >=TMF8828_LOG_LEVEL_VERBOSE ) 
   {
     PRINT_STR( "Image addr=0x" );
@@ -657,19 +662,28 @@ int8_t tmf8828DownloadFirmware ( tmf8828Driver * driver, uint32_t imageStartAddr
   }
   stat = tmf8828BootloaderSetRamAddr( driver, imageStartAddress );
   idx = 0;  // start again at the image begin
+  // Pipelined: each chunk is one i2c write of a full bootloader payload. While the bootloader processes it, 
+  // the next chunk is already prepared in the data buffer, so the status is read into a separate buffer.
+  if ( imageSizeInBytes > 0 )
+  {
+    chunkLen = tmf8828BootloaderPrepareWriteRam( driver, image, imageSizeInBytes );
+  }
   while ( stat == BL_SUCCESS_OK && idx < imageSizeInBytes )
   {
+      uint8_t status[3];                                         // many BL errors only have 3 bytes 
       if ( driver->logLevel >=TMF8828_LOG_LEVEL_VERBOSE )
       {
         PRINT_STR( "Download addr=0x" );
         PRINT_UINT_HEX( (uint32_t)idx );
         PRINT_LN( );
       }
-      for( chunkLen=0; chunkLen < BL_MAX_DATA_PAYLOAD && idx < imageSizeInBytes; chunkLen++, idx++ )
+      i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, BL_HEADER+chunkLen+BL_FOOTER, driver->dataBuffer );
+      idx += chunkLen;
+      if ( idx < imageSizeInBytes )
       {
-        dataBuffer[BL_HEADER + chunkLen] = readProgramMemoryByte( (image + idx) );              // read from code memory into local ram buffer
+        chunkLen = tmf8828BootloaderPrepareWriteRam( driver, image + idx, imageSizeInBytes - idx );
       }
-      stat = tmf8828BootloaderWriteRam( driver, chunkLen );
+      stat = tmf8828PollRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__bl_cmd_ok, 3, status, BL_CMD_W_RAM_TIMEOUT_MS * 1000UL, BL_CMD_POLL_INTERVAL_US );
   }
   if ( stat == BL_SUCCESS_OK )
   {
@@ -704,12 +718,22 @@ int8_t tmf8828ReadDeviceInfo ( tmf8828Driver * driver )
   i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_APP_ID, 4, driver->device.appVersion );  // tmf8828 application has 4 verion bytes
   if ( driver->device.appVersion[0] == TMF8828_COM_APP_ID__application )
   {
-    i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_SERIAL_NUMBER_0, 4, dataBuffer );
-    driver->device.deviceSerialNumber = tmf8828GetUint32( &(dataBuffer[0]) );
+    i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_SERIAL_NUMBER_0, 4, driver->dataBuffer );
+    driver->device.deviceSerialNumber = tmf8828GetUint32( &(driver->dataBuffer[0]) );
   }
   return APP_SUCCESS_OK;
 }
 
+// Function checks if the measurement application is already running, e.g. because only the host was reset
+int8_t tmf8828ProbeApplication ( tmf8828Driver * driver )
+{
+  tmf8828ReadDeviceInfo( driver );                      // a device that does not answer leaves the reset values
+  if ( driver->device.appVersion[0] == TMF8828_COM_APP_ID__application )
+  {
+    return APP_SUCCESS_OK;
+  }
+  return APP_ERROR_CMD;
+}
 
 // Reset clock correction calculation
 static void tmf8828ResetClockCorrection ( tmf8828Driver * driver )
@@ -811,8 +835,8 @@ static void tmf8828ClockCorrectionAddPair ( tmf8828Driver * driver, uint32_t hos
 static int8_t tmf8828LoadConfigPage ( tmf8828Driver * driver, uint8_t pageCmd )
 {
   int8_t stat;
-  dataBuffer[0] = pageCmd;
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, dataBuffer );                                                      // instruct device to load page
+  driver->dataBuffer[0] = pageCmd;
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, driver->dataBuffer );                                                      // instruct device to load page
   stat = tmf8828CheckRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__stat_ok, 1, APP_CMD_LOAD_CONFIG_TIMEOUT_MS );  // check that load command is completed
   if ( stat == APP_SUCCESS_OK )
   {
@@ -835,8 +859,8 @@ uint32_t tmf8828GetUint32 ( uint8_t * data )
 int8_t tmf8828WriteConfigPage ( tmf8828Driver * driver )
 {
   int8_t stat;
-  dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_write_config_page;
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, dataBuffer );                                                      // instruct device to load page
+  driver->dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_write_config_page;
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, driver->dataBuffer );                                                      // instruct device to load page
   stat = tmf8828CheckRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__stat_ok, 1, APP_CMD_WRITE_CONFIG_TIMEOUT_MS ); // check that write command is completed
   return stat;
 }
@@ -860,13 +884,13 @@ int8_t tmf8828ChangeI2CAddress ( tmf8828Driver * driver, uint8_t newI2cSlaveAddr
   int8_t stat = tmf8828LoadConfigPageCommon( driver );          // first load the page, then only overwrite the registers you want to change 
   if ( stat == APP_SUCCESS_OK )
   {
-    dataBuffer[0] = newI2cSlaveAddress << 1;          // i2c slave address is shifted into the upper 7 bits of the 8-bit register
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8X2X_COM_I2C_SLAVE_ADDRESS, 1, dataBuffer );
+    driver->dataBuffer[0] = newI2cSlaveAddress << 1;          // i2c slave address is shifted into the upper 7 bits of the 8-bit register
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8X2X_COM_I2C_SLAVE_ADDRESS, 1, driver->dataBuffer );
     stat = tmf8828WriteConfigPage( driver );                 //  write the config page back
     if ( stat == APP_SUCCESS_OK )
     {
-      dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_i2c_slave_address;
-      i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, dataBuffer );      // instruct device to change i2c address
+      driver->dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_i2c_slave_address;
+      i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, driver->dataBuffer );      // instruct device to change i2c address
       driver->i2cSlaveAddress = newI2cSlaveAddress;                                 // from now on try to read from new address
       stat = tmf8828CheckRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__stat_ok, 1, APP_CMD_I2C_SLAVE_ADDRESS_TIMEOUT_MS ); // check that command ok
      }
@@ -893,25 +917,25 @@ static int8_t tmf8828ConfigInternal( tmf8828Driver * driver, uint16_t periodInMs
   stat = tmf8828LoadConfigPageCommon( driver );          // first load the page, then only overwrite the registers you want to change 
   if ( stat == APP_SUCCESS_OK )
   {
-    dataBuffer[0] = (uint8_t)periodInMs;            // lsb
-    dataBuffer[1] = (uint8_t)(periodInMs>>8);       // msb
-    dataBuffer[2] = (uint8_t)kiloIterations;        // lsb  - kilo iterations are right behind the period so we can write with one i2c tx
-    dataBuffer[3] = (uint8_t)(kiloIterations>>8);   // msb
-    dataBuffer[4] = (uint8_t)lowThreshold;          // lsb
-    dataBuffer[5] = (uint8_t)(lowThreshold>>8);     // msb
-    dataBuffer[6] = (uint8_t)highThreshold;         // lsb
-    dataBuffer[7] = (uint8_t)(highThreshold>>8);    // msb
-    dataBuffer[8] = (uint8_t)intMask;               // lsb
-    dataBuffer[9] = (uint8_t)(intMask>>8);          // mid
-    dataBuffer[10] = (uint8_t)(intMask>>16);        // msb
-    dataBuffer[11] = persistence; 
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_PERIOD_MS_LSB, 12, dataBuffer );
-    dataBuffer[0] = spadMapId;                      // spad map ID is a different reg, so use a seperate i2c tx
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_SPAD_MAP_ID, 1, dataBuffer );
-    dataBuffer[0] = dumpHistogram & 0x3;            // only raw histograms and/or EC histograms
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8X2X_COM_HIST_DUMP, 1, dataBuffer );
-    dataBuffer[0] = TMF8828_ENABLE_LOGARITHMIC_CONFIDENCE;                           
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8X2X_COM_ALG_SETTING_0, 1, dataBuffer );
+    driver->dataBuffer[0] = (uint8_t)periodInMs;            // lsb
+    driver->dataBuffer[1] = (uint8_t)(periodInMs>>8);       // msb
+    driver->dataBuffer[2] = (uint8_t)kiloIterations;        // lsb  - kilo iterations are right behind the period so we can write with one i2c tx
+    driver->dataBuffer[3] = (uint8_t)(kiloIterations>>8);   // msb
+    driver->dataBuffer[4] = (uint8_t)lowThreshold;          // lsb
+    driver->dataBuffer[5] = (uint8_t)(lowThreshold>>8);     // msb
+    driver->dataBuffer[6] = (uint8_t)highThreshold;         // lsb
+    driver->dataBuffer[7] = (uint8_t)(highThreshold>>8);    // msb
+    driver->dataBuffer[8] = (uint8_t)intMask;               // lsb
+    driver->dataBuffer[9] = (uint8_t)(intMask>>8);          // mid
+    driver->dataBuffer[10] = (uint8_t)(intMask>>16);        // msb
+    driver->dataBuffer[11] = persistence; 
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_PERIOD_MS_LSB, 12, driver->dataBuffer );
+    driver->dataBuffer[0] = spadMapId;                      // spad map ID is a different reg, so use a seperate i2c tx
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_SPAD_MAP_ID, 1, driver->dataBuffer );
+    driver->dataBuffer[0] = dumpHistogram & 0x3;            // only raw histograms and/or EC histograms
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8X2X_COM_HIST_DUMP, 1, driver->dataBuffer );
+    driver->dataBuffer[0] = TMF8828_ENABLE_LOGARITHMIC_CONFIDENCE;                           
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8X2X_COM_ALG_SETTING_0, 1, driver->dataBuffer );
     stat = tmf8828WriteConfigPage( driver );               // as a last step write the config page back
   }
   if ( stat != APP_SUCCESS_OK )
@@ -931,8 +955,8 @@ static int8_t tmf8828ConfigInternal( tmf8828Driver * driver, uint16_t periodInMs
 // configure device according to given parameters
 int8_t tmf8828Configure ( tmf8828Driver * driver, uint16_t periodInMs, uint16_t kiloIterations, uint8_t spadMapId, uint16_t lowThreshold, uint16_t highThreshold, uint8_t persistence, uint32_t intMask, uint8_t dumpHistogram  )
 {
-  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_TMF8828_MODE, 1, dataBuffer );
-  if ( dataBuffer[0] == TMF8828_COM_TMF8828_MODE__mode__TMF8828 )
+  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_TMF8828_MODE, 1, driver->dataBuffer );
+  if ( driver->dataBuffer[0] == TMF8828_COM_TMF8828_MODE__mode__TMF8828 )
   {
     spadMapId = TMF8828_COM_SPAD_MAP_ID__spad_map_id__map_no_15;	// 8x8 only can work with SPAD map 15, override it for convenience to 15 always
   }
@@ -948,8 +972,8 @@ int8_t tmf8828Configure ( tmf8828Driver * driver, uint16_t periodInMs, uint16_t
 // calibration pages for tmf8828.
 int8_t tmf8828ResetFactoryCalibration ( tmf8828Driver * driver )
 {
-  dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_stat__CMD_RESET_FACTORY_CALIBRATION;
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, dataBuffer );                                 
+  driver->dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_stat__CMD_RESET_FACTORY_CALIBRATION;
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, driver->dataBuffer );                                 
   return tmf8828CheckRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__stat_ok, 1, APP_CMD_WRITE_CONFIG_TIMEOUT_MS ); // check that command is done
 }
 
@@ -957,8 +981,8 @@ int8_t tmf8828ResetFactoryCalibration ( tmf8828Driver * driver )
 int8_t tmf8828FactoryCalibration ( tmf8828Driver * driver )
 {
   int8_t status;
-  dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_factory_calibration;
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, dataBuffer );   
+  driver->dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_factory_calibration;
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, driver->dataBuffer );   
   status = tmf8828CheckRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__stat_ok, 1, APP_CMD_FACTORY_CALIB_TIMEOUT_MS ); // check that factory calib command is done
   return status;
 }
@@ -969,15 +993,15 @@ int8_t tmf8828SetStoredFactoryCalibration ( tmf8828Driver * driver, const uint8_
   int8_t status = tmf8828LoadConfigPageFactoryCalib( driver );
   if ( APP_SUCCESS_OK == status )
   {
-    dataBuffer[0] = readProgramMemoryByte( ( calibPage ) );
-    if ( dataBuffer[0] == TMF8828_COM_CMD_STAT__cmd_load_config_page_factory_calib )
+    driver->dataBuffer[0] = readProgramMemoryByte( ( calibPage ) );
+    if ( driver->dataBuffer[0] == TMF8828_COM_CMD_STAT__cmd_load_config_page_factory_calib )
     {
       for ( uint8_t i = 1; i < TMF8828_COM_CONFIG_FACTORY_CALIB__factory_calibration_size; i++ )
       {
-        dataBuffer[i] = readProgramMemoryByte( ( calibPage + i ) );
+        driver->dataBuffer[i] = readProgramMemoryByte( ( calibPage + i ) );
       }
       // actually write the calibration data
-      i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CONFIG_RESULT, TMF8828_COM_CONFIG_FACTORY_CALIB__factory_calibration_size, dataBuffer );
+      i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CONFIG_RESULT, TMF8828_COM_CONFIG_FACTORY_CALIB__factory_calibration_size, driver->dataBuffer );
       // issue the write page command
       return tmf8828WriteConfigPage( driver );
     }
@@ -993,16 +1017,16 @@ int8_t tmf8828SetStoredFactoryCalibration ( tmf8828Driver * driver, const uint8_
 int8_t tmf8828StartMeasurement ( tmf8828Driver * driver ) 
 {
   tmf8828ResetClockCorrection( driver );                                                                                         // clock correction only works during measurements
-  dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_measure;
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, dataBuffer );                                                      // instruct device to load page
+  driver->dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_measure;
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, driver->dataBuffer );                                                      // instruct device to load page
   return tmf8828CheckRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__stat_accepted, 1, APP_CMD_MEASURE_TIMEOUT_MS ); // check that measure command is accepted
 }
 
 // function stops a measurement
 int8_t tmf8828StopMeasurement ( tmf8828Driver * driver ) 
 {
-  dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_stop;
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, dataBuffer );                                                      // instruct device to load page
+  driver->dataBuffer[0] = TMF8828_COM_CMD_STAT__cmd_stop;
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, driver->dataBuffer );                                                      // instruct device to load page
   return tmf8828CheckRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__stat_ok, 1, APP_CMD_STOP_TIMEOUT_MS );         // check that stop command is accepted
 }
 
@@ -1010,8 +1034,8 @@ int8_t tmf8828StopMeasurement ( tmf8828Driver * driver )
 static int8_t tmf8828SwitchToMode ( tmf8828Driver * driver, uint8_t modeCmd, uint8_t mode )
 {
   int8_t status;
-  dataBuffer[0] = modeCmd;
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, dataBuffer );                                                      // instruct device to load page
+  driver->dataBuffer[0] = modeCmd;
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CMD_STAT, 1, driver->dataBuffer );                                                      // instruct device to load page
   status = tmf8828CheckRegister( driver, TMF8828_COM_CMD_STAT, TMF8828_COM_CMD_STAT__stat_ok, 1, APP_CMD_SWITCH_MODE_CMD_TIMEOUT_MS );         // check that switch command is accepted
   if ( status == APP_SUCCESS_OK )
   {
@@ -1036,13 +1060,13 @@ int8_t tmf8828SwitchToLegacyMode ( tmf8828Driver * driver )
 uint8_t tmf8828GetAndClrInterrupts ( tmf8828Driver * driver, uint8_t mask )
 {
   uint8_t setInterrupts;
-  dataBuffer[0] = 0;
-  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_STATUS, 1, dataBuffer );            // read interrupt status register
-  setInterrupts = dataBuffer[0] & mask;
+  driver->dataBuffer[0] = 0;
+  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_STATUS, 1, driver->dataBuffer );            // read interrupt status register
+  setInterrupts = driver->dataBuffer[0] & mask;
   if ( setInterrupts )
   {
-    dataBuffer[0] = dataBuffer[0] & mask;                             // clear only those that were set when we read the register, and only those we want to know
-    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_STATUS, 1, dataBuffer );       // clear interrupts by pushing a 1 to status register
+    driver->dataBuffer[0] = driver->dataBuffer[0] & mask;                             // clear only those that were set when we read the register, and only those we want to know
+    i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_STATUS, 1, driver->dataBuffer );       // clear interrupts by pushing a 1 to status register
   }
   return setInterrupts;
 }
@@ -1050,56 +1074,61 @@ uint8_t tmf8828GetAndClrInterrupts ( tmf8828Driver * driver, uint8_t mask )
 // function clears and enables the specified interrupts
 void tmf8828ClrAndEnableInterrupts ( tmf8828Driver * driver, uint8_t mask )
 {
-  dataBuffer[0] = 0xFF;                                               // clear all interrupts  
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_STATUS, 1, dataBuffer );         // clear interrupts by pushing a 1 to status register
-  dataBuffer[0] = 0;
-  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_ENAB, 1, dataBuffer );            // read current enabled interrupts 
-  dataBuffer[0] = dataBuffer[0] | mask;                             // enable those in the mask, keep the others if they were enabled
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_ENAB, 1, dataBuffer );
+  driver->dataBuffer[0] = 0xFF;                                               // clear all interrupts  
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_STATUS, 1, driver->dataBuffer );         // clear interrupts by pushing a 1 to status register
+  driver->dataBuffer[0] = 0;
+  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_ENAB, 1, driver->dataBuffer );            // read current enabled interrupts 
+  driver->dataBuffer[0] = driver->dataBuffer[0] | mask;                             // enable those in the mask, keep the others if they were enabled
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_ENAB, 1, driver->dataBuffer );
 }
 
 // function disables the specified interrupts
 void tmf8828DisableInterrupts ( tmf8828Driver * driver, uint8_t mask )
 {
-  dataBuffer[0] = 0;
-  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_ENAB, 1, dataBuffer );            // read current enabled interrupts 
-  dataBuffer[0] = dataBuffer[0] & ~mask;                            // clear only those in the mask, keep the others if they were enabled
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_ENAB, 1, dataBuffer );
-  dataBuffer[0] = mask; 
-  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_STATUS, 1, dataBuffer );         // clear interrupts by pushing a 1 to status register
+  driver->dataBuffer[0] = 0;
+  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_ENAB, 1, driver->dataBuffer );            // read current enabled interrupts 
+  driver->dataBuffer[0] = driver->dataBuffer[0] & ~mask;                            // clear only those in the mask, keep the others if they were enabled
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_ENAB, 1, driver->dataBuffer );
+  driver->dataBuffer[0] = mask; 
+  i2cTxReg( driver, driver->i2cSlaveAddress, TMF8828_INT_STATUS, 1, driver->dataBuffer );         // clear interrupts by pushing a 1 to status register
 }
 
 // function reads the result page (if there is none the function returns an error, else success)
-int8_t tmf8828ReadResults ( tmf8828Driver * driver ) 
+int8_t tmf8828ReadResultPage ( tmf8828Driver * driver ) 
 {
   uint32_t hTick;            // get the sys-tick just before the I2C rx
-  dataBuffer[0] = 0;
+  driver->dataBuffer[0] = 0;
   hTick = getSysTick( );            // get the sys-tick just before the I2C rx
-  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CONFIG_RESULT, TMF8828_COM_CONFIG_RESULT__measurement_result_size, dataBuffer );
-  if ( dataBuffer[0] == TMF8828_COM_CONFIG_RESULT__measurement_result )
+  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CONFIG_RESULT, TMF8828_COM_CONFIG_RESULT__measurement_result_size, driver->dataBuffer );
+  if ( driver->dataBuffer[0] == TMF8828_COM_CONFIG_RESULT__measurement_result )
   {
-    uint32_t tTick = tmf8828GetUint32( dataBuffer + RESULT_REG( SYS_TICK_0 ) );
+    uint32_t tTick = tmf8828GetUint32( driver->dataBuffer + RESULT_REG( SYS_TICK_0 ) );
     tmf8828ClockCorrectionAddPair( driver, hTick, tTick );
-    printResults( driver, dataBuffer, TMF8828_COM_CONFIG_RESULT__measurement_result_size );
     return APP_SUCCESS_OK;
   }
   return APP_ERROR_NO_RESULT_PAGE;
 }
 
+// function reads the result page and prints it
+int8_t tmf8828ReadResults ( tmf8828Driver * driver ) 
+{
+  int8_t res = tmf8828ReadResultPage( driver );
+  if ( res == APP_SUCCESS_OK )
+  {
+    printResults( driver, driver->dataBuffer, TMF8828_COM_CONFIG_RESULT__measurement_result_size );
+  }
+  return res;
+}
+
 int8_t ReadResults( tmf8828Driver* driver, uint8_t* dstBuffer)
 {
-  uint32_t hTick;            // get the sys-tick just before the I2C rx
-  dataBuffer[0] = 0;
-  hTick = getSysTick();            // get the sys-tick just before the I2C rx
-  i2cRxReg(driver, driver->i2cSlaveAddress, TMF8828_COM_CONFIG_RESULT, TMF8828_COM_CONFIG_RESULT__measurement_result_size, dataBuffer);
-  if (dataBuffer[0] == TMF8828_COM_CONFIG_RESULT__measurement_result)
+  int8_t res = tmf8828ReadResultPage(driver);
+  if (res == APP_SUCCESS_OK)
   {
-    uint32_t tTick = tmf8828GetUint32(dataBuffer + RESULT_REG(SYS_TICK_0));
-    tmf8828ClockCorrectionAddPair(driver, hTick, tTick);
-    memcpy(dstBuffer, dataBuffer+24, 27);
-    return APP_SUCCESS_OK;
+    memcpy(dstBuffer, driver->dataBuffer+24, 27);
+    tmf8828CorrectResultRecords( driver, dstBuffer, 9 );
   }
-  return APP_ERROR_NO_RESULT_PAGE;
+  return res;
 }
 
 // Correct the distance based on the clock correction pairs 
@@ -1114,15 +1143,73 @@ uint16_t tmf8828CorrectDistance ( tmf8828Driver * driver, uint16_t distance )
   return distance;
 }
 
+uint32_t tmf8828DeviceTickToHost ( tmf8828Driver * driver, uint32_t tmf8828Tick )
+{
+  uint32_t best = driver->hostTicks[ driver->clkCorrectionIdx ];
+  uint8_t found = 0;
+  uint8_t i;
+  if ( !TMF8828_SYS_TICK_IS_VALID( tmf8828Tick ) )
+  {
+    return best;
+  }
+  for ( i = 0; i < CLK_CORRECTION_PAIRS; i++ )
+  {
+    if ( TMF8828_SYS_TICK_IS_VALID( driver->tmf8828Ticks[ i ] ) )
+    {
+      int32_t deviceUs = (int32_t)( tmf8828Tick - driver->tmf8828Ticks[ i ] ) / TMF8828_TICKS_PER_US;
+      int32_t hostUs = (int32_t)( ( (int64_t)deviceUs * driver->clkCorrRatioUQ ) >> 15 );
+      uint32_t estimate = driver->hostTicks[ i ] + hostUs * HOST_TICKS_PER_US;
+      if ( !found || (int32_t)( estimate - best ) < 0 )
+      {
+        best = estimate;
+        found = 1;
+      }
+    }
+  }
+  return best;
+}
+
+uint16_t tmf8828ClkCorrRatio ( tmf8828Driver * driver )
+{
+  return ( driver->clkCorrectionEnable ? driver->clkCorrRatioUQ : (1<<15) );
+}
+
+// Correct all records with one multiply-shift each, same rounding as tmf8828CorrectDistance
+void tmf8828CorrectResultRecords ( tmf8828Driver * driver, uint8_t * records, uint8_t nrRecords )
+{
+  uint32_t ratio = driver->clkCorrRatioUQ;
+  if ( !driver->clkCorrectionEnable || ratio == (1<<15) )
+  {
+    return;
+  }
+  for ( ; nrRecords; nrRecords--, records += 3 )
+  {
+    uint32_t d = ( (uint32_t)records[2] << 8 ) | records[1];
+    d = ( ratio * d + (1<<14) ) >> 15;
+    d = SATURATE16( d );
+    records[1] = (uint8_t)d;
+    records[2] = (uint8_t)( d >> 8 );
+  }
+}
+
 // Function to read histograms and print them on UART. 
-int8_t tmf8828ReadHistogram ( tmf8828Driver * driver )
+int8_t tmf8828ReadHistogramPacket ( tmf8828Driver * driver )
 {
-  dataBuffer[0] = 0;
-  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CONFIG_RESULT, TMF8828_COM_HISTOGRAM_PACKET_SIZE, dataBuffer );
-  if ( ( dataBuffer[0] & TMF8828_COM_OPTIONAL_SUBPACKET_HEADER_MASK ) == TMF8828_COM_OPTIONAL_SUBPACKET_HEADER_MASK ) // histograms must have MSB set
+  driver->dataBuffer[0] = 0;
+  i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CONFIG_RESULT, TMF8828_COM_HISTOGRAM_PACKET_SIZE, driver->dataBuffer );
+  if ( ( driver->dataBuffer[0] & TMF8828_COM_OPTIONAL_SUBPACKET_HEADER_MASK ) == TMF8828_COM_OPTIONAL_SUBPACKET_HEADER_MASK ) // histograms must have MSB set
   {
-    printHistogram( driver, dataBuffer, TMF8828_COM_HISTOGRAM_PACKET_SIZE );
     return APP_SUCCESS_OK;
   }
   return APP_ERROR_NO_RESULT_PAGE;
 }
+
+int8_t tmf8828ReadHistogram ( tmf8828Driver * driver )
+{
+  int8_t res = tmf8828ReadHistogramPacket( driver );
+  if ( res == APP_SUCCESS_OK )
+  {
+    printHistogram( driver, driver->dataBuffer, TMF8828_COM_HISTOGRAM_PACKET_SIZE );
+  }
+  return res;
+}
@@ -134,6 +134,9 @@ extern "C" {
 #define TMF8828_NUMBER_OF_BINS_PER_CHANNEL                    128       // how many bins are in a raw histogram per channel
 
 
+// every driver instance has its own transfer/receive buffer, large enough for a complete factory calibration page
+#define TMF8828_DATA_BUFFER_SIZE            (TMF8828_COM_CONFIG_FACTORY_CALIB__factory_calibration_size)
+
 // Clock correction pairs must be a power of 2 value.
 #define CLK_CORRECTION_PAIRS                4   // how many clock correction pairs are stored
 
@@ -164,9 +167,15 @@ typedef struct _tmf8828DeviceInfo
   uint8_t chipVersion[2];                           /**< chip version (Id, revId) */
 } tmf8828DeviceInfo;
 
-// Each tmf8828 driver instance needs a data structure like this
+// Each tmf8828 driver instance needs a data structure like this.
+// Thread-safety: the driver has no global mutable state, everything lives in this structure.
+// - one instance must only be used by one context (core, interrupt) at a time
+// - different instances can be used concurrently (e.g. one on core 0, one on core 1) without any 
+//   lock, as long as they are bound to different i2c buses (see platform)
+// - instances that share an i2c bus must be serialised by the caller
 typedef struct _tmf8828Driver
 {
+  tmf8828Platform platform;                         /**< bus and pins of this device, set before tmf8828Initialise, never changed by the driver */
   tmf8828DeviceInfo device;                         /**< information record of device */
   tmf8828DriverInfo info;                           /**< information record of driver */  
   uint32_t hostTicks[ CLK_CORRECTION_PAIRS ];       // host ticks for clock correction
@@ -176,6 +185,7 @@ typedef struct _tmf8828Driver
   uint8_t i2cSlaveAddress;                          // i2c slave address to talk to device
   uint8_t clkCorrectionEnable;                      // default is clock correction on 
   uint8_t logLevel;                                 // how chatty the program is
+  uint8_t dataBuffer[ TMF8828_DATA_BUFFER_SIZE ];   // transfer/receive buffer of this instance
 } tmf8828Driver;
 
 // ---------------------------------------------- functions ---------------------------------------
@@ -243,6 +253,13 @@ int8_t tmf8828DownloadFirmware( tmf8828Driver * driver, uint32_t imageStartAddre
  */ 
 int8_t tmf8828ReadDeviceInfo( tmf8828Driver * driver );
 
+/** @brief Function checks at the current i2c slave address if the measurement application is already running 
+ * (e.g. after a host only reset) and reads the device information. 
+ * @param[in] driver ... pointer to an instance of the tmf8828 driver data structure
+ * @return Function returns APP_SUCCESS_OK if the application answered, else APP_ERROR_CMD
+ */ 
+int8_t tmf8828ProbeApplication( tmf8828Driver * driver );
+
 // Convert 4 bytes in little endian format into an uint32_t  
 uint32_t tmf8828GetUint32( uint8_t * data );
  
@@ -330,6 +347,12 @@ void tmf8828ClrAndEnableInterrupts( tmf8828Driver * driver, uint8_t mask );
 // driver ... pointer to an instance of the tmf8828 driver data structure
 void tmf8828DisableInterrupts( tmf8828Driver * driver, uint8_t mask );
 
+// Function to read the result page into driver->dataBuffer without printing it. This function should only
+// be called when there was a result interrupt. The page stays valid until the next transaction of the driver.
+// driver ... pointer to an instance of the tmf8828 driver data structure
+// Function returns APP_SUCCESS_OK if there was a result page, else APP_ERROR_NO_RESULT_PAGE.
+int8_t tmf8828ReadResultPage( tmf8828Driver * driver );
+
 // Function to read results and print them on UART. This function should only be called when there was a 
 // result interrupt (use function tmf8828GetAndClrInterrupts to find this out). 
 // driver ... pointer to an instance of the tmf8828 driver data structure
@@ -340,11 +363,36 @@ int8_t tmf8828ReadResults( tmf8828Driver * driver );
 // driver ... pointer to an instance of the tmf8828 driver data structure
 uint16_t tmf8828CorrectDistance( tmf8828Driver * driver, uint16_t distance );
 
+// Map a device sys-tick (e.g. SYS_TICK of a result page) to the host sys-tick when it happened. Every stored 
+// clock correction pair gives an estimate: its host tick plus the device time since its device tick, scaled 
+// with the clock correction ratio. The read latency only makes these estimates later, so the earliest one is used.
+// driver ... pointer to an instance of the tmf8828 driver data structure
+// tmf8828Tick ... device sys-tick
+// Function returns the host sys-tick, or the host tick of the last read result page if tmf8828Tick is invalid.
+uint32_t tmf8828DeviceTickToHost( tmf8828Driver * driver, uint32_t tmf8828Tick );
+
+// Clock correction ratio in UQ1.15 the distances have to be multiplied with, 1.0 if clock correction is off.
+// Use this to correct a whole result page in one pass instead of calling tmf8828CorrectDistance per zone.
+// driver ... pointer to an instance of the tmf8828 driver data structure
+uint16_t tmf8828ClkCorrRatio( tmf8828Driver * driver );
+
+// Correct the distances of consecutive result records (confidence, distance LSB, distance MSB) in place
+// driver ... pointer to an instance of the tmf8828 driver data structure
+// records ... pointer to the first record
+// nrRecords ... number of records
+void tmf8828CorrectResultRecords( tmf8828Driver * driver, uint8_t * records, uint8_t nrRecords );
+
 // Function to read histograms and print them on UART. This function should only be calle dwhen there was a 
 // raw histogram interrupt (use function tmf8828GetAndClrInterrupts to find this out). 
 // driver ... pointer to an instance of the tmf8828 driver data structure
 // Function returns APP_SUCCESS_OK if there was a histogram page, else APP_ERROR_NO_RESULT_PAGE.
 int8_t tmf8828ReadHistogram( tmf8828Driver * driver );
+
+// Function to read a histogram packet into driver->dataBuffer without printing it, e.g. for tmf8828HistogramAddPacket. 
+// This function should only be called when there was a raw histogram interrupt.
+// driver ... pointer to an instance of the tmf8828 driver data structure
+// Function returns APP_SUCCESS_OK if there was a histogram packet, else APP_ERROR_NO_RESULT_PAGE.
+int8_t tmf8828ReadHistogramPacket( tmf8828Driver * driver );
 int8_t ReadResults( tmf8828Driver* driver, uint8_t* dstBuffer);
 
 #ifdef __cplusplus
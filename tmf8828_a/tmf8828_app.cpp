@@ -33,10 +33,15 @@
 #include "tmf882x_calib.h"
 #include "tmf8828_image.h"
 #include "tmf882x_image.h"
-#include <deque>
-#include <vector>
-#include <algorithm>
-#include <numeric>
+#include "tmf8828_slope.h"
+#include "tmf8828_direction.h"
+#include "tmf8828_gesture.h"
+#include "tmf8828_tracker.h"
+#include "tmf8828_array.h"
+#include "tmf8828_frame.h"
+#include "tmf8828_calib_store.h"
+#include "tmf882x_descatter.h"
+#include "tmf882x_keystone.h"
 #include <cmath>
 
 // ---------------------------------------------- defines -----------------------------------------
@@ -57,8 +62,90 @@
 // number of register that are printed in the dump on one line
 #define NR_REGS_PER_LINE        8
 
-// number of TMF8828 instances
+// number of TMF8828 instances, each needs an entry in tmf8828Platforms
+#ifndef NR_OF_TMF8828
 #define NR_OF_TMF8828   1
+#endif
+
+// set to 1 on a TMF8828 to run the game on the 8x8 zone map, else the tmf882x image with the 3x3 map is used.
+// An 8x8 frame takes 4 sub-captures of configPeriod[1] (132 ms), about 2 frames/s: the height follows, but
+// swipes pass within a frame or two and are not detected (tmf8828_host_gesture_bench -g 8 -f 2 finds none).
+#ifndef GAME_8X8_MODE
+#define GAME_8X8_MODE           0
+#endif
+// zones with a confidence up to this are ignored
+#define GESTURE_MIN_CONFIDENCE  100
+// which of the two targets per zone the height and gesture detection use, see TargetSelect
+#ifndef GESTURE_TARGET_SELECT
+#define GESTURE_TARGET_SELECT   TARGET_NEAREST
+#endif
+// how the close targets of a frame are combined into the position for the direction detection, see CentroidMode
+#ifndef GESTURE_CENTROID
+#define GESTURE_CENTROID        CENTROID_WEIGHTED
+#endif
+// number of frames with a close object kept for the direction detection
+#define GESTURE_HISTORY_FRAMES  20
+// only objects closer than this are used for direction detection (mm)
+#define GESTURE_MAX_DISTANCE    100
+// the centroid has to move at least this far per frame to count as a direction (mm)
+#define GESTURE_MIN_SLOPE_MM    1.2f
+// the direction regression works on centroids in fixed point, 1/GESTURE_POS_SCALE mm
+#define GESTURE_POS_SCALE       16
+// the direction filter votes over at most this many frames, the window of the selected filter set has to fit
+#define GESTURE_FILTER_SLOTS    16
+// gesture events, see tmf8828_gesture.h: timing windows (ms), distances (mm) and the close frames kept for push and pull
+#define GESTURE_SWIPE_WINDOW_MS   300
+#define GESTURE_DOUBLE_WINDOW_MS  700
+#define GESTURE_PUSH_WINDOW_MS    400
+#define GESTURE_HOVER_DWELL_MS    1000
+#define GESTURE_PUSH_DISTANCE     25
+#define GESTURE_HOVER_RADIUS      12
+#define GESTURE_EVENT_FRAMES      16
+// hand tracker, see tmf8828_tracker.h: alpha and beta gains in 1/256, a track ends after GAME_TRACK_TIMEOUT_MS 
+// without a valid frame and restarts on a jump of more than GAME_TRACK_GATE mm
+#ifndef GAME_TRACK_ALPHA
+#define GAME_TRACK_ALPHA          128
+#endif
+#ifndef GAME_TRACK_BETA
+#define GAME_TRACK_BETA           32
+#endif
+#define GAME_TRACK_TIMEOUT_MS     300
+#define GAME_TRACK_GATE           150
+// set to 0 to feed the gesture detection with the unfiltered frames, i.e. including the scattering ghosts of near objects
+#ifndef GAME_DESCATTER
+#define GAME_DESCATTER          1
+#endif
+
+// in polling mode the interrupt status is read every xx ms
+#define POLL_PERIOD_MS          10
+// in interrupt mode, read the interrupt status at least every xx ms, in case an edge got lost
+#define IRQ_WAIT_TIMEOUT_MS     1000
+// the sensor array frame rates and the i2c statistics are printed every xx ms while measuring, 0 to switch off
+#define ARRAY_REPORT_PERIOD_MS  10000
+
+// adaptive rate: measure with the slow idle configuration until something comes close, then with the game 
+// configuration (configPeriod/configKiloIter) until nothing was close for RATE_ACTIVE_HOLD_MS. Set to 0 to 
+// always use the game configuration.
+#ifndef ADAPTIVE_RATE
+#define ADAPTIVE_RATE           1
+#endif
+#define RATE_IDLE_PERIOD_MS     250
+#define RATE_IDLE_KILO_ITER     128
+// a target closer than this (mm) counts as someone interacting
+#define RATE_PRESENCE_DISTANCE  400
+#define RATE_ACTIVE_HOLD_MS     3000
+
+// set to 1 to write every result page as a binary record to the USB CDC (see tmf8828_record.h), 
+// recordTMF882x switches it at runtime
+#ifndef GAME_RECORD
+#define GAME_RECORD             0
+#endif
+// set to 1 to run the game on records received on the USB CDC instead of on the devices
+#ifndef GAME_REPLAY
+#define GAME_REPLAY             0
+#endif
+// while no record is received the replay sleeps for this long
+#define REPLAY_IDLE_MS          1
 
 // ---------------------------------------------- constants -----------------------------------------
 
@@ -103,16 +190,49 @@ const uint16_t configHighThreshold = 500;
 const uint8_t configPersistance[3] = { 0, 1, 3 }; 
 // interrupt selection mask is 18-bits, if bit is set, zone can report an interrupt
 const uint32_t configInterruptMask = 0x3FFFF; 
+// direction filter sets: window of votes, equal votes in a row before a direction is reported, votes a new direction needs ahead of the current one
+const uint8_t configDirectionFilter[3][3] =
+{ { 5, 2, 0 }
+, { 9, 3, 2 }
+, { 3, 1, 0 }
+};
+
+// bus and pins of the tmf8828 instances, the first NR_OF_TMF8828 entries are used
+const tmf8828Platform tmf8828Platforms[] =
+{ TMF8828_PLATFORM_DEFAULT
+, TMF8828_PLATFORM_ALT
+};
+
+#if ( NR_OF_TMF8828 > 2 || NR_OF_TMF8828 > TMF8828_ARRAY_MAX_SENSORS )
+#error "add the bus and pins of the additional devices to tmf8828Platforms"
+#endif
 
 // ---------------------------------------------- variables -----------------------------------------
 
 
 tmf8828Driver tmf8828[NR_OF_TMF8828]; // instances of tmf8828
+tmf8828Array sensorArray;         // all instances when measuring for the game
+tmf8828HistogramCapture histogramCapture;   // histograms of the first device, streamed as binary records
+uint32_t bootStartTick;           // sys-tick when setupforTMF882x was entered
+uint32_t bootEnableUs;            // time to enable the devices and download the firmware
+uint32_t bootStartUs;             // time until the measurement was started
+uint8_t bootWarm;                 // the devices were taken over from before the host reset, no download
+uint8_t rateFast = !ADAPTIVE_RATE;  // measuring with the game configuration, else with the idle one
+uint32_t ratePresenceTick;        // sys-tick of the last frame with a close target
+uint32_t rateSwitches;            // number of rate changes
+uint32_t rateSwitchMaxUs;         // longest stop-configure-start of a rate change
+uint8_t bootReported;             // the boot time is printed once, with the first frame
+uint32_t gestureCalls;            // direction updates since the last statistics report
+uint32_t gestureCycles;           // core clock cycles they took, see getCycleCount
+uint32_t gestureMaxCycles;        // longest direction update
+tmf8828RecordParser replayParser;  // finds the records in the USB CDC input when replaying
+uint8_t replayIdle;               // the last replay round found no input
 uint8_t logLevel;                 // how chatty the program is 
 int8_t stateTmf8828;              // current state of the device 
 int8_t modeIsTmf8828;             // if set to 1 this is the tmf8828 else this is the tmf882x
 int8_t configNr;                  // this sample application has only a few configurations it will loop through, the variable keeps track of that
 int8_t persistenceNr;             // this is to keep track of the selected persistence setting (out of three for this sample application)
+int8_t directionFilterNr;         // selected direction filter set
 int8_t clkCorrectionOn;           // if non-zero clock correction is on
 int8_t dumpHistogramOn;           // if non-zero, dump all histograms
 uint8_t logLevelIdx;              // log level indes into logLevels array
@@ -125,6 +245,7 @@ void printHelp();
 void printRegisters( uint8_t regAddr, uint16_t len, char seperator, uint8_t calibId );
 void resetAppState();
 void setMode();
+void directionFilter();
 
 // ---------------------------------------------- functions -----------------------------------------
 
@@ -163,10 +284,82 @@ void clockCorrection ( )
   PRINT_LN( );
 }
 
+// configure the given device with the current configuration
+static int8_t configureDeviceRate ( tmf8828Driver * driver, uint16_t periodInMs, uint16_t kiloIterations )
+{
+  return tmf8828Configure( driver, periodInMs, kiloIterations, configSpadId[modeIsTmf8828][configNr], configLowThreshold, configHighThreshold, configPersistance[persistenceNr], configInterruptMask, dumpHistogramOn );
+}
+
+static int8_t configureDevice ( tmf8828Driver * driver )
+{
+  return configureDeviceRate( driver, configPeriod[modeIsTmf8828][configNr], configKiloIter[modeIsTmf8828][configNr] );
+}
+
+// configure a device of the array for the current rate
+static int8_t configureArrayDevice ( tmf8828Driver * driver )
+{
+  if ( rateFast )
+  {
+    return configureDevice( driver );
+  }
+  return configureDeviceRate( driver, RATE_IDLE_PERIOD_MS, RATE_IDLE_KILO_ITER );
+}
+
+// factory calibration pages per SPAD map: 4 in 8x8 mode, 1 in legacy mode
+static uint8_t calibPageCount ( )
+{
+  return ( modeIsTmf8828 ? TMF8828_CALIB_STORE_MAX_PAGES : 1 );
+}
+
+// load the calibration of this device from the flash store, if the store has one for the configured SPAD map
+static void loadStoredCalibration ( tmf8828Driver * driver )
+{
+  int8_t res = tmf8828CalibStoreLoadDevice( driver, configSpadId[modeIsTmf8828][configNr], calibPageCount( ) );
+  if ( res == APP_SUCCESS_OK )
+  {
+    PRINT_CONST_STR( (  "Flash cal" ) );
+    PRINT_LN( );
+  }
+  else if ( res != APP_ERROR_NO_CALIB_PAGE )
+  {
+    PRINT_CONST_STR( (  "#Err" ) );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_CONST_STR( (  "flashCal" ) );
+    PRINT_LN( );
+  }
+}
+
+// configure a device of the array and give it its calibration, at startup and when the array recovers it
+static int8_t setupArrayDevice ( tmf8828Driver * driver )
+{
+  int8_t res = configureArrayDevice( driver );
+  if ( res == APP_SUCCESS_OK )
+  {
+    loadStoredCalibration( driver );
+  }
+  return res;
+}
+
+// keep the calibration that was just done in the flash store
+static void saveStoredCalibration ( tmf8828Driver * driver )
+{
+  if ( tmf8828CalibStoreSaveDevice( driver, configSpadId[modeIsTmf8828][configNr], calibPageCount( ) ) == APP_SUCCESS_OK )
+  {
+    PRINT_CONST_STR( (  "Saved cal" ) );
+  }
+  else
+  {
+    PRINT_CONST_STR( (  "#Err" ) );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_CONST_STR( (  "saveCal" ) );
+  }
+  PRINT_LN( );
+}
+
 // wrap through the available configurations and configure the device accordingly.
 void configure ( )
 {
-  if ( tmf8828Configure( &(tmf8828[0]), configPeriod[modeIsTmf8828][configNr], configKiloIter[modeIsTmf8828][configNr], configSpadId[modeIsTmf8828][configNr], configLowThreshold, configHighThreshold, configPersistance[persistenceNr], configInterruptMask, dumpHistogramOn ) == APP_SUCCESS_OK )
+  if ( configureDevice( &(tmf8828[0]) ) == APP_SUCCESS_OK )
   {
     PRINT_CONST_STR( (  "#Conf" ) );
     PRINT_CHAR( SEPARATOR );
@@ -214,6 +407,7 @@ void enable ( uint32_t imageStartAddress, const unsigned char * image, int32_t i
         printHelp(); // prints on UART usage and waits for user input on serial
         tmf8828ReadDeviceInfo( &(tmf8828[0]) );
         printDeviceInfo( );
+        loadStoredCalibration( &(tmf8828[0]) );
       }
       else
       {
@@ -233,6 +427,28 @@ void enable ( uint32_t imageStartAddress, const unsigned char * image, int32_t i
   }
 }
 
+// factory calibration of one device, saved in the flash store. Leaves the device in the calibration configuration.
+static int8_t calibrateDevice ( tmf8828Driver * driver )
+{
+  int8_t res;
+  uint8_t i;
+  tmf8828Configure( driver, 1, 4000, configSpadId[modeIsTmf8828][configNr], 0, 0xffff, 0, 0x3ffff, 0 );    // no histogram dumping in factory calibration allowed, 4M iterations for factory calibration recommended
+  if ( modeIsTmf8828 )
+  {
+    tmf8828ResetFactoryCalibration( driver );
+  }
+  res = tmf8828FactoryCalibration( driver );
+  for ( i = 1; modeIsTmf8828 && i < 4 && res == APP_SUCCESS_OK; i++ )      // walk through all 4 calibration
+  {
+    res = tmf8828FactoryCalibration( driver );
+  }
+  if ( res == APP_SUCCESS_OK )
+  {
+    saveStoredCalibration( driver );
+  }
+  return res;
+}
+
 // execute factory calibration in state stopped only
 void factoryCalibration ( )
 {
@@ -240,27 +456,10 @@ void factoryCalibration ( )
   {
     PRINT_CONST_STR( (  "Fact Cal" ) );
     PRINT_LN( );
-    tmf8828Configure( &(tmf8828[0]), 1, 4000, configSpadId[modeIsTmf8828][configNr], 0, 0xffff, 0, 0x3ffff, 0 );    // no histogram dumping in factory calibration allowed, 4M iterations for factory calibration recommended
-    if ( modeIsTmf8828 )
+    if ( calibrateDevice( &(tmf8828[0]) ) == APP_SUCCESS_OK )
     {
-      tmf8828ResetFactoryCalibration( &(tmf8828[0]) );
-      if (  APP_SUCCESS_OK == tmf8828FactoryCalibration( &(tmf8828[0]) ) // walk through all 4 calibration 
-         && APP_SUCCESS_OK == tmf8828FactoryCalibration( &(tmf8828[0]) ) 
-         && APP_SUCCESS_OK == tmf8828FactoryCalibration( &(tmf8828[0]) ) 
-         && APP_SUCCESS_OK == tmf8828FactoryCalibration( &(tmf8828[0]) ) 
-         )
-      {
-        configure( );
-        return;
-      }
-    }
-    else 
-    {
-      if ( APP_SUCCESS_OK == tmf8828FactoryCalibration( &(tmf8828[0]) ) ) 
-      {
-        configure( );
-        return;
-      }
+      configure( );
+      return;
     }
     PRINT_CONST_STR( (  "#Err" ) );
     PRINT_CHAR( SEPARATOR );
@@ -377,6 +576,123 @@ void logLevelInc ( )
   PRINT_LN( );
 }
 
+// print the i2c bus statistics: #I2C,<transactions>,<bytes>,<bytes/s while busy>,<cpu busy in %>
+void printI2cStatistics ( )
+{
+  i2cStatistics stats;
+  i2cGetStatistics( &(tmf8828[0]), &stats );
+  PRINT_CONST_STR( (  "#I2C" ) );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( stats.transactions );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( stats.bytes );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( stats.busTimeUs ? (uint32_t)( ( 1000000ull * stats.bytes ) / stats.busTimeUs ) : 0 );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( stats.busTimeUs ? (uint32_t)( ( 100ull * stats.cpuBusyTimeUs ) / stats.busTimeUs ) : 0 );
+  PRINT_LN( );
+  i2cResetStatistics( &(tmf8828[0]) );
+}
+
+// print the frame rates of the sensor array: #ARR,<running mask>,<merged frames/s>,<frames/s of all devices>,<torn frames>
+void printArrayStatistics ( )
+{
+  tmf8828ArrayStatistics stats;
+  tmf8828ArrayGetStatistics( &sensorArray, &stats );
+  PRINT_CONST_STR( (  "#ARR" ) );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT_HEX( sensorArray.activeMask );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( stats.frameFpsX10 / 10 ); PRINT_CHAR( '.' ); PRINT_UINT( stats.frameFpsX10 % 10 );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( stats.aggregateFpsX10 / 10 ); PRINT_CHAR( '.' ); PRINT_UINT( stats.aggregateFpsX10 % 10 );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( stats.torn );
+  PRINT_LN( );
+  tmf8828ArrayResetStatistics( &sensorArray );
+  PRINT_CONST_STR( (  "#Gesture" ) );             // #Gesture,<direction updates>,<avg cycles>,<max cycles>
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( gestureCalls );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( gestureCalls ? gestureCycles / gestureCalls : 0 );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( gestureMaxCycles );
+  PRINT_LN( );
+  gestureCalls = 0;
+  gestureCycles = 0;
+  gestureMaxCycles = 0;
+}
+
+#if ADAPTIVE_RATE && !GAME_REPLAY
+// Switch all devices of the array between idle and game configuration. The devices have to be stopped
+// for this, the cost (bounded by the driver command timeouts) is printed: #Rate,<fast>,<us>,<max us>,<switches>
+static void setRate ( uint8_t fast )
+{
+  uint32_t start = getSysTick( );
+  uint32_t us;
+  uint8_t i;
+  rateFast = fast;
+  tmf8828ArrayStop( &sensorArray );
+  for ( i = 0; i < NR_OF_TMF8828; i++ )
+  {
+    if ( ( sensorArray.activeMask & ( 1 << i ) ) && configureArrayDevice( &(tmf8828[i]) ) != APP_SUCCESS_OK )
+    {
+      PRINT_CONST_STR( (  "#Err" ) );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_CONST_STR( (  "Rate" ) );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_INT( i );
+      PRINT_LN( );
+    }
+  }
+  if ( !tmf8828ArrayStart( &sensorArray, configSpadId[modeIsTmf8828][configNr] ) )
+  {
+    stateTmf8828 = TMF8828_STATE_STOPPED;
+  }
+  us = ( getSysTick( ) - start ) / HOST_TICKS_PER_US;
+  rateSwitches++;
+  if ( us > rateSwitchMaxUs )
+  {
+    rateSwitchMaxUs = us;
+  }
+  PRINT_CONST_STR( (  "#Rate" ) );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( fast );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( us );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( rateSwitchMaxUs );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( rateSwitches );
+  PRINT_LN( );
+}
+#endif
+
+// print the startup benchmark: #Boot,<ms to enable devices and download fw>,<ms to measurement start>,<ms to first frame>
+void printBootTime ( uint32_t firstFrameTick )
+{
+  PRINT_CONST_STR( (  "#Boot" ) );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( bootEnableUs / 1000 );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( bootStartUs / 1000 );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_UINT( ( firstFrameTick - bootStartTick ) / ( 1000 * HOST_TICKS_PER_US ) );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_CONST_STR( ( bootWarm ? "warm" : "cold" ) );
+  PRINT_LN( );
+}
+
+// write all complete histograms as binary records
+void streamHistograms ( )
+{
+  const tmf8828Histogram * h;
+  while ( ( h = tmf8828HistogramTake( &histogramCapture ) ) )
+  {
+    tmf8828HistogramStream( h );
+  }
+}
+
 // start measurement
 void measure ( )
 {
@@ -629,11 +945,13 @@ void printHelp ( )
   PRINT_CONST_STR( (  "TMF8828 Arduino Driver" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "UART commands" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "a ... dump registers" ) );
+  PRINT_LN( ); PRINT_CONST_STR( (  "b ... i2c bus statistics" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "c ... next configuration" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "d ... disable device" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "e ... enable device and download TMF8828 FW" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "E ... enable device and download TMF8821 FW" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "f ... do fact calib" ) );
+  PRINT_LN( ); PRINT_CONST_STR( (  "g ... next direction filter set" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "h ... help " ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "i ... i2c addr. change" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "l ... load fact calib" ) );
@@ -645,6 +963,7 @@ void printHelp ( )
   PRINT_LN( ); PRINT_CONST_STR( (  "t ... next persistance set" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "w ... wakeup" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "x ... clock corr on/off" ) );
+  PRINT_LN( ); PRINT_CONST_STR( (  "y ... sensor array frame rates" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "z ... histogram" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "+ ... log+" ) );
   PRINT_LN( ); PRINT_CONST_STR( (  "- ... log-" ) );
@@ -713,6 +1032,10 @@ int8_t serialInput ( )
       {  
         factoryCalibration( );
       }
+      else if ( rx == 'g' )
+      {
+        directionFilter( );
+      }
       else if ( rx == 'l' )
       {  
         loadFactoryCalibration( );
@@ -732,10 +1055,18 @@ int8_t serialInput ( )
           printRegisters( 0x00, 256, ' ', 0 );  
         }
       }
+      else if ( rx == 'b' )
+      {
+        printI2cStatistics( );
+      }
       else if ( rx == 'x' )
       {
         clockCorrection( );
       }
+      else if ( rx == 'y' )
+      {
+        printArrayStatistics( );
+      }
       else if ( rx == 'i' )
       {
           changeI2CAddress( );
@@ -782,90 +1113,191 @@ void resetAppState ( )
   persistenceNr = 0;
   clkCorrectionOn = 1;
   dumpHistogramOn = 0; // default is off
+  tmf8828HistogramInitialise( &histogramCapture );
   irqTriggered = 0;
   modeIsTmf8828 = 1;  // default is tmf8828
 }
 
 // interrupt handler is called when INT pin goes low
-void interruptHandler ( void )
+void interruptHandler ( void * dptr, void * context )
 {
+  (void)dptr;
+  (void)context;
   irqTriggered = 1;
 }
 
 // -------------------------------------------------------------------------------------------------------------
 
 // Arduino setup function is only called once at startup. Do all the HW initialisation stuff here.
-void setupFn( uint8_t logLevelIdx, uint32_t baudrate, uint32_t i2cClockSpeedInHz )
+// Open serial and the driver instances of all devices, leaves the enable lines as they are.
+static void openDevices( uint8_t logLevelIdx, uint32_t baudrate, uint32_t i2cClockSpeedInHz )
 {
+  uint8_t i;
   logLevel = logLevelIdx;                                            
 
-  configurePins( &(tmf8828[0]) );
-
-  // start serial and i2c
+  // start serial
   inputOpen( baudrate );
-  i2cOpen( &(tmf8828[0]), i2cClockSpeedInHz );
-
   resetAppState( );
-  tmf8828Initialise( &(tmf8828[0]) );
-  tmf8828SetLogLevel( &(tmf8828[0]), logLevels[ logLevelIdx ] );
-  setInterruptHandler( interruptHandler );
-  tmf8828Disable( &(tmf8828[0]) );                                     // this resets the I2C address in the device
+
+  for ( i = 0; i < NR_OF_TMF8828; i++ )
+  {
+    tmf8828[i].platform = tmf8828Platforms[i];
+    configurePins( &(tmf8828[i]) );
+    i2cOpen( &(tmf8828[i]), i2cClockSpeedInHz );
+    tmf8828Initialise( &(tmf8828[i]) );
+    tmf8828SetLogLevel( &(tmf8828[i]), logLevels[ logLevelIdx ] );
+  }
+}
+
+void setupFn( uint8_t logLevelIdx, uint32_t baudrate, uint32_t i2cClockSpeedInHz )
+{
+  uint8_t i;
+  openDevices( logLevelIdx, baudrate, i2cClockSpeedInHz );
+  for ( i = 0; i < NR_OF_TMF8828; i++ )
+  {
+    tmf8828Disable( &(tmf8828[i]) );                                   // this resets the I2C address in the device
+  }
+  setInterruptHandler( &(tmf8828[0]), interruptHandler, 0 );
   delayInMicroseconds(CAP_DISCHARGE_TIME_MS * 1000); // wait for a proper discharge of the cap
   printHelp();
 }
 
 // Altered by Ibxwer
+// Brings up all NR_OF_TMF8828 devices and starts them together. If only the host was reset
+// and the devices still run the firmware from before, they are taken over without a download.
 void setupforTMF882x()
 {
-  setupFn(0, 115200, 4000000);
-  enable( tmf882x_image_start, tmf882x_image, tmf882x_image_length );
-  measure(); 
+  uint8_t i;
+#if GAME_8X8_MODE
+  const uint32_t imageStart = tmf8828_image_start;
+  const unsigned char * image = tmf8828_image;
+  const int32_t imageLength = tmf8828_image_length;
+#else
+  const uint32_t imageStart = tmf882x_image_start;
+  const unsigned char * image = tmf882x_image;
+  const int32_t imageLength = tmf882x_image_length;
+#endif
+  bootStartTick = getSysTick( );
+  bootReported = 0;
+  openDevices( 0, 115200, 4000000 );                // no disable here, that would end a warm start
+  modeIsTmf8828 = GAME_8X8_MODE;                    // after openDevices, its state reset selects the 8x8 mode; the tmf882x image only has the legacy mode
+  printHelp( );
+  tmf8828ArrayInitialise( &sensorArray, tmf8828, NR_OF_TMF8828 );
+#if GAME_REPLAY
+  tmf8828RecordParserInitialise( &replayParser );   // the devices are left alone, the records bring their own SPAD map
+  bootReported = 1;
+  stateTmf8828 = TMF8828_STATE_MEASURE;
+  return;
+#endif
+  tmf8828ArraySetHistogramCapture( &sensorArray, 0, &histogramCapture );
+  tmf8828ArraySetConfigure( &sensorArray, setupArrayDevice );
+  recordTMF882x( GAME_RECORD );
+  bootWarm = ( tmf8828ArrayResume( &sensorArray, imageStart, image, imageLength, modeIsTmf8828, logLevels[ logLevelIdx ] ) > 0 );
+  if ( !bootWarm && !tmf8828ArrayEnable( &sensorArray, imageStart, image, imageLength, modeIsTmf8828, logLevels[ logLevelIdx ] ) )
+  {
+    stateTmf8828 = TMF8828_STATE_ERROR;
+    return;
+  }
+  bootEnableUs = ( getSysTick( ) - bootStartTick ) / HOST_TICKS_PER_US;
+  stateTmf8828 = TMF8828_STATE_STOPPED;
+  for ( i = 0; i < NR_OF_TMF8828; i++ )
+  {
+    if ( !( sensorArray.activeMask & ( 1 << i ) ) )
+    {
+      continue;
+    }
+    if ( setupArrayDevice( &(tmf8828[i]) ) != APP_SUCCESS_OK )
+    {
+      PRINT_CONST_STR( (  "#Err" ) );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_CONST_STR( (  "Config" ) );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_INT( i );
+      PRINT_LN( );
+    }
+  }
+  printDeviceInfo( );
+  if ( tmf8828ArrayStart( &sensorArray, configSpadId[modeIsTmf8828][configNr] ) )
+  {
+    stateTmf8828 = TMF8828_STATE_MEASURE;
+  }
+  bootStartUs = ( getSysTick( ) - bootStartTick ) / HOST_TICKS_PER_US;
 }
 
-class DirectionFilter {
-public:
-    DirectionFilter(size_t buffer_size = 5)
-        : direction_buffer(buffer_size), last_direction('-'), consecutive_count(0), min_consecutive(2) {}
-
-    char update(char new_direction) {
-        if (new_direction == last_direction) {
-            consecutive_count++;
-        } else {
-            consecutive_count = 1;
-        }
-
-        direction_buffer.push_back(new_direction);
-        last_direction = new_direction;
-
-        if (consecutive_count >= min_consecutive) {
-            return new_direction;
-        }
-        return '-';
+// Factory calibration of every running device of the array, in between the array is stopped
+void calibrateTMF882x ( )
+{
+#if !GAME_REPLAY
+  uint8_t i;
+  if ( stateTmf8828 != TMF8828_STATE_MEASURE )
+  {
+    return;
+  }
+  PRINT_CONST_STR( (  "Fact Cal" ) );
+  PRINT_LN( );
+  tmf8828ArrayStop( &sensorArray );
+  for ( i = 0; i < NR_OF_TMF8828; i++ )
+  {
+    if ( !( sensorArray.activeMask & ( 1 << i ) ) )
+    {
+      continue;
     }
-
-    char get_dominant_direction() {
-        if (direction_buffer.empty()) {
-            return '-';
-        }
-        return *std::max_element(direction_buffer.begin(), direction_buffer.end(),
-                                [this](char a, char b) {
-                                    return std::count(direction_buffer.begin(), direction_buffer.end(), a) <
-                                           std::count(direction_buffer.begin(), direction_buffer.end(), b);
-                                });
+    if ( calibrateDevice( &(tmf8828[i]) ) != APP_SUCCESS_OK )
+    {
+      PRINT_CONST_STR( (  "#Err" ) );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_CONST_STR( (  "fact calib" ) );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_INT( i );
+      PRINT_LN( );
     }
+    setupArrayDevice( &(tmf8828[i]) );          // back to the game configuration with the stored calibration
+  }
+  if ( !tmf8828ArrayStart( &sensorArray, configSpadId[modeIsTmf8828][configNr] ) )
+  {
+    stateTmf8828 = TMF8828_STATE_STOPPED;
+  }
+#endif
+}
+
+DirectionFilter<GESTURE_FILTER_SLOTS> direction_filter( configDirectionFilter[0][0], configDirectionFilter[0][1], configDirectionFilter[0][2] );
 
-private:
-    std::deque<char> direction_buffer;
-    char last_direction;
-    size_t consecutive_count;
-    size_t min_consecutive;
+const GestureTiming gestureTiming =
+{ GESTURE_SWIPE_WINDOW_MS * 1000UL * HOST_TICKS_PER_US
+, GESTURE_DOUBLE_WINDOW_MS * 1000UL * HOST_TICKS_PER_US
+, GESTURE_PUSH_WINDOW_MS * 1000UL * HOST_TICKS_PER_US
+, GESTURE_HOVER_DWELL_MS * 1000UL * HOST_TICKS_PER_US
+, GESTURE_PUSH_DISTANCE
+, GESTURE_HOVER_RADIUS
 };
 
-DirectionFilter direction_filter;
+GestureEngine<GESTURE_EVENT_FRAMES> gesture_engine( gestureTiming );
 
-char get_arrow(float dx, float dy) {
-    //printf("\rdx:%f dy:%f\n", dx, dy);
-    const float dir_threshold = 0.1;
+HandTracker hand_tracker( GAME_TRACK_ALPHA, GAME_TRACK_BETA, GAME_TRACK_TIMEOUT_MS * 1000UL * HOST_TICKS_PER_US, GAME_TRACK_GATE );
+
+// Select the next direction filter set, prints the one in use. The filter belongs to the core that runs
+// loopFnforTMF882x, so it can change while measuring.
+void directionFilter ( )
+{
+  directionFilterNr = directionFilterNr + 1;
+  if ( directionFilterNr > 2 )
+  {
+    directionFilterNr = 0;     // wrap around
+  }
+  direction_filter.configure( configDirectionFilter[directionFilterNr][0], configDirectionFilter[directionFilterNr][1], configDirectionFilter[directionFilterNr][2] );
+  PRINT_CONST_STR( (  "#Filter" ) );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_INT( direction_filter.window_length( ) );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_INT( direction_filter.min_consecutive_votes( ) );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_INT( direction_filter.hysteresis_margin( ) );
+  PRINT_LN( );
+}
+
+// dx, dy: movement of the centroid per frame in 1/GESTURE_POS_SCALE mm
+char get_arrow(int32_t dx, int32_t dy) {
+    const int32_t dir_threshold = (int32_t)(GESTURE_MIN_SLOPE_MM * GESTURE_POS_SCALE);
     if (std::abs(dx) > dir_threshold || std::abs(dy) > dir_threshold) {
         if (std::abs(dx) > std::abs(dy)) {
             return dx > 0 ? 'd' : 'u';
@@ -876,145 +1308,350 @@ char get_arrow(float dx, float dy) {
     return '-';
 }
 
-char determine_direction(std::deque<std::pair<std::vector<uint16_t>, std::vector<uint8_t>>> &buffer) {
-    if (buffer.size() < 3) {
-      return '-';
-    }
+// Centroids of the last frames with a close object, with the running sums of their regression
+typedef SlopeWindow<GESTURE_HISTORY_FRAMES> GestureHistory;
+
+// Which target(s) of a zone are used. The nearest one keeps a hand over a table from being taken for the table.
+enum TargetSelect {
+    TARGET_FIRST,       // target 0 only, as the device orders them
+    TARGET_NEAREST,     // the closer of the valid targets
+    TARGET_STRONGEST,   // the valid target with the higher confidence
+    TARGET_BOTH         // each valid target counts as a point of its own
+};
+
+TargetSelect gesture_target_select = GESTURE_TARGET_SELECT;
+
+// How the position of the hand is taken from its close targets
+enum CentroidMode {
+    CENTROID_MEAN,      // plain mean of the target positions
+    CENTROID_WEIGHTED,  // mean weighted with confidence over distance, the grazed edges of the hand count less
+    CENTROID_PEAK       // the zone with the highest weight, moved by a quadratic fit across its neighbour zones
+};
 
-    // Only consider objects within 100mm for direction detection
-    const int max_distance_for_direction = 100;
-    
-    std::vector<std::pair<float, float>> centroids;
-    for (const auto &frame : buffer) {
-        const auto &distances = frame.first;
-        std::vector<float> x_coords, y_coords;
-        for (size_t i = 0; i < distances.size(); ++i) {
-            // Only consider points within the maximum distance threshold
-            if (distances[i] > 0 && distances[i] <= max_distance_for_direction) {
-                x_coords.push_back(i % 3);
-                y_coords.push_back(i / 3);
-            }
+CentroidMode gesture_centroid = GESTURE_CENTROID;
+
+static uint16_t target_distance(const tmf8828Frame *frame, int target, int zone) {
+    return frame->confidence[target][zone] > GESTURE_MIN_CONFIDENCE ? frame->distance[target][zone] : 0;
+}
+
+// Distances and confidences of the selected targets of a zone, returns how many were written to dist and conf (0..2)
+static int zone_targets(const tmf8828Frame *frame, int zone, uint16_t dist[TMF8828_FRAME_TARGETS], uint8_t conf[TMF8828_FRAME_TARGETS]) {
+    uint16_t d0 = target_distance(frame, 0, zone);
+    uint16_t d1 = target_distance(frame, 1, zone);
+    uint8_t c0 = frame->confidence[0][zone];
+    uint8_t c1 = frame->confidence[1][zone];
+    int n = 0;
+    switch (gesture_target_select) {
+    case TARGET_FIRST:
+        d1 = 0;
+        break;
+    case TARGET_NEAREST:
+        if (d1 > 0 && (d0 == 0 || d1 < d0)) {
+            d0 = d1;
+            c0 = c1;
         }
-        if (!x_coords.empty() && !y_coords.empty()) {
-            float g_x = std::accumulate(x_coords.begin(), x_coords.end(), 0.0f) / x_coords.size();
-            float g_y = std::accumulate(y_coords.begin(), y_coords.end(), 0.0f) / y_coords.size();
-            centroids.emplace_back(g_x, g_y);
+        d1 = 0;
+        break;
+    case TARGET_STRONGEST:
+        if (d1 > 0 && (d0 == 0 || c1 > c0)) {
+            d0 = d1;
+            c0 = c1;
         }
+        d1 = 0;
+        break;
+    case TARGET_BOTH:
+        break;
     }
-
-    // If we don't have enough valid centroids (close objects), return without direction update
-    if (centroids.size() < 3) {
-        return '-';
+    if (d0 > 0) {
+        dist[n] = d0;
+        conf[n++] = c0;
     }
+    if (d1 > 0) {
+        dist[n] = d1;
+        conf[n++] = c1;
+    }
+    return n;
+}
 
-    std::vector<float> indices(centroids.size());
-    std::iota(indices.begin(), indices.end(), 0);
-
-    float x_mean = std::accumulate(indices.begin(), indices.end(), 0.0f) / indices.size();
-    float y_mean = std::accumulate(centroids.begin(), centroids.end(), 0.0f, [](float sum, const std::pair<float, float>& p) { return sum + p.first; }) / centroids.size();
+// Weight of a close target in the position of the hand, confidence over distance in 1/256
+static uint16_t centroid_weight(uint8_t confidence, uint16_t distance) {
+    return gesture_centroid == CENTROID_MEAN ? 1 : (uint16_t)(((uint32_t)confidence << 8) / distance);
+}
 
-    float x_slope = std::inner_product(indices.begin(), indices.end(), centroids.begin(), 0.0f,
-                                       std::plus<>(), [x_mean, y_mean](float a, const std::pair<float, float> &b) { return (a - x_mean) * (b.first - y_mean); }) /
-                    std::inner_product(indices.begin(), indices.end(), indices.begin(), 0.0f, std::plus<>(), [x_mean](float a, float b) { return (a - x_mean) * (b - x_mean); });
+// Offset of the top of a parabola through the weights left of, at and right of a peak, in 1/256 zone (-128..128)
+static int32_t peak_offset(int32_t left, int32_t centre, int32_t right) {
+    int32_t den = left - 2 * centre + right;
+    return den < 0 ? (left - right) * 128 / den : 0;
+}
 
-    y_mean = std::accumulate(centroids.begin(), centroids.end(), 0.0f, [](float sum, const std::pair<float, float>& p) { return sum + p.second; }) / centroids.size();
+// Position of the peak zone at the given distance, moved by the quadratic fit of the zone weights along its
+// row and its column. Zones outside of the grid have no weight. Returns 1/GESTURE_POS_SCALE mm.
+static void peak_position(const keystone::Map &map, const uint16_t *weight, int peak, uint16_t distance, int32_t *x, int32_t *y) {
+    const int cols = map.cols;
+    const int rows = map.rows;
+    const int r = peak / cols;
+    const int c = peak % cols;
+    keystone::Point p = keystone::project(map, peak, distance);
+    *x = p.x * GESTURE_POS_SCALE;
+    *y = p.y * GESTURE_POS_SCALE;
+    int left = (c > 0 ? peak - 1 : peak);
+    int right = (c < cols - 1 ? peak + 1 : peak);
+    if (right > left) {
+        int32_t off = peak_offset(c > 0 ? weight[left] : 0, weight[peak], c < cols - 1 ? weight[right] : 0);
+        int32_t pitch = keystone::project(map, right, distance).x - keystone::project(map, left, distance).x;
+        *x += off * pitch * GESTURE_POS_SCALE / (256 * (right - left));
+    }
+    int up = (r > 0 ? peak - cols : peak);
+    int down = (r < rows - 1 ? peak + cols : peak);
+    if (down > up) {
+        int32_t off = peak_offset(r > 0 ? weight[up] : 0, weight[peak], r < rows - 1 ? weight[down] : 0);
+        int32_t pitch = keystone::project(map, down, distance).y - keystone::project(map, up, distance).y;
+        *y += off * pitch * GESTURE_POS_SCALE / (256 * ((down - up) / cols));
+    }
+}
 
-    float y_slope = std::inner_product(indices.begin(), indices.end(), centroids.begin(), 0.0f,
-                                       std::plus<>(), [x_mean, y_mean](float a, const std::pair<float, float> &b) { return (a - x_mean) * (b.second - y_mean); }) /
-                    std::inner_product(indices.begin(), indices.end(), indices.begin(), 0.0f, std::plus<>(), [x_mean](float a, float b) { return (a - x_mean) * (b - x_mean); });
 
-    char new_arrow = get_arrow(x_slope, y_slope);
+char determine_direction(const GestureHistory &window) {
+    if (window.size() < 3) {
+      return '-';
+    }
+    // Least squares slope of the centroid over the frame index, kept up to date by the window
+    char new_arrow = get_arrow(window.slope_x(), window.slope_y());
     char filtered_arrow = direction_filter.update(new_arrow);
     return filtered_arrow;
 }
 
-void loopFnforTMF882x(SensorData *sensor_data)
+// Height and gesture detection on one complete frame, reads the zones in place.
+// map projects the zones to metric points, without one the height is the measured distance and 
+// there is no direction detection. Returns true if a target is closer than RATE_PRESENCE_DISTANCE.
+static bool process_frame(const tmf8828Frame *frame, const keystone::Map *map, SensorData *sensor_data)
 {
-  uint8_t intStatus = 0;
-  int8_t res = APP_SUCCESS_OK;
-  //SensorData sensor_data;
-  
-  disableInterrupts();
-  irqTriggered = 0;
-  enableInterrupts();
-  intStatus = tmf8828GetAndClrInterrupts(&(tmf8828[0]), TMF8828_APP_I2C_RESULT_IRQ_MASK | TMF8828_APP_I2C_ANY_IRQ_MASK | TMF8828_APP_I2C_RAW_HISTOGRAM_IRQ_MASK);
-
-  uint8_t data[27];
-  static std::deque<std::pair<std::vector<uint16_t>, std::vector<uint8_t>>> judge_buffer;
-
-  if (intStatus & TMF8828_APP_I2C_RESULT_IRQ_MASK)
-  {
-    res = ReadResults(&(tmf8828[0]), data);
-    if (res == APP_SUCCESS_OK)
-    {
-      std::vector<uint16_t> distances(9,0);
-      std::vector<uint8_t> confidences(9);
-      for (int i = 0; i < 27; i += 3) {
-        confidences[i / 3] = data[i];
-        if ((confidences[i / 3] > 100))
-          distances[i / 3] = (data[i + 2] << 8) + data[i + 1];
+  static GestureHistory judge_buffer;
+
+  // // print distance data
+  // for (int i = 0; i < frame->nrZones; i++) {
+  //   printf("%d/%d ", frame->distance[0][i], frame->distance[1][i]);
+  // }
+  // printf("\n");
+
+  // Calculate average height and position above the sensor, and the weighted centroid of the close points (<100mm) for the direction detection
+  int average_height = 0;
+  int32_t average_x = 0;
+  int32_t average_y = 0;
+  int count = 0;
+  int32_t sum_x = 0;
+  int32_t sum_y = 0;
+  int32_t sum_z = 0;
+  int32_t sum_weight = 0;
+  uint16_t zone_weight[TMF8828_FRAME_MAX_ZONES] = {};
+  int peak = -1;
+  uint16_t peak_distance = 0;
+  int zones = 0;
+  bool present = false;
+  for (int i = 0; i < frame->nrZones; i++) {
+    uint16_t dist[TMF8828_FRAME_TARGETS];
+    uint8_t conf[TMF8828_FRAME_TARGETS];
+    int n = zone_targets(frame, i, dist, conf);
+    zones += (n > 0);
+    for (int t = 0; t < n; t++) {
+      present = present || dist[t] <= RATE_PRESENCE_DISTANCE;
+      if (!map) {
+        average_height += dist[t];
+        count++;
+        continue;
       }
-      
-      // // print distance data
-      // for (int i = 0; i < 9; i++) {
-      //   printf("%d ", distances[i]);
-      // }
-      // printf("\n");
-
-      // Calculate average height
-      int average_height = 0;
-      int count = 0;
-      for (int i = 0; i < 9; i++) {
-        if (distances[i] > 0) {
-          average_height += distances[i];
-          count++;
+      keystone::Point p = keystone::project(*map, i, dist[t]);
+      average_height += p.z;
+      average_x += p.x;
+      average_y += p.y;
+      count++;
+      if (dist[t] <= GESTURE_MAX_DISTANCE) {
+        uint16_t w = centroid_weight(conf[t], dist[t]);
+        sum_x += (int32_t)w * p.x;
+        sum_y += (int32_t)w * p.y;
+        sum_z += (int32_t)w * p.z;
+        sum_weight += w;
+        if (w > zone_weight[i]) {
+          zone_weight[i] = w;
+          if (peak < 0 || w > zone_weight[peak]) {
+            peak = i;
+            peak_distance = dist[t];
+          }
         }
       }
-      if (count > 0) {
-        average_height /= count;
-        sensor_data->average_height = average_height;
-        sensor_data->valid = (count > 4);  // Only consider valid if more than 4 points
-      }
+    }
+  }
+  sensor_data->timestamp = frame->captureTimestamp;
+  sensor_data->sequence = frame->sequence;
+  sensor_data->temperature = frame->temperature;
+  if (count > 0) {
+    average_height /= count;
+    sensor_data->average_height = average_height;
+    sensor_data->valid = (zones * 9 > 4 * frame->nrZones);  // Only consider valid if more than 4 of 9 zones
+  } else {
+    sensor_data->valid = false;                               // the caller may pass the data of the last frame
+  }
+  if (count > 0 && sensor_data->valid) {
+    sensor_data->hand = hand_tracker.update(frame->captureTimestamp, average_x / count, average_y / count, average_height);
+  } else {
+    sensor_data->hand = hand_tracker.coast(frame->captureTimestamp);
+  }
 
-      // Direction detection - only add to buffer if we have at least one close point (<100mm)
-      bool has_close_point = false;
-      for (int i = 0; i < 9; i++) {
-        if (distances[i] > 0 && distances[i] <= 100) {
-            has_close_point = true;
-            break;
-        }
-      }
-      
-      if (has_close_point) {
-        judge_buffer.emplace_back(distances, confidences);
-        if (judge_buffer.size() > 20) {
-          judge_buffer.pop_front();
-        }
-        sensor_data->direction = determine_direction(judge_buffer);
-      } else {
-        sensor_data->direction = '-';
-        judge_buffer.clear();
-      }
+  // Direction detection - only add to buffer if we have at least one close point
+  int32_t cx = 0;
+  int32_t cy = 0;
+  if (sum_weight > 0) {
+    if (gesture_centroid == CENTROID_PEAK) {
+      peak_position(*map, zone_weight, peak, peak_distance, &cx, &cy);
+    } else {
+      cx = (int32_t)((int64_t)sum_x * GESTURE_POS_SCALE / sum_weight);
+      cy = (int32_t)((int64_t)sum_y * GESTURE_POS_SCALE / sum_weight);
     }
+    uint32_t start = getCycleCount();
+    judge_buffer.push(cx, cy);                       // drops the oldest frame once the window is full
+    sensor_data->direction = determine_direction(judge_buffer);
+    uint32_t cycles = (getCycleCount() - start) & CYCLE_COUNT_MASK;
+    gestureCalls++;
+    gestureCycles += cycles;
+    gestureMaxCycles = (cycles > gestureMaxCycles ? cycles : gestureMaxCycles);
+  } else {
+    sensor_data->direction = '-';
+    judge_buffer.clear();
   }
+  uint16_t cz = (sum_weight > 0 ? (uint16_t)(sum_z / sum_weight) : 0);
+  sensor_data->close = (sum_weight > 0);
+  sensor_data->gesture = gesture_engine.update(frame->captureTimestamp, sensor_data->close, cx, cy, cz, GESTURE_POS_SCALE, sensor_data->direction).type;
+  return present;
+}
+
+bool processFrameTMF882x(const tmf8828Frame *frame, uint8_t spadMapId, SensorData *sensor_data)
+{
+#if GAME_DESCATTER
+  static tmf8828Frame filtered;       // the published frame belongs to the assembler, filter a copy
+  filtered = *frame;
+  tmf882xDescatterFrame view = { { filtered.distance[0], filtered.distance[1] }, { filtered.confidence[0], filtered.confidence[1] }, filtered.nrZones };
+  tmf882xDescatter(&tmf882xDescatterDefaultConfig, &view);
+  frame = &filtered;
+#endif
+  return process_frame(frame, keystone::find_map(spadMapId, frame->rows, frame->cols), sensor_data);
+}
+
+void recordTMF882x ( uint8_t on )
+{
+  tmf8828ArraySetRecord( &sensorArray, on ? tmf8828RecordStream : 0 );
+}
 
-  if (intStatus & TMF8828_APP_I2C_RAW_HISTOGRAM_IRQ_MASK)
+#if GAME_REPLAY
+// Feeds the records received so far to the array, until one of them completes a merged frame
+static int8_t replayService ( const tmf8828ArrayFrame * * frame )
+{
+  int8_t res = APP_SUCCESS_OK;
+  char c;
+  replayIdle = 1;
+  while ( res == APP_SUCCESS_OK && inputGetKey( &c ) )
   {
-    res = tmf8828ReadHistogram(&(tmf8828[0]));
+    const tmf8828Record * record = tmf8828RecordParse( &replayParser, (uint8_t)c );
+    replayIdle = 0;
+    if ( record )
+    {
+      res = tmf8828ArrayReplay( &sensorArray, record, frame );
+    }
   }
+  return res;
+}
+#else
+// Key commands while the game measures, the only reader of the input (the replay reads its records instead)
+static void serviceInput ( )
+{
+  char c;
+  if ( !inputGetKey( &c ) )
+  {
+    return;
+  }
+  if ( c == 'f' )
+  {
+    calibrateTMF882x( );
+  }
+  else if ( c == 'g' )
+  {
+    directionFilter( );
+  }
+}
+#endif
 
-  if (res != APP_SUCCESS_OK)
+void loopFnforTMF882x(SensorData *sensor_data)
+{
+  const tmf8828ArrayFrame *merged = 0;
+#if GAME_REPLAY
+  int8_t res = replayService(&merged);
+#else
+  serviceInput();
+  int8_t res = tmf8828ArrayService(&sensorArray, &merged);
+#endif
+  streamHistograms();
+
+#if ( ARRAY_REPORT_PERIOD_MS > 0 )
+  static uint32_t last_report = getSysTick();
+  if (getSysTick() - last_report >= ARRAY_REPORT_PERIOD_MS * 1000UL) {
+    last_report = getSysTick();
+    printArrayStatistics();
+    printI2cStatistics();
+  }
+#endif
+
+  if (res == TMF8828_ARRAY_FRAME_READY && !bootReported)
+  {
+    bootReported = 1;
+    printBootTime(merged->hostTimestamp);
+  }
+
+  // the gesture detection looks at the first device only
+  if (res == TMF8828_ARRAY_FRAME_READY && (merged->validMask & 1))
+  {
+    bool present = processFrameTMF882x(merged->sensor[0], sensorArray.spadMapId, sensor_data);
+#if ADAPTIVE_RATE && !GAME_REPLAY
+    uint32_t now = getSysTick();
+    if (present) {
+      ratePresenceTick = now;
+      if (!rateFast) {
+        setRate(1);
+      }
+    } else if (rateFast && now - ratePresenceTick >= RATE_ACTIVE_HOLD_MS * 1000UL * HOST_TICKS_PER_US) {
+      setRate(0);
+    }
+#else
+    (void)present;
+#endif
+  }
+
+  if (res < APP_SUCCESS_OK)             // the failing device is out of the merged frames until the array recovered it
   {
-    tmf8828StopMeasurement(&(tmf8828[0]));
-    tmf8828DisableInterrupts(&(tmf8828[0]), 0xFF);
-    stateTmf8828 = TMF8828_STATE_STOPPED;
     sensor_data->valid = false;
+    if (!sensorArray.activeMask && !sensorArray.recoverMask)
+    {
+      stateTmf8828 = TMF8828_STATE_STOPPED;
+    }
   }
   // printf("Direction: %c\n", sensor_data->direction);
   // printf("Average height: %d\n", sensor_data->average_height);
   // printf("Valid: %d\n", sensor_data->valid);
 }
 
+// Sleep until a result can be read
+void waitForTMF882x ( )
+{
+#if GAME_REPLAY
+  if ( replayIdle )
+  {
+    delayInMicroseconds( REPLAY_IDLE_MS * 1000UL );
+  }
+#elif ( defined( USE_INTERRUPT_TO_TRIGGER_READ ) && (USE_INTERRUPT_TO_TRIGGER_READ != 0) )
+  tmf8828ArrayWait( &sensorArray, IRQ_WAIT_TIMEOUT_MS );
+#else
+  delayInMicroseconds( POLL_PERIOD_MS * 1000UL );
+#endif
+}
+
 // Arduino main loop function, is executed cyclic
 int8_t loopFn ( )
 {
@@ -1023,7 +1660,7 @@ int8_t loopFn ( )
   int8_t exit = 0;
   if (stateTmf8828 != TMF8828_STATE_MEASURE )
   {
-    int8_t exit = serialInput();
+    exit = serialInput();
   }
 
 #if ( defined( USE_INTERRUPT_TO_TRIGGER_READ ) && (USE_INTERRUPT_TO_TRIGGER_READ != 0) )
@@ -1043,9 +1680,15 @@ int8_t loopFn ( )
     }
     if ( intStatus & TMF8828_APP_I2C_RAW_HISTOGRAM_IRQ_MASK )
     {
-      res = tmf8828ReadHistogram( &(tmf8828[0]) );                                              // read a (partial) raw histogram
+      uint32_t now = getSysTick( );
+      res = tmf8828ReadHistogramPacket( &(tmf8828[0]) );                                        // read a (partial) raw histogram
+      if ( res == APP_SUCCESS_OK )
+      {
+        tmf8828HistogramAddPacket( &histogramCapture, tmf8828[0].dataBuffer, tmf8828[0].i2cSlaveAddress, now );
+      }
     }
   }
+  streamHistograms( );
 
   if ( res != APP_SUCCESS_OK )                         // in case that fails there is some error in programming or on the device, this should not happen
   {
@@ -1069,7 +1712,7 @@ int8_t loopFn ( )
 void terminateFn ( )
 {
   tmf8828Disable( &(tmf8828[0]) );
-  clrInterruptHandler( );
+  clrInterruptHandler( &(tmf8828[0]) );
 
   i2cClose( &(tmf8828[0]) );
   inputClose( );
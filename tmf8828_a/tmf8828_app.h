@@ -30,6 +30,8 @@
 // ---------------------------------------------- includes ----------------------------------------
 
 #include "tmf8828_shim.h"
+#include "tmf8828_frame.h"
+#include "tmf8828_tracker.h"
 
 
 // ---------------------------------------------- functions ---------------------------------------
@@ -56,11 +58,41 @@ struct SensorData {
     int average_height;     // 平均高度
     char direction;         // 方向 ('u'=up, 'd'=down, 'l'=left, 'r'=right, '-'=none)
     bool valid;            // 数据是否有效
+    uint32_t timestamp;     // host sys-tick (us) when the sensor captured the frame
+    uint32_t sequence;      // extended RESULT_NUMBER of the frame
+    int8_t temperature;     // sensor temperature in degree Celsius
+    char gesture;           // gesture event completed by this frame, see tmf8828_gesture.h ('-'=none), at timestamp
+    TrackState hand;        // smoothed position and velocity of the average height and position, see tmf8828_tracker.h
+    bool close;             // a target within the gesture distance, a frame without one means the hand left
     
-    SensorData() : average_height(0), direction('-'), valid(false) {}
+    SensorData() : average_height(0), direction('-'), valid(false), timestamp(0), sequence(0), temperature(0), gesture('-'), hand(), close(false) {}
 };
 
 void loopFnforTMF882x(SensorData *sensor_data);
+
+/** @brief Runs the height and gesture detection on one assembled frame, as loopFnforTMF882x does with the frames
+ * of the first device: descattering, keystone projection with the map of spadMapId, direction and gesture events.
+ * Exposed for feeding synthetic frames to the exact pipeline.
+ * @return true if a target is close enough to keep the game rate up
+ */
+bool processFrameTMF882x(const tmf8828Frame *frame, uint8_t spadMapId, SensorData *sensor_data);
+
+/** @brief Factory calibration of all measuring devices, loopFnforTMF882x runs it on the key 'f'. Each
+ * calibration is saved in the flash store and loaded again at the next start. Keep the field of view free of 
+ * targets while it runs, the measurement restarts afterwards.
+ */
+void calibrateTMF882x( );
+
+/** @brief Switches the recording of the raw result pages on or off. Each page is written as a binary record 
+ * to the USB CDC, see tmf8828_record.h. A build with GAME_REPLAY set plays such a recording back through 
+ * loopFnforTMF882x instead of measuring.
+ */
+void recordTMF882x( uint8_t on );
+
+/** @brief Sleep until the TMF882x signals new data on the interrupt pin (or the poll period elapsed
+ * when USE_INTERRUPT_TO_TRIGGER_READ is 0). Call this between two loopFnforTMF882x calls.
+ */
+void waitForTMF882x( );
 /** @brief Arduino terminate function is only called once when exit key 'q' is pressed. Write a message and wait for shutdown of arduino.
  */
 void terminateFn( );
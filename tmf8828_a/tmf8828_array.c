@@ -0,0 +1,738 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf8828_array.h"
+#include <stddef.h>
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define ARRAY_IRQ_MASK          ( TMF8828_APP_I2C_RESULT_IRQ_MASK | TMF8828_APP_I2C_ANY_IRQ_MASK | TMF8828_APP_I2C_RAW_HISTOGRAM_IRQ_MASK )
+
+#define WARM_RECORD_MAGIC       0x544D4657      // "TMFW"
+#define SIGNATURE_CHUNK         64              // image is read in chunks of this size for the signature
+
+// ---------------------------------------------- types -------------------------------------------
+
+// What the last cold start left running on the devices. Lives in RAM that is not cleared at startup, 
+// so it is only trusted if magic and check are consistent.
+typedef struct _tmf8828WarmRecord
+{
+  uint32_t magic;
+  uint32_t imageSignature;                                  // identifies the downloaded image
+  uint8_t modeIsTmf8828;
+  uint8_t count;
+  uint8_t activeMask;
+  uint8_t appVersion[ TMF8828_ARRAY_MAX_SENSORS ][ 4 ];     // as reported by each device after the download
+  uint32_t check;                                           // inverted sum over all fields before
+} tmf8828WarmRecord;
+
+// ---------------------------------------------- variables -----------------------------------------
+
+static tmf8828WarmRecord RETAINED_VARIABLE( warmRecord );
+
+// ---------------------------------------------- functions ---------------------------------------
+
+// interrupt handler of device dptr, runs with interrupts serialised by the shim
+static void tmf8828ArrayInterruptHandler ( void * dptr, void * context )
+{
+  tmf8828Array * array = (tmf8828Array *)context;
+  array->pendingMask |= (uint8_t)( 1 << ( (tmf8828Driver *)dptr - array->sensor ) );
+}
+
+// FNV-1a over the image and its load address
+static uint32_t tmf8828ArrayImageSignature ( uint32_t imageStartAddress, const unsigned char * image, int32_t imageSizeInBytes )
+{
+  uint8_t chunk[ SIGNATURE_CHUNK ];
+  uint32_t h = 2166136261u ^ imageStartAddress;
+  int32_t idx = 0;
+  while ( idx < imageSizeInBytes )
+  {
+    uint16_t len = ( imageSizeInBytes - idx > SIGNATURE_CHUNK ? SIGNATURE_CHUNK : (uint16_t)( imageSizeInBytes - idx ) );
+    uint16_t i;
+    readProgramMemory( chunk, image + idx, len );
+    for ( i = 0; i < len; i++ )
+    {
+      h = ( h ^ chunk[i] ) * 16777619u;
+    }
+    idx += len;
+  }
+  return h;
+}
+
+static uint32_t tmf8828ArrayWarmRecordCheck ( const tmf8828WarmRecord * record )
+{
+  const uint8_t * p = (const uint8_t *)record;
+  uint32_t sum = 0;
+  uint16_t i;
+  for ( i = 0; i < offsetof( tmf8828WarmRecord, check ); i++ )
+  {
+    sum += p[i];
+  }
+  return ~sum;
+}
+
+// the address a device is moved to during tmf8828ArrayEnable
+static uint8_t tmf8828ArrayAddress ( tmf8828Array * array, uint8_t idx )
+{
+  return ( idx + 1 < array->count ? TMF8828_SLAVE_ADDR + 1 + idx : TMF8828_SLAVE_ADDR );
+}
+
+// take the device out of the array, e.g. because it does no longer respond
+static void tmf8828ArrayDrop ( tmf8828Array * array, uint8_t idx )
+{
+  tmf8828Driver * driver = array->sensor + idx;
+  clrInterruptHandler( driver );
+  tmf8828StopMeasurement( driver );
+  tmf8828DisableInterrupts( driver, 0xFF );
+  tmf8828Disable( driver );
+  array->activeMask &= (uint8_t)~( 1 << idx );
+}
+
+// Bring up a device that waits in the bootloader at the default address: download the firmware, select 
+// the mode and move it to its array address
+static int8_t tmf8828ArrayBringUp ( tmf8828Array * array, uint8_t idx )
+{
+  tmf8828Driver * driver = array->sensor + idx;
+  int8_t res = APP_ERROR_TIMEOUT;
+  tmf8828Wakeup( driver );
+  if ( tmf8828IsCpuReady( driver, CPU_READY_TIME_MS ) )
+  {
+    res = tmf8828DownloadFirmware( driver, array->imageStartAddress, array->image, array->imageSizeInBytes );
+  }
+  if ( res == BL_SUCCESS_OK )
+  {
+    res = ( array->modeIsTmf8828 ? tmf8828SwitchTo8x8Mode( driver ) : tmf8828SwitchToLegacyMode( driver ) );
+  }
+  if ( res == APP_SUCCESS_OK && idx + 1 < array->count )     // the default address must be free for the next device
+  {
+    res = tmf8828ChangeI2CAddress( driver, tmf8828ArrayAddress( array, idx ) );
+  }
+  if ( res == APP_SUCCESS_OK )
+  {
+    tmf8828ReadDeviceInfo( driver );
+  }
+  return res;
+}
+
+// arm the interrupt and start the measurement of one device
+static int8_t tmf8828ArrayStartDevice ( tmf8828Array * array, uint8_t idx )
+{
+  tmf8828Driver * driver = array->sensor + idx;
+  tmf8828FrameInitialise( &( array->assembler[idx] ), array->spadMapId );
+  if ( array->histogram[idx] )
+  {
+    tmf8828HistogramInitialise( array->histogram[idx] );
+  }
+  array->lastResultTick[idx] = getSysTick( );
+  setInterruptHandler( driver, tmf8828ArrayInterruptHandler, array );
+  tmf8828ClrAndEnableInterrupts( driver, TMF8828_APP_I2C_RESULT_IRQ_MASK | TMF8828_APP_I2C_RAW_HISTOGRAM_IRQ_MASK );
+  return tmf8828StartMeasurement( driver );
+}
+
+static void tmf8828ArrayRecoveryStart ( tmf8828Array * array, uint8_t idx, uint8_t action, uint16_t backoffMs )
+{
+  tmf8828ArrayRecovery * rec = &( array->recovery[ idx ] );
+  array->recoverMask |= (uint8_t)( 1 << idx );
+  rec->action = action;
+  rec->attempts = 0;
+  rec->backoffMs = backoffMs;
+  rec->faultTick = getSysTick( );
+  rec->dueTick = rec->faultTick + backoffMs * 1000UL * HOST_TICKS_PER_US;
+  array->faults++;
+}
+
+// take the device out of the merged frames and start its recovery, the first attempt is due at once. 
+// If the last recovery did not hold, that action is not tried again.
+static void tmf8828ArrayFault ( tmf8828Array * array, uint8_t idx )
+{
+  tmf8828Driver * driver = array->sensor + idx;
+  tmf8828ArrayRecovery * rec = &( array->recovery[ idx ] );
+  uint8_t action = TMF8828_RECOVER_RESTART;
+  clrInterruptHandler( driver );
+  tmf8828DisableInterrupts( driver, 0xFF );
+  array->activeMask &= (uint8_t)~( 1 << idx );
+  array->frame[ array->building ].validMask &= (uint8_t)~( 1 << idx );
+  if ( rec->settling && getSysTick( ) - rec->recoveredTick < TMF8828_RECOVER_SETTLE_MS * 1000UL * HOST_TICKS_PER_US )
+  {
+    action = ( rec->action < TMF8828_RECOVER_REENABLE ? rec->action + 1 : TMF8828_RECOVER_REENABLE );
+  }
+  rec->settling = 0;
+  tmf8828ArrayRecoveryStart( array, idx, action, 0 );
+}
+
+// last resort: all devices off and on again, every device that was wanted and comes back is measuring again
+static int8_t tmf8828ArrayReenable ( tmf8828Array * array )
+{
+  uint8_t recovering = array->recoverMask;
+  uint8_t wanted = array->activeMask | recovering;
+  uint8_t i;
+  tmf8828ArrayStop( array );
+  if ( tmf8828ArrayEnable( array, array->imageStartAddress, array->image, array->imageSizeInBytes, array->modeIsTmf8828, array->logLevel ) )
+  {
+    array->activeMask &= wanted;
+    for ( i = 0; i < array->count; i++ )
+    {
+      if ( ( array->activeMask & ( 1 << i ) ) && array->configure( array->sensor + i ) != APP_SUCCESS_OK )
+      {
+        tmf8828Disable( array->sensor + i );
+        array->activeMask &= (uint8_t)~( 1 << i );
+      }
+    }
+    tmf8828ArrayStart( array, array->spadMapId );
+  }
+  array->measuring = 1;
+  array->recoverMask = recovering & (uint8_t)~array->activeMask;
+  for ( i = 0; i < array->count; i++ )          // devices that were fine before, the next re-enable is up to the failed device
+  {
+    if ( ( wanted & ~recovering & ~array->activeMask ) & ( 1 << i ) )
+    {
+      tmf8828ArrayRecoveryStart( array, i, TMF8828_RECOVER_REENABLE, TMF8828_RECOVER_BACKOFF_MAX_MS );
+    }
+  }
+  return ( array->activeMask ? APP_SUCCESS_OK : APP_ERROR_TIMEOUT );
+}
+
+// one attempt of the current recovery action of a device
+static int8_t tmf8828ArrayRecoverDevice ( tmf8828Array * array, uint8_t idx )
+{
+  tmf8828Driver * driver = array->sensor + idx;
+  tmf8828ArrayRecovery * rec = &( array->recovery[ idx ] );
+  uint8_t last = (uint8_t)( 1 << ( array->count - 1 ) );
+  int8_t res = APP_SUCCESS_OK;
+  if ( !array->configure && rec->action > TMF8828_RECOVER_RESTART )
+  {
+    rec->action = TMF8828_RECOVER_RESTART;
+  }
+  if (  rec->action == TMF8828_RECOVER_RESET && idx + 1 < array->count 
+     && ( ( array->activeMask | array->recoverMask ) & last ) )
+  {
+    rec->action = TMF8828_RECOVER_REENABLE;   // after a reset it answers at the default address, that one is taken
+  }
+  switch ( rec->action )
+  {
+    case TMF8828_RECOVER_RESTART:
+      tmf8828StopMeasurement( driver );       // may fail, the device may not be measuring any more
+      break;
+    case TMF8828_RECOVER_RECONFIGURE:
+      tmf8828StopMeasurement( driver );
+      res = array->configure( driver );
+      break;
+    case TMF8828_RECOVER_RESET:
+      tmf8828Reset( driver );
+      driver->i2cSlaveAddress = TMF8828_SLAVE_ADDR;
+      res = tmf8828ArrayBringUp( array, idx );
+      if ( res == APP_SUCCESS_OK )
+      {
+        res = array->configure( driver );
+      }
+      break;
+    default:
+      res = tmf8828ArrayReenable( array );
+      return ( res == APP_SUCCESS_OK && ( array->activeMask & ( 1 << idx ) ) ? APP_SUCCESS_OK : APP_ERROR_TIMEOUT );
+  }
+  if ( res == APP_SUCCESS_OK )
+  {
+    res = tmf8828ArrayStartDevice( array, idx );
+  }
+  if ( res == APP_SUCCESS_OK )
+  {
+    array->activeMask |= (uint8_t)( 1 << idx );
+    array->recoverMask &= (uint8_t)~( 1 << idx );
+  }
+  else
+  {
+    clrInterruptHandler( driver );
+  }
+  return res;
+}
+
+// run the recovery attempts that are due, print the outcome: 
+// #Rec,<device>,<action>,<us out>,<restarts>,<reconfigures>,<resets>,<reenables> or #Err,recover,<device>,<action>,<result>
+static void tmf8828ArrayRecover ( tmf8828Array * array )
+{
+  uint8_t i;
+  for ( i = 0; i < array->count; i++ )
+  {
+    tmf8828ArrayRecovery * rec = &( array->recovery[ i ] );
+    uint8_t action = rec->action;
+    uint32_t now = getSysTick( );
+    int8_t res;
+    uint8_t j;
+    if ( !array->measuring || !( array->recoverMask & ( 1 << i ) ) || (int32_t)( now - rec->dueTick ) < 0 )
+    {
+      continue;
+    }
+    res = tmf8828ArrayRecoverDevice( array, i );
+    now = getSysTick( );
+    action = ( rec->action > action ? rec->action : action );   // steps that were skipped
+    if ( res == APP_SUCCESS_OK )
+    {
+      uint32_t us = ( now - rec->faultTick ) / HOST_TICKS_PER_US;
+      array->recovered[ action ]++;
+      rec->action = action;
+      rec->settling = 1;
+      rec->recoveredTick = now;
+      if ( us > array->recoverMaxUs )
+      {
+        array->recoverMaxUs = us;
+      }
+      PRINT_CONST_STR( ( "#Rec" ) );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_INT( i );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_INT( action );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_UINT( us );
+      for ( j = 0; j < TMF8828_RECOVER_ACTIONS; j++ )
+      {
+        PRINT_CHAR( SEPARATOR );
+        PRINT_UINT( array->recovered[ j ] );
+      }
+      PRINT_LN( );
+      continue;
+    }
+    PRINT_CONST_STR( ( "#Err" ) );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_CONST_STR( ( "recover" ) );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( i );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( action );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( res );
+    PRINT_LN( );
+    if ( ++rec->attempts >= TMF8828_RECOVER_ATTEMPTS && rec->action < TMF8828_RECOVER_REENABLE )
+    {
+      rec->action++;
+      rec->attempts = 0;
+    }
+    rec->backoffMs = ( rec->backoffMs < TMF8828_RECOVER_BACKOFF_MIN_MS ? TMF8828_RECOVER_BACKOFF_MIN_MS : 2 * rec->backoffMs );
+    if ( rec->backoffMs > TMF8828_RECOVER_BACKOFF_MAX_MS )
+    {
+      rec->backoffMs = TMF8828_RECOVER_BACKOFF_MAX_MS;
+    }
+    rec->dueTick = now + rec->backoffMs * 1000UL * HOST_TICKS_PER_US;
+  }
+}
+
+static void tmf8828ArrayStartFrame ( tmf8828Array * array )
+{
+  array->frame[ array->building ].validMask = 0;
+}
+
+// hand out the frame that was built and start filling the other one
+static const tmf8828ArrayFrame * tmf8828ArrayPublish ( tmf8828Array * array )
+{
+  const tmf8828ArrayFrame * done = &( array->frame[ array->building ] );
+  array->building = !array->building;
+  tmf8828ArrayStartFrame( array );
+  array->frames++;
+  return done;
+}
+
+void tmf8828ArrayInitialise ( tmf8828Array * array, tmf8828Driver * sensor, uint8_t count )
+{
+  array->sensor = sensor;
+  array->count = ( count > TMF8828_ARRAY_MAX_SENSORS ? TMF8828_ARRAY_MAX_SENSORS : count );
+  array->activeMask = 0;
+  array->recoverMask = 0;
+  array->measuring = 0;
+  array->spadMapId = 0;
+  array->next = 0;
+  array->pendingMask = 0;
+  array->building = 0;
+  array->configure = 0;
+  array->record = 0;
+  array->image = 0;
+  array->faults = 0;
+  array->recoverMaxUs = 0;
+  memset( array->recovered, 0, sizeof( array->recovered ) );
+  memset( array->recovery, 0, sizeof( array->recovery ) );
+  memset( array->histogram, 0, sizeof( array->histogram ) );
+  tmf8828ArrayStartFrame( array );
+  tmf8828ArrayResetStatistics( array );
+}
+
+void tmf8828ArraySetHistogramCapture ( tmf8828Array * array, uint8_t idx, tmf8828HistogramCapture * capture )
+{
+  if ( idx < array->count )
+  {
+    array->histogram[ idx ] = capture;
+  }
+}
+
+void tmf8828ArraySetConfigure ( tmf8828Array * array, tmf8828ArrayConfigureFn configure )
+{
+  array->configure = configure;
+}
+
+void tmf8828ArraySetRecord ( tmf8828Array * array, tmf8828ArrayRecordFn record )
+{
+  array->record = record;
+}
+
+// the recovery needs the image to bring a device up again
+static void tmf8828ArraySetImage ( tmf8828Array * array, uint32_t imageStartAddress, const unsigned char * image, int32_t imageSizeInBytes, uint8_t modeIsTmf8828, uint8_t logLevel )
+{
+  array->imageStartAddress = imageStartAddress;
+  array->image = image;
+  array->imageSizeInBytes = imageSizeInBytes;
+  array->modeIsTmf8828 = !!modeIsTmf8828;
+  array->logLevel = logLevel;
+}
+
+uint8_t tmf8828ArrayResume ( tmf8828Array * array, uint32_t imageStartAddress, const unsigned char * image, int32_t imageSizeInBytes, uint8_t modeIsTmf8828, uint8_t logLevel )
+{
+  uint8_t i;
+  uint8_t running = 0;
+  if (  warmRecord.magic != WARM_RECORD_MAGIC 
+     || warmRecord.check != tmf8828ArrayWarmRecordCheck( &warmRecord )
+     || warmRecord.count != array->count
+     || warmRecord.modeIsTmf8828 != !!modeIsTmf8828
+     || warmRecord.imageSignature != tmf8828ArrayImageSignature( imageStartAddress, image, imageSizeInBytes )
+     )
+  {
+    return 0;
+  }
+  for ( i = 0; i < array->count; i++ )
+  {
+    tmf8828Driver * driver = array->sensor + i;
+    if ( warmRecord.activeMask & ( 1 << i ) )
+    {
+      driver->i2cSlaveAddress = tmf8828ArrayAddress( array, i );
+      tmf8828SetLogLevel( driver, logLevel );
+      tmf8828Wakeup( driver );                    // harmless if the device is awake already
+      if (  tmf8828ProbeApplication( driver ) != APP_SUCCESS_OK
+         || memcmp( driver->device.appVersion, warmRecord.appVersion[i], 4 ) != 0 
+         || tmf8828StopMeasurement( driver ) != APP_SUCCESS_OK                    // the device may still be measuring
+         )
+      {
+        return 0;                                 // a cold start re-initialises all devices
+      }
+      tmf8828DisableInterrupts( driver, 0xFF );
+      running++;
+    }
+  }
+  array->activeMask = warmRecord.activeMask;
+  array->recoverMask = 0;
+  tmf8828ArraySetImage( array, imageStartAddress, image, imageSizeInBytes, modeIsTmf8828, logLevel );
+  return running;
+}
+
+uint8_t tmf8828ArrayEnable ( tmf8828Array * array, uint32_t imageStartAddress, const unsigned char * image, int32_t imageSizeInBytes, uint8_t modeIsTmf8828, uint8_t logLevel )
+{
+  uint8_t i;
+  uint8_t running = 0;
+  warmRecord.magic = 0;                                   // whatever runs on the devices is about to be replaced
+  tmf8828ArraySetImage( array, imageStartAddress, image, imageSizeInBytes, modeIsTmf8828, logLevel );
+  for ( i = 0; i < array->count; i++ )        // all devices off, each one comes up at the default address when enabled
+  {
+    tmf8828Disable( array->sensor + i );
+  }
+  delayInMicroseconds( CAP_DISCHARGE_TIME_MS * 1000 );
+  array->activeMask = 0;
+  array->recoverMask = 0;
+
+  for ( i = 0; i < array->count; i++ )
+  {
+    tmf8828Driver * driver = array->sensor + i;
+    int8_t res;
+    tmf8828Enable( driver );
+    delayInMicroseconds( ENABLE_TIME_MS * 1000 );
+    tmf8828SetLogLevel( driver, logLevel );           // enable resets the driver instance
+    res = tmf8828ArrayBringUp( array, i );
+    if ( res == APP_SUCCESS_OK )
+    {
+      memcpy( warmRecord.appVersion[i], driver->device.appVersion, 4 );
+      array->activeMask |= (uint8_t)( 1 << i );
+      running++;
+    }
+    else
+    {
+      tmf8828Disable( driver );                        // else it would block the default address
+      PRINT_CONST_STR( ( "#Err" ) );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_CONST_STR( ( "array enable" ) );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_INT( i );
+      PRINT_CHAR( SEPARATOR );
+      PRINT_INT( res );
+      PRINT_LN( );
+    }
+  }
+  if ( running )                                          // remember what is running now for a warm start
+  {
+    warmRecord.imageSignature = tmf8828ArrayImageSignature( imageStartAddress, image, imageSizeInBytes );
+    warmRecord.modeIsTmf8828 = !!modeIsTmf8828;
+    warmRecord.count = array->count;
+    warmRecord.activeMask = array->activeMask;
+    warmRecord.magic = WARM_RECORD_MAGIC;                // part of the check, so it is set first
+    warmRecord.check = tmf8828ArrayWarmRecordCheck( &warmRecord );
+  }
+  return running;
+}
+
+uint8_t tmf8828ArrayStart ( tmf8828Array * array, uint8_t spadMapId )
+{
+  uint8_t i;
+  uint8_t running = 0;
+  disableInterrupts( );
+  array->pendingMask = 0;
+  enableInterrupts( );
+  array->building = 0;
+  array->spadMapId = spadMapId;
+  array->measuring = 1;
+  tmf8828ArrayStartFrame( array );
+  for ( i = 0; i < array->count; i++ )
+  {
+    if ( array->activeMask & ( 1 << i ) )
+    {
+      if ( tmf8828ArrayStartDevice( array, i ) == APP_SUCCESS_OK )
+      {
+        running++;
+      }
+      else
+      {
+        tmf8828ArrayDrop( array, i );
+      }
+    }
+  }
+  tmf8828ArrayResetStatistics( array );
+  return running;
+}
+
+void tmf8828ArrayStop ( tmf8828Array * array )
+{
+  uint8_t i;
+  array->measuring = 0;
+  for ( i = 0; i < array->count; i++ )
+  {
+    if ( array->activeMask & ( 1 << i ) )
+    {
+      clrInterruptHandler( array->sensor + i );
+      tmf8828StopMeasurement( array->sensor + i );
+      tmf8828DisableInterrupts( array->sensor + i, 0xFF );
+    }
+  }
+}
+
+// decode a result page of a device into its frame assembler, a completed frame goes into the merged frame.
+// Returns 1 if the merged frame had to be published to make room for it.
+static uint8_t tmf8828ArrayAddPage ( tmf8828Array * array, const tmf8828Record * record, const tmf8828ArrayFrame * * frame )
+{
+  uint8_t idx = record->device;
+  uint8_t published = 0;
+  tmf8828FrameAssembler * fa = &( array->assembler[ idx ] );
+  uint32_t torn = fa->torn;
+  const tmf8828Frame * done = tmf8828FrameAddPage( fa, record->page, record->hostTimestamp, record->captureTimestamp, record->clkCorrRatioUQ );
+  array->lastResultTick[ idx ] = record->hostTimestamp;
+  array->torn += fa->torn - torn;
+  if ( done )
+  {
+    tmf8828ArrayFrame * f = &( array->frame[ array->building ] );
+    if ( f->validMask & ( 1 << idx ) )        // device is one frame ahead of the others, do not wait for them any longer
+    {
+      *frame = tmf8828ArrayPublish( array );
+      published = 1;
+      f = &( array->frame[ array->building ] );
+    }
+    if ( !f->validMask )
+    {
+      f->hostTimestamp = done->hostTimestamp;
+    }
+    f->sensor[ idx ] = done;
+    f->validMask |= (uint8_t)( 1 << idx );
+    array->results++;
+  }
+  return published;
+}
+
+int8_t tmf8828ArrayService ( tmf8828Array * array, const tmf8828ArrayFrame * * frame )
+{
+  int8_t res = APP_SUCCESS_OK;
+  uint8_t pending;
+  uint8_t n;
+  disableInterrupts( );
+  pending = array->pendingMask;
+  array->pendingMask = 0;
+  enableInterrupts( );
+#if ( defined( USE_INTERRUPT_TO_TRIGGER_READ ) && (USE_INTERRUPT_TO_TRIGGER_READ != 0) )
+  if ( !pending )                 // woken up by a line that is still low or by the timeout, check all
+#endif
+  {
+    pending = array->activeMask;
+  }
+  pending &= array->activeMask;
+
+  for ( n = 0; n < array->count; n++ )
+  {
+    uint8_t idx = ( array->next + n ) % array->count;
+    tmf8828Driver * driver = array->sensor + idx;
+    uint8_t intStatus;
+    int8_t stat = APP_SUCCESS_OK;
+    if ( !( pending & ( 1 << idx ) ) )
+    {
+      continue;
+    }
+    intStatus = tmf8828GetAndClrInterrupts( driver, ARRAY_IRQ_MASK );   // always clear also the ANY interrupt
+    if ( intStatus & TMF8828_APP_I2C_RESULT_IRQ_MASK )
+    {
+      tmf8828Record record;
+      record.hostTimestamp = getSysTick( );
+      stat = tmf8828ReadResultPage( driver );
+      if ( stat == APP_SUCCESS_OK )
+      {
+        record.captureTimestamp = tmf8828DeviceTickToHost( driver, tmf8828GetUint32( driver->dataBuffer + RESULT_REG( SYS_TICK_0 ) ) );
+        record.clkCorrRatioUQ = tmf8828ClkCorrRatio( driver );
+        record.device = idx;
+        record.spadMapId = array->spadMapId;
+        record.page = driver->dataBuffer;
+        if ( array->record )
+        {
+          array->record( &record );
+        }
+        if ( tmf8828ArrayAddPage( array, &record, frame ) )
+        {
+          res = TMF8828_ARRAY_FRAME_READY;
+        }
+      }
+    }
+    if ( stat == APP_SUCCESS_OK && ( intStatus & TMF8828_APP_I2C_RAW_HISTOGRAM_IRQ_MASK ) )
+    {
+      if ( array->histogram[ idx ] )
+      {
+        uint32_t now = getSysTick( );
+        stat = tmf8828ReadHistogramPacket( driver );
+        if ( stat == APP_SUCCESS_OK )
+        {
+          tmf8828HistogramAddPacket( array->histogram[ idx ], driver->dataBuffer, driver->i2cSlaveAddress, now );
+        }
+      }
+      else
+      {
+        stat = tmf8828ReadHistogram( driver );
+      }
+    }
+    if ( stat != APP_SUCCESS_OK )
+    {
+      tmf8828ArrayFault( array, idx );
+      if ( res != TMF8828_ARRAY_FRAME_READY )
+      {
+        res = stat;
+      }
+    }
+  }
+  array->next = ( array->next + 1 ) % array->count;
+  for ( n = 0; n < array->count; n++ )          // a device that stopped delivering results has failed as well
+  {
+    if (  array->measuring && ( array->activeMask & ( 1 << n ) ) 
+       && getSysTick( ) - array->lastResultTick[ n ] > TMF8828_ARRAY_STALL_MS * 1000UL * HOST_TICKS_PER_US )
+    {
+      tmf8828ArrayFault( array, n );
+      if ( res != TMF8828_ARRAY_FRAME_READY )
+      {
+        res = APP_ERROR_TIMEOUT;
+      }
+    }
+  }
+
+  if ( res != TMF8828_ARRAY_FRAME_READY && array->activeMask                  // all running devices contributed
+    && ( array->frame[ array->building ].validMask & array->activeMask ) == array->activeMask )
+  {
+    *frame = tmf8828ArrayPublish( array );
+    res = TMF8828_ARRAY_FRAME_READY;
+  }
+  tmf8828ArrayRecover( array );
+  return res;
+}
+
+int8_t tmf8828ArrayReplay ( tmf8828Array * array, const tmf8828Record * record, const tmf8828ArrayFrame * * frame )
+{
+  uint8_t bit = (uint8_t)( 1 << record->device );
+  if ( record->device >= array->count )
+  {
+    return APP_ERROR_PARAM;
+  }
+  if ( record->spadMapId != array->spadMapId )
+  {
+    array->spadMapId = record->spadMapId;
+    array->activeMask = 0;
+    tmf8828ArrayStartFrame( array );
+  }
+  if ( !( array->activeMask & bit ) )
+  {
+    tmf8828FrameInitialise( &( array->assembler[ record->device ] ), array->spadMapId );
+    array->activeMask |= bit;
+  }
+  if ( tmf8828ArrayAddPage( array, record, frame ) )
+  {
+    return TMF8828_ARRAY_FRAME_READY;
+  }
+  if ( ( array->frame[ array->building ].validMask & array->activeMask ) == array->activeMask )
+  {
+    *frame = tmf8828ArrayPublish( array );
+    return TMF8828_ARRAY_FRAME_READY;
+  }
+  return APP_SUCCESS_OK;
+}
+
+int8_t tmf8828ArrayWait ( tmf8828Array * array, uint32_t timeoutInMs )
+{
+  uint8_t i;
+  for ( i = 0; i < array->count; i++ )
+  {
+    if ( array->measuring && ( array->recoverMask & ( 1 << i ) ) )
+    {
+      int32_t due = (int32_t)( array->recovery[i].dueTick - getSysTick( ) ) / (int32_t)( 1000 * HOST_TICKS_PER_US );
+      if ( due < (int32_t)timeoutInMs )
+      {
+        timeoutInMs = ( due > 0 ? (uint32_t)due : 0 );
+      }
+    }
+  }
+  return waitForAnyInterrupt( array->sensor, array->count, &( array->pendingMask ), timeoutInMs );
+}
+
+void tmf8828ArrayGetStatistics ( tmf8828Array * array, tmf8828ArrayStatistics * stats )
+{
+  stats->results = array->results;
+  stats->torn = array->torn;
+  stats->frames = array->frames;
+  stats->elapsedUs = getSysTick( ) - array->statisticsStart;
+  stats->aggregateFpsX10 = 0;
+  stats->frameFpsX10 = 0;
+  if ( stats->elapsedUs )
+  {
+    stats->aggregateFpsX10 = (uint32_t)( ( 10000000ull * stats->results ) / stats->elapsedUs );
+    stats->frameFpsX10 = (uint32_t)( ( 10000000ull * stats->frames ) / stats->elapsedUs );
+  }
+}
+
+void tmf8828ArrayResetStatistics ( tmf8828Array * array )
+{
+  array->results = 0;
+  array->torn = 0;
+  array->frames = 0;
+  array->statisticsStart = getSysTick( );
+}
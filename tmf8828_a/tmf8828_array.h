@@ -0,0 +1,271 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+#ifndef TMF8828_ARRAY_H
+#define TMF8828_ARRAY_H
+
+/** @file Array manager for several tmf8828/tmf882x on one host.
+ * The manager brings up the devices one after the other (so each can be moved to its own i2c slave 
+ * address), starts them together and reads their results round-robin or as their interrupt lines
+ * request it. Each device has its own frame assembler, the latest complete frame of every device is merged
+ * into one timestamped multi-sensor frame.
+ * A device that fails during the measurement (i2c error, or no results any more) is taken out of the merged
+ * frames and recovered with escalating actions: restart the measurement, configure it again, reset it, and
+ * at last disable and enable the whole array with firmware download. Failed attempts are retried with a 
+ * backoff that doubles up to TMF8828_RECOVER_BACKOFF_MAX_MS.
+ * Each result page can be handed to a record function as it is read, tmf8828ArrayReplay feeds such records
+ * back through the frame assemblers and the merging instead of the devices.
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf8828.h"
+#include "tmf8828_frame.h"
+#include "tmf8828_histogram.h"
+#include "tmf8828_record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define TMF8828_ARRAY_MAX_SENSORS         4     /**< bit-masks in the array are 8 bit, interrupt handlers limit this further */
+
+/** return value of tmf8828ArrayService when a merged frame was published */
+#define TMF8828_ARRAY_FRAME_READY         1
+
+/** recovery actions, in the order they are tried */
+#define TMF8828_RECOVER_RESTART           0     /**< stop and start the measurement */
+#define TMF8828_RECOVER_RECONFIGURE       1     /**< configure the device again, then start */
+#define TMF8828_RECOVER_RESET             2     /**< reset the device, download the firmware, configure and start */
+#define TMF8828_RECOVER_REENABLE          3     /**< disable and enable all devices with firmware download, configure and start */
+#define TMF8828_RECOVER_ACTIONS           4
+
+#define TMF8828_RECOVER_ATTEMPTS          2     /**< attempts of an action before the next one is tried */
+#define TMF8828_RECOVER_BACKOFF_MIN_MS    5     /**< wait after the first failed attempt */
+#define TMF8828_RECOVER_BACKOFF_MAX_MS    2000  /**< the wait doubles with every failed attempt up to this */
+#define TMF8828_RECOVER_SETTLE_MS         5000  /**< a device that fails again this soon after a recovery starts with the next action */
+
+#define TMF8828_ARRAY_STALL_MS            2000  /**< a measuring device without a result for this long has failed */
+
+#if ( TMF8828_ARRAY_MAX_SENSORS > MAX_INTERRUPT_HANDLERS )
+#error "each device of the array needs its own interrupt handler"
+#endif
+
+// ---------------------------------------------- types -------------------------------------------
+
+/** @brief One merged frame: the latest complete frame of each device that reported since the last merged frame.
+ */
+typedef struct _tmf8828ArrayFrame
+{
+  uint32_t hostTimestamp;                                           /**< sys-tick of the oldest device frame in this frame */
+  uint8_t validMask;                                                /**< bit i is set if sensor[i] belongs to this frame */
+  const tmf8828Frame * sensor[ TMF8828_ARRAY_MAX_SENSORS ];         /**< frame of each device, owned by its assembler */
+} tmf8828ArrayFrame;
+
+/** @brief Configures a device of the array for the measurement, e.g. with tmf8828Configure and the stored 
+ * calibration. Used by the recovery after the device lost its configuration.
+ * \return APP_SUCCESS_OK or APP_ERROR_*
+ */
+typedef int8_t (* tmf8828ArrayConfigureFn)( tmf8828Driver * driver );
+
+/** @brief Receives every result page right after it was read, e.g. tmf8828RecordStream. The record and its 
+ * page are only valid during the call.
+ */
+typedef void (* tmf8828ArrayRecordFn)( const tmf8828Record * record );
+
+/** @brief Recovery state of one device.
+ */
+typedef struct _tmf8828ArrayRecovery
+{
+  uint8_t action;                                   /**< TMF8828_RECOVER_* tried next */
+  uint8_t attempts;                                 /**< failed attempts of this action */
+  uint8_t settling;                                 /**< set when the device was recovered at recoveredTick */
+  uint16_t backoffMs;                               /**< wait after the last failed attempt */
+  uint32_t faultTick;                               /**< sys-tick when the device failed */
+  uint32_t dueTick;                                 /**< sys-tick of the next attempt */
+  uint32_t recoveredTick;                           /**< sys-tick of the last successful attempt */
+} tmf8828ArrayRecovery;
+
+/** @brief Frame rates since the last tmf8828ArrayResetStatistics.
+ */
+typedef struct _tmf8828ArrayStatistics
+{
+  uint32_t results;                                 /**< complete frames of all devices */
+  uint32_t torn;                                    /**< frames of all devices dropped because a sub-capture was missing */
+  uint32_t frames;                                  /**< merged frames published */
+  uint32_t elapsedUs;                               /**< time these were counted in */
+  uint32_t aggregateFpsX10;                         /**< complete frames per second of all devices together, times 10 */
+  uint32_t frameFpsX10;                             /**< merged frames per second, times 10 */
+} tmf8828ArrayStatistics;
+
+/** @brief The array manager, works on driver instances owned by the caller.
+ */
+typedef struct _tmf8828Array
+{
+  tmf8828Driver * sensor;                           /**< the driver instances, platform must be set */
+  uint8_t count;                                    /**< number of driver instances */
+  uint8_t activeMask;                               /**< bit i is set if device i is up and running */
+  uint8_t recoverMask;                              /**< bit i is set if device i failed and is being recovered */
+  uint8_t measuring;                                /**< set between tmf8828ArrayStart and tmf8828ArrayStop */
+  uint8_t spadMapId;                                /**< as given to tmf8828ArrayStart */
+  uint8_t next;                                     /**< device that is read first in the next round */
+  volatile uint8_t pendingMask;                     /**< bit i is set by the interrupt handler of device i */
+  uint8_t building;                                 /**< which of the two frames is being filled */
+  tmf8828ArrayFrame frame[ 2 ];                     /**< one is filled while the other one can be used */
+  tmf8828FrameAssembler assembler[ TMF8828_ARRAY_MAX_SENSORS ]; /**< assembles the pages of each device into frames */
+  tmf8828HistogramCapture * histogram[ TMF8828_ARRAY_MAX_SENSORS ]; /**< histogram capture of each device, 0-pointer to print histograms */
+  uint32_t lastResultTick[ TMF8828_ARRAY_MAX_SENSORS ]; /**< sys-tick of the last result page of each device */
+  tmf8828ArrayRecovery recovery[ TMF8828_ARRAY_MAX_SENSORS ];
+  tmf8828ArrayConfigureFn configure;                /**< 0-pointer: the recovery cannot go beyond a restart */
+  tmf8828ArrayRecordFn record;                      /**< 0-pointer: result pages are not recorded */
+  uint32_t imageStartAddress;                       /**< as given to tmf8828ArrayEnable/Resume, for the recovery */
+  const unsigned char * image;
+  int32_t imageSizeInBytes;
+  uint8_t modeIsTmf8828;
+  uint8_t logLevel;
+  uint32_t faults;                                  /**< recovery counters, never reset */
+  uint32_t recovered[ TMF8828_RECOVER_ACTIONS ];    /**< successful recoveries per action */
+  uint32_t recoverMaxUs;                            /**< longest time a device was out */
+  uint32_t results;                                 /**< statistic counters */
+  uint32_t torn;
+  uint32_t frames;
+  uint32_t statisticsStart;
+} tmf8828Array;
+
+// ---------------------------------------------- functions ---------------------------------------
+
+/** @brief Function binds the array manager to the given driver instances. The instances must already be
+ * initialised (tmf8828Initialise) and their pins and i2c bus opened.
+ * @param[in] array ... the array manager
+ * @param[in] sensor ... array of driver instances
+ * @param[in] count ... number of driver instances, at most TMF8828_ARRAY_MAX_SENSORS
+ */
+void tmf8828ArrayInitialise( tmf8828Array * array, tmf8828Driver * sensor, uint8_t count );
+
+/** @brief Function selects where the histogram packets of a device go. With a capture they are collected 
+ * into complete histograms, without one (default) they are printed with printHistogram.
+ * @param[in] array ... the array manager
+ * @param[in] idx ... device index
+ * @param[in] capture ... the capture, initialised by tmf8828ArrayStart, or 0-pointer
+ */
+void tmf8828ArraySetHistogramCapture( tmf8828Array * array, uint8_t idx, tmf8828HistogramCapture * capture );
+
+/** @brief Function sets how the recovery configures a device.
+ * @param[in] array ... the array manager
+ * @param[in] configure ... the configure function
+ */
+void tmf8828ArraySetConfigure( tmf8828Array * array, tmf8828ArrayConfigureFn configure );
+
+/** @brief Function sets where the result pages are recorded.
+ * @param[in] array ... the array manager
+ * @param[in] record ... the record function, 0-pointer to stop recording
+ */
+void tmf8828ArraySetRecord( tmf8828Array * array, tmf8828ArrayRecordFn record );
+
+/** @brief Function disables all devices, then enables them one after the other, downloads the firmware,
+ * selects the mode and moves every device but the last one to its own i2c slave address 
+ * (TMF8828_SLAVE_ADDR+1+index). A device that fails is kept disabled.
+ * @param[in] array ... the array manager
+ * @param[in] imageStartAddress ... image start address
+ * @param[in] image ... pointer to the firmware image
+ * @param[in] imageSizeInBytes ... size of the image
+ * @param[in] modeIsTmf8828 ... if non-zero the devices are switched to 8x8 mode, else to legacy mode
+ * @param[in] logLevel ... driver log level of all devices
+ * \return number of devices that are up and running
+ */
+uint8_t tmf8828ArrayEnable( tmf8828Array * array, uint32_t imageStartAddress, const unsigned char * image, int32_t imageSizeInBytes, uint8_t modeIsTmf8828, uint8_t logLevel );
+
+/** @brief Function tries a warm start: if the host was reset while the devices kept running the firmware that
+ * the last tmf8828ArrayEnable downloaded (same image, same mode, same application version, at the addresses 
+ * assigned then), the devices are only stopped and taken over. Otherwise nothing is changed and the caller
+ * has to use tmf8828ArrayEnable.
+ * @param[in] array ... the array manager
+ * @param[in] imageStartAddress ... image start address
+ * @param[in] image ... pointer to the firmware image
+ * @param[in] imageSizeInBytes ... size of the image
+ * @param[in] modeIsTmf8828 ... if non-zero the devices must be in 8x8 mode, else in legacy mode
+ * @param[in] logLevel ... driver log level of all devices
+ * \return number of devices that were taken over, 0 if a cold start is needed
+ */
+uint8_t tmf8828ArrayResume( tmf8828Array * array, uint32_t imageStartAddress, const unsigned char * image, int32_t imageSizeInBytes, uint8_t modeIsTmf8828, uint8_t logLevel );
+
+/** @brief Function arms the interrupts and starts the measurement on all running devices. Devices that 
+ * cannot be started are disabled.
+ * @param[in] array ... the array manager
+ * @param[in] spadMapId ... SPAD map the devices are configured with, selects the frame layout
+ * \return number of devices that are measuring
+ */
+uint8_t tmf8828ArrayStart( tmf8828Array * array, uint8_t spadMapId );
+
+/** @brief Function stops the measurement on all running devices. Devices in recovery stay there until the 
+ * next tmf8828ArrayStart.
+ * @param[in] array ... the array manager
+ */
+void tmf8828ArrayStop( tmf8828Array * array );
+
+/** @brief Function reads the results of the devices that signalled an interrupt (or of all running devices,
+ * if none signalled), starting round-robin with a different device each call. A merged frame is published 
+ * when every running device completed a frame, or when a device completes its next frame before the others
+ * caught up. A device that fails to deliver its page, or that did not deliver one for TMF8828_ARRAY_STALL_MS,
+ * is taken out of the merged frames and recovered, the recovery attempts that are due run at the end of this call.
+ * @param[in] array ... the array manager
+ * @param[out] frame ... set to the published frame, it stays valid until the next call
+ * \return TMF8828_ARRAY_FRAME_READY if a frame was published, APP_SUCCESS_OK if not, APP_ERROR_* if a device failed
+ */
+int8_t tmf8828ArrayService( tmf8828Array * array, const tmf8828ArrayFrame * * frame );
+
+/** @brief Function adds a recorded result page instead of reading one from a device, and publishes merged 
+ * frames like tmf8828ArrayService. Use it on an array that is not measuring: a device joins the merged frames
+ * with its first record, a change of the SPAD map starts over with the devices of the new map.
+ * @param[in] array ... the array manager
+ * @param[in] record ... the recorded page
+ * @param[out] frame ... set to the published frame, it stays valid until the next call
+ * \return TMF8828_ARRAY_FRAME_READY if a frame was published, APP_SUCCESS_OK if not, APP_ERROR_PARAM if the 
+ * device of the record is not part of the array
+ */
+int8_t tmf8828ArrayReplay( tmf8828Array * array, const tmf8828Record * record, const tmf8828ArrayFrame * * frame );
+
+/** @brief Function puts the calling core to sleep until any device of the array signals an interrupt.
+ * @param[in] array ... the array manager
+ * @param[in] timeoutInMs ... maximum time to sleep, shortened to the next recovery attempt
+ * \return 1 if an interrupt was triggered, 0 on timeout
+ */
+int8_t tmf8828ArrayWait( tmf8828Array * array, uint32_t timeoutInMs );
+
+/** @brief Function returns the counters and frame rates since the last reset.
+ * @param[in] array ... the array manager
+ * @param[out] stats ... counters and rates
+ */
+void tmf8828ArrayGetStatistics( tmf8828Array * array, tmf8828ArrayStatistics * stats );
+
+/** @brief Function restarts counting.
+ * @param[in] array ... the array manager
+ */
+void tmf8828ArrayResetStatistics( tmf8828Array * array );
+
+#ifdef __cplusplus
+}
+#endif  
+
+#endif // TMF8828_ARRAY_H
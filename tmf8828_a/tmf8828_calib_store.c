@@ -0,0 +1,288 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf8828_calib_store.h"
+#include <stddef.h>
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define CALIB_RECORD_MAGIC      0x43414C31      // "CAL1"
+#define CALIB_RECORD_FREE       0xFFFFFFFF      // erased flash
+#define CALIB_PAGE_SIZE         TMF8828_COM_CONFIG_FACTORY_CALIB__factory_calibration_size
+#define SLOTS_PER_SECTOR        ( FLASH_STORE_SECTOR_SIZE / FLASH_STORE_PAGE_SIZE )
+
+// ---------------------------------------------- types -------------------------------------------
+
+// one record per flash page
+typedef union _calibRecord
+{
+  struct
+  {
+    uint32_t magic;                             // CALIB_RECORD_FREE if the slot was never written
+    uint32_t sequence;                          // write counter, the highest sequence of a key is valid
+    uint32_t serialNumber;
+    uint8_t spadMapId;
+    uint8_t page;
+    uint8_t reserved[2];
+    uint8_t data[ CALIB_PAGE_SIZE ];
+    uint32_t crc;                               // CRC-32 over all fields before
+  } r;
+  uint8_t raw[ FLASH_STORE_PAGE_SIZE ];
+} calibRecord;
+
+typedef char calibRecordFitsFlashPage[ ( sizeof( calibRecord ) == FLASH_STORE_PAGE_SIZE ) ? 1 : -1 ];
+
+// ---------------------------------------------- variables -----------------------------------------
+
+static calibRecord record;                      // RAM copy for reading and programming, flash cannot be programmed from flash
+
+// ---------------------------------------------- functions -----------------------------------------
+
+static uint32_t calibStoreCrc ( const calibRecord * rec )
+{
+  uint32_t crc = 0xFFFFFFFF;
+  uint16_t i;
+  uint8_t b;
+  for ( i = 0; i < offsetof( calibRecord, r.crc ); i++ )
+  {
+    crc ^= rec->raw[i];
+    for ( b = 0; b < 8; b++ )
+    {
+      crc = ( crc >> 1 ) ^ ( 0xEDB88320 & ( 0 - ( crc & 1 ) ) );
+    }
+  }
+  return ~crc;
+}
+
+static const uint8_t * calibStoreSlot ( uint8_t sector, uint8_t slot )
+{
+  return flashStoreSector( sector ) + slot * FLASH_STORE_PAGE_SIZE;
+}
+
+// read a slot into the RAM copy, returns 1 if it holds a valid record
+static uint8_t calibStoreRead ( uint8_t sector, uint8_t slot )
+{
+  readProgramMemory( record.raw, calibStoreSlot( sector, slot ), FLASH_STORE_PAGE_SIZE );
+  return ( record.r.magic == CALIB_RECORD_MAGIC && record.r.crc == calibStoreCrc( &record ) );
+}
+
+// newest valid record of a key, returns 0 if there is none, else the sequence and its location
+static uint32_t calibStoreLookup ( uint32_t serialNumber, uint8_t spadMapId, uint8_t page, uint8_t * sector, uint8_t * slot )
+{
+  uint32_t best = 0;
+  uint8_t s, i;
+  for ( s = 0; s < FLASH_STORE_SECTORS; s++ )
+  {
+    for ( i = 0; i < SLOTS_PER_SECTOR; i++ )
+    {
+      if (  calibStoreRead( s, i ) 
+         && record.r.serialNumber == serialNumber && record.r.spadMapId == spadMapId && record.r.page == page 
+         && record.r.sequence > best 
+         )
+      {
+        best = record.r.sequence;
+        *sector = s;
+        *slot = i;
+      }
+    }
+  }
+  return best;
+}
+
+// the sector with the newest record is the one records are appended to
+static uint8_t calibStoreActiveSector ( uint32_t * sequence )
+{
+  uint8_t active = 0;
+  uint8_t s, i;
+  *sequence = 0;
+  for ( s = 0; s < FLASH_STORE_SECTORS; s++ )
+  {
+    for ( i = 0; i < SLOTS_PER_SECTOR; i++ )
+    {
+      if ( calibStoreRead( s, i ) && record.r.sequence > *sequence )
+      {
+        *sequence = record.r.sequence;
+        active = s;
+      }
+    }
+  }
+  return active;
+}
+
+// first slot that was never written, SLOTS_PER_SECTOR if the sector is full
+static uint8_t calibStoreFreeSlot ( uint8_t sector )
+{
+  uint8_t i;
+  uint32_t magic;
+  for ( i = 0; i < SLOTS_PER_SECTOR; i++ )
+  {
+    readProgramMemory( (uint8_t *)&magic, calibStoreSlot( sector, i ), sizeof( magic ) );
+    if ( magic == CALIB_RECORD_FREE )
+    {
+      break;
+    }
+  }
+  return i;
+}
+
+// copy the newest record of every key from sector 'from' to the erased sector 'to', except the key that
+// is about to be written. Returns the next free slot in 'to'.
+static uint8_t calibStoreCompact ( uint8_t from, uint8_t to, uint32_t serialNumber, uint8_t spadMapId, uint8_t page )
+{
+  uint8_t next = 0;
+  uint8_t i, j;
+  for ( i = 0; i < SLOTS_PER_SECTOR; i++ )
+  {
+    uint32_t keySerial;
+    uint8_t keyMap, keyPage;
+    uint8_t superseded = 0;
+    if ( !calibStoreRead( from, i ) )
+    {
+      continue;
+    }
+    keySerial = record.r.serialNumber;
+    keyMap = record.r.spadMapId;
+    keyPage = record.r.page;
+    if ( keySerial == serialNumber && keyMap == spadMapId && keyPage == page )
+    {
+      continue;
+    }
+    for ( j = i + 1; j < SLOTS_PER_SECTOR && !superseded; j++ )    // slots are written in order, a later one is newer
+    {
+      superseded = (  calibStoreRead( from, j ) 
+                   && record.r.serialNumber == keySerial && record.r.spadMapId == keyMap && record.r.page == keyPage );
+    }
+    if ( superseded || !calibStoreRead( from, i ) || flashStoreProgram( to, next * FLASH_STORE_PAGE_SIZE, record.raw ) != FLASH_SUCCESS )
+    {
+      continue;
+    }
+    next++;
+  }
+  return next;
+}
+
+const uint8_t * tmf8828CalibStoreFind ( uint32_t serialNumber, uint8_t spadMapId, uint8_t page )
+{
+  uint8_t sector, slot;
+  if ( calibStoreLookup( serialNumber, spadMapId, page, &sector, &slot ) )
+  {
+    return calibStoreSlot( sector, slot ) + offsetof( calibRecord, r.data );
+  }
+  return 0;
+}
+
+int8_t tmf8828CalibStoreWrite ( uint32_t serialNumber, uint8_t spadMapId, uint8_t page, const uint8_t * calibPage )
+{
+  uint32_t sequence;
+  uint8_t sector = calibStoreActiveSector( &sequence );
+  uint8_t slot = calibStoreFreeSlot( sector );
+  if ( slot >= SLOTS_PER_SECTOR )                           // full: move the valid records to the other sector
+  {
+    uint8_t other = ( sector + 1 ) % FLASH_STORE_SECTORS;
+    if ( flashStoreErase( other ) != FLASH_SUCCESS )
+    {
+      return APP_ERROR_CMD;
+    }
+    slot = calibStoreCompact( sector, other, serialNumber, spadMapId, page );
+    sector = other;
+    if ( slot >= SLOTS_PER_SECTOR )                         // cannot happen with less keys than slots
+    {
+      return APP_ERROR_CMD;
+    }
+  }
+  memset( record.raw, 0xFF, sizeof( record.raw ) );
+  record.r.magic = CALIB_RECORD_MAGIC;
+  record.r.sequence = sequence + 1;
+  record.r.serialNumber = serialNumber;
+  record.r.spadMapId = spadMapId;
+  record.r.page = page;
+  record.r.reserved[0] = 0;
+  record.r.reserved[1] = 0;
+  memcpy( record.r.data, calibPage, CALIB_PAGE_SIZE );
+  record.r.crc = calibStoreCrc( &record );
+  if ( flashStoreProgram( sector, slot * FLASH_STORE_PAGE_SIZE, record.raw ) != FLASH_SUCCESS )
+  {
+    return APP_ERROR_CMD;
+  }
+  return ( tmf8828CalibStoreFind( serialNumber, spadMapId, page ) ? APP_SUCCESS_OK : APP_ERROR_CMD );   // read back
+}
+
+int8_t tmf8828CalibStoreSaveDevice ( tmf8828Driver * driver, uint8_t spadMapId, uint8_t nrPages )
+{
+  int8_t status = APP_SUCCESS_OK;
+  uint8_t page;
+  if ( driver->device.deviceSerialNumber == 0 || nrPages == 0 || nrPages > TMF8828_CALIB_STORE_MAX_PAGES )
+  {
+    return APP_ERROR_PARAM;
+  }
+  if ( nrPages > 1 )
+  {
+    status = tmf8828ResetFactoryCalibration( driver );          // start with the first page
+  }
+  for ( page = 0; page < nrPages && status == APP_SUCCESS_OK; page++ )
+  {
+    status = tmf8828LoadConfigPageFactoryCalib( driver );
+    if ( status == APP_SUCCESS_OK )
+    {
+      status = i2cRxReg( driver, driver->i2cSlaveAddress, TMF8828_COM_CONFIG_RESULT, CALIB_PAGE_SIZE, driver->dataBuffer ) == I2C_SUCCESS ? APP_SUCCESS_OK : APP_ERROR_CMD;
+    }
+    if ( status == APP_SUCCESS_OK )
+    {
+      status = tmf8828CalibStoreWrite( driver->device.deviceSerialNumber, spadMapId, page, driver->dataBuffer );
+    }
+    if ( status == APP_SUCCESS_OK && nrPages > 1 )
+    {
+      status = tmf8828WriteConfigPage( driver );                // advance to next calib page
+    }
+  }
+  return status;
+}
+
+int8_t tmf8828CalibStoreLoadDevice ( tmf8828Driver * driver, uint8_t spadMapId, uint8_t nrPages )
+{
+  const uint8_t * pages[ TMF8828_CALIB_STORE_MAX_PAGES ];
+  int8_t status = APP_SUCCESS_OK;
+  uint8_t page;
+  if ( nrPages == 0 || nrPages > TMF8828_CALIB_STORE_MAX_PAGES )
+  {
+    return APP_ERROR_PARAM;
+  }
+  for ( page = 0; page < nrPages; page++ )
+  {
+    pages[page] = tmf8828CalibStoreFind( driver->device.deviceSerialNumber, spadMapId, page );
+    if ( pages[page] == 0 )
+    {
+      return APP_ERROR_NO_CALIB_PAGE;
+    }
+  }
+  if ( nrPages > 1 )
+  {
+    status = tmf8828ResetFactoryCalibration( driver );          // first reset, then load all calib pages
+  }
+  for ( page = 0; page < nrPages && status == APP_SUCCESS_OK; page++ )
+  {
+    status = tmf8828SetStoredFactoryCalibration( driver, pages[page] );
+  }
+  return status;
+}
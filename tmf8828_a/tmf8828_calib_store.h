@@ -0,0 +1,87 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+#ifndef TMF8828_CALIB_STORE_H
+#define TMF8828_CALIB_STORE_H
+
+/** @file Persistent factory calibration store.
+ * Calibration pages are kept in the reserved flash sectors (see flashStoreSector), keyed by the device serial 
+ * number, the SPAD map and the page index (tmf8828 8x8 mode has 4 pages per SPAD map, legacy mode 1).
+ * Every page is one flash page with its own CRC. Records are only appended, the newest record of a key is 
+ * the valid one. When the active sector is full, the valid records are copied to the other sector, so a 
+ * power loss during the copy never loses the previous content.
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf8828.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define TMF8828_CALIB_STORE_MAX_PAGES     4     /**< calibration pages per SPAD map in 8x8 mode */
+
+// ---------------------------------------------- functions ---------------------------------------
+
+/** @brief Function looks up a calibration page.
+ * @param[in] serialNumber ... device serial number as read by tmf8828ReadDeviceInfo
+ * @param[in] spadMapId ... SPAD map the page was calibrated for
+ * @param[in] page ... page index, 0 in legacy mode
+ * \return pointer to the complete calibration page (memory mapped flash, CRC checked), 0-pointer if there is none
+ */
+const uint8_t * tmf8828CalibStoreFind( uint32_t serialNumber, uint8_t spadMapId, uint8_t page );
+
+/** @brief Function stores a calibration page, an older page with the same key is replaced.
+ * @param[in] serialNumber ... device serial number
+ * @param[in] spadMapId ... SPAD map the page was calibrated for
+ * @param[in] page ... page index, 0 in legacy mode
+ * @param[in] calibPage ... complete calibration page (TMF8828_COM_CONFIG_FACTORY_CALIB__factory_calibration_size bytes)
+ * \return APP_SUCCESS_OK or APP_ERROR_CMD if the flash could not be written
+ */
+int8_t tmf8828CalibStoreWrite( uint32_t serialNumber, uint8_t spadMapId, uint8_t page, const uint8_t * calibPage );
+
+/** @brief Function reads all calibration pages of the currently configured SPAD map from the device and 
+ * stores them. Call this after a successful factory calibration and with the device info read.
+ * @param[in] driver ... driver instance
+ * @param[in] spadMapId ... SPAD map the device is configured for
+ * @param[in] nrPages ... 4 in 8x8 mode, 1 in legacy mode
+ * \return APP_SUCCESS_OK or an error code APP_ERROR_*
+ */
+int8_t tmf8828CalibStoreSaveDevice( tmf8828Driver * driver, uint8_t spadMapId, uint8_t nrPages );
+
+/** @brief Function writes the stored calibration pages of this device (identified by its serial number) 
+ * for the SPAD map to the device. The device is only touched if all pages are found.
+ * @param[in] driver ... driver instance, with the device info read
+ * @param[in] spadMapId ... SPAD map the device is configured for
+ * @param[in] nrPages ... 4 in 8x8 mode, 1 in legacy mode
+ * \return APP_SUCCESS_OK, APP_ERROR_NO_CALIB_PAGE if the store does not have the pages, or another error code APP_ERROR_*
+ */
+int8_t tmf8828CalibStoreLoadDevice( tmf8828Driver * driver, uint8_t spadMapId, uint8_t nrPages );
+
+#ifdef __cplusplus
+}
+#endif  
+
+#endif // TMF8828_CALIB_STORE_H
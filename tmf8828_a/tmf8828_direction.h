@@ -0,0 +1,128 @@
+/** @file Majority vote over the last per-frame directions of the gesture detection.
+ * The votes live in a circular buffer of at most N slots next to one counter per direction, so that adding a
+ * vote, evicting the oldest one and asking for the dominant direction each take a fixed number of operations.
+ * Window length, the run of equal votes needed before a direction is reported and the margin by which a new
+ * direction has to outvote the current one can all be changed at runtime, the memory stays N bytes.
+ */
+
+#ifndef TMF8828_DIRECTION_H
+#define TMF8828_DIRECTION_H
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ---------------------------------------------- types -------------------------------------------
+
+template <size_t N>
+class DirectionFilter {
+public:
+    static_assert(N > 0 && N < 256, "DirectionFilter needs 1..255 slots");
+
+    // '-' is no movement, the arrows are the characters of get_arrow
+    static constexpr char NONE = '-';
+
+    DirectionFilter(size_t window = N, size_t min_consecutive = 2, size_t hysteresis = 0) {
+        configure(window, min_consecutive, hysteresis);
+    }
+
+    // window is clamped to 1..N. Starts over with an empty window.
+    void configure(size_t window, size_t min_consecutive, size_t hysteresis) {
+        this->window = (uint8_t)(window < 1 ? 1 : window > N ? N : window);
+        this->min_consecutive = min_consecutive;
+        this->hysteresis = hysteresis;
+        clear();
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+        for (size_t i = 0; i < SLOTS; i++) {
+            votes_of[i] = 0;
+        }
+        last = 0;
+        consecutive = 0;
+        dominant = 0;
+    }
+
+    // Adds the direction of the latest frame. Returns it once it came min_consecutive times in a row
+    // and is the dominant direction of the window, else NONE.
+    char update(char direction) {
+        uint8_t slot = slot_of(direction);
+        if (count == window) {                      // evict the oldest vote
+            votes_of[votes[(head + N - count) % N]]--;
+            count--;
+        }
+        votes[head] = slot;
+        head = (uint8_t)((head + 1) % N);
+        count++;
+        votes_of[slot]++;
+
+        consecutive = (slot == last) ? consecutive + 1 : 1;
+        last = slot;
+
+        // an arrow takes over when it comes in with more than hysteresis votes ahead of the dominant one,
+        // or when the dominant one has no votes left
+        uint8_t lead = dominant != 0 ? votes_of[dominant] : 0;
+        if (slot != 0 && slot != dominant && votes_of[slot] > lead + hysteresis) {
+            dominant = slot;
+        }
+        if (dominant != 0 && votes_of[dominant] == 0) {
+            dominant = strongest();
+        }
+        if (slot != 0 && slot == dominant && consecutive >= min_consecutive) {
+            return direction;
+        }
+        return NONE;
+    }
+
+    // Direction with the most votes in the window, NONE while there are no arrows
+    char get_dominant_direction() const { return symbol(dominant); }
+
+    size_t size() const { return count; }
+    size_t window_length() const { return window; }
+    size_t min_consecutive_votes() const { return min_consecutive; }
+    size_t hysteresis_margin() const { return hysteresis; }
+
+private:
+    static constexpr size_t SLOTS = 5;
+
+    // slot 0 takes no movement and every character that is not an arrow
+    static char symbol(uint8_t slot) { return "-udlr"[slot]; }
+
+    static uint8_t slot_of(char direction) {
+        for (uint8_t i = 1; i < SLOTS; i++) {
+            if (symbol(i) == direction) {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    // Arrow with the most votes, slot 0 (no movement) does not take part
+    uint8_t strongest() const {
+        uint8_t best = 0;
+        uint8_t best_votes = 0;
+        for (uint8_t i = 1; i < SLOTS; i++) {
+            if (votes_of[i] > best_votes) {
+                best = i;
+                best_votes = votes_of[i];
+            }
+        }
+        return best;
+    }
+
+    uint8_t votes[N];           // slot of each vote, circular
+    uint8_t head;               // next vote to be written
+    uint8_t count;              // votes in the window
+    uint8_t votes_of[SLOTS];    // votes per slot in the window
+    uint8_t window;
+    uint8_t last;               // slot of the latest vote
+    size_t consecutive;         // how often the latest vote came in a row
+    uint8_t dominant;           // slot of the dominant arrow, 0 for none
+    size_t min_consecutive;
+    size_t hysteresis;
+};
+
+#endif // TMF8828_DIRECTION_H
@@ -0,0 +1,159 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf8828_frame.h"
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define NO_ZONE                 0xFF
+#define SUB_CAPTURE_MASK        0x03        // lower bits of RESULT_NUMBER in 8x8 mode
+
+// ---------------------------------------------- constants -----------------------------------------
+
+// 3x3 maps: records 0..8 are the zones, 9..17 are unused
+static const uint8_t slotToZone3x3[ TMF8828_FRAME_SLOTS_PER_PAGE ] =
+{ 0, 1, 2, 3, 4, 5, 6, 7, 8
+, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE
+};
+
+// 3x6 map: both time-multiplexed halves with 9 zones each
+static const uint8_t slotToZone3x6[ TMF8828_FRAME_SLOTS_PER_PAGE ] =
+{ 0, 1, 2, 3, 4, 5, 6, 7, 8
+, 9, 10, 11, 12, 13, 14, 15, 16, 17
+};
+
+// 4x4 maps and each 8x8 sub-capture: records 0..7 and 9..16 are the 16 zones, 8 and 17 are unused.
+// In 8x8 mode sub-capture k holds rows 2k and 2k+1.
+static const uint8_t slotToZone4x4[ TMF8828_FRAME_SLOTS_PER_PAGE ] =
+{ 0, 1, 2, 3, 4, 5, 6, 7, NO_ZONE
+, 8, 9, 10, 11, 12, 13, 14, 15, NO_ZONE
+};
+
+// ---------------------------------------------- functions ---------------------------------------
+
+static void tmf8828FrameSetLayout ( tmf8828FrameAssembler * fa, const uint8_t * slotToZone, uint8_t zonesPerPage, uint8_t pages, uint8_t rows, uint8_t cols )
+{
+  uint8_t i;
+  fa->slotToZone = slotToZone;
+  fa->zonesPerPage = zonesPerPage;
+  fa->pages = pages;
+  for ( i = 0; i < 2; i++ )
+  {
+    fa->frame[i].rows = rows;
+    fa->frame[i].cols = cols;
+    fa->frame[i].nrZones = rows * cols;
+  }
+}
+
+void tmf8828FrameInitialise ( tmf8828FrameAssembler * fa, uint8_t spadMapId )
+{
+  switch ( spadMapId )
+  {
+    case TMF8828_COM_SPAD_MAP_ID__spad_map_id__map_no_15:
+      tmf8828FrameSetLayout( fa, slotToZone4x4, 16, TMF8828_FRAME_MAX_PAGES, 8, 8 );
+      break;
+    case TMF8828_COM_SPAD_MAP_ID__spad_map_id__map_no_4:
+    case TMF8828_COM_SPAD_MAP_ID__spad_map_id__map_no_5:
+    case TMF8828_COM_SPAD_MAP_ID__spad_map_id__map_no_7:
+    case TMF8828_COM_SPAD_MAP_ID__spad_map_id__map_no_13:
+      tmf8828FrameSetLayout( fa, slotToZone4x4, 16, 1, 4, 4 );
+      break;
+    case TMF8828_COM_SPAD_MAP_ID__spad_map_id__map_no_10:
+      tmf8828FrameSetLayout( fa, slotToZone3x6, 18, 1, 6, 3 );
+      break;
+    default:                                                    // all other maps are 3x3
+      tmf8828FrameSetLayout( fa, slotToZone3x3, 9, 1, 3, 3 );
+      break;
+  }
+  fa->nextPage = fa->pages;
+  fa->building = 0;
+  fa->complete = 0;
+  fa->torn = 0;
+  fa->lastResultNumber = 0;
+  fa->sequence = 0;
+}
+
+const tmf8828Frame * tmf8828FrameAddPage ( tmf8828FrameAssembler * fa, const uint8_t * page, uint32_t hostTick, uint32_t captureTick, uint16_t clkCorrRatioUQ )
+{
+  uint32_t ratio = clkCorrRatioUQ;
+  tmf8828Frame * f = &( fa->frame[ fa->building ] );
+  uint8_t resultNumber = page[ RESULT_REG( RESULT_NUMBER ) ];
+  uint8_t subCapture = ( fa->pages > 1 ? ( resultNumber & SUB_CAPTURE_MASK ) : 0 );
+  const uint8_t * rec = page + RESULT_REG( RES_CONFIDENCE_0 );
+  uint16_t offset;
+  uint8_t t;
+  uint8_t i;
+
+  fa->sequence += (uint8_t)( resultNumber - fa->lastResultNumber );
+  fa->lastResultNumber = resultNumber;
+  if ( subCapture == 0 )
+  {
+    if ( fa->nextPage < fa->pages )           // previous frame did not get all its pages
+    {
+      fa->torn++;
+    }
+    f->hostTimestamp = hostTick;
+    f->captureTimestamp = captureTick;
+    f->sequence = fa->sequence;
+    f->resultNumber = resultNumber;
+    f->temperature = (int8_t)page[ RESULT_REG( TEMPERATURE ) ];
+  }
+  else if ( subCapture != fa->nextPage || (uint8_t)( resultNumber - f->resultNumber ) != subCapture )
+  {
+    if ( fa->nextPage < fa->pages )           // lost a page in between, wait for the next sub-capture 0
+    {
+      fa->torn++;
+      fa->nextPage = fa->pages;
+    }
+    return 0;
+  }
+
+  offset = subCapture * fa->zonesPerPage;
+  for ( t = 0; t < TMF8828_FRAME_TARGETS; t++ )          // records of the second target follow those of the first
+  {
+    uint16_t * distance = f->distance[t] + offset;
+    uint8_t * confidence = f->confidence[t] + offset;
+    for ( i = 0; i < TMF8828_FRAME_SLOTS_PER_PAGE; i++, rec += 3 )
+    {
+      uint8_t z = fa->slotToZone[i];
+      if ( z != NO_ZONE )
+      {
+        uint32_t d = ( (uint32_t)rec[2] << 8 ) | rec[1];
+        d = ( ratio * d + (1<<14) ) >> 15;                 // clock correction, same rounding as tmf8828CorrectDistance
+        confidence[z] = rec[0];
+        distance[z] = ( d > 0xFFFF ? 0xFFFF : (uint16_t)d );
+      }
+    }
+  }
+
+  fa->nextPage = subCapture + 1;
+  if ( fa->nextPage < fa->pages )
+  {
+    return 0;
+  }
+  fa->nextPage = fa->pages;                    // wait for the next sub-capture 0
+  fa->building = !fa->building;
+  fa->complete++;
+  return f;
+}
@@ -0,0 +1,106 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+#ifndef TMF8828_FRAME_H
+#define TMF8828_FRAME_H
+
+/** @file Frame assembler: decodes result pages into zone frames.
+ * In legacy (tmf882x) mode one result page holds all zones of a frame. In 8x8 (tmf8828) mode a frame is
+ * made of 4 sub-captures, the lower 2 bits of RESULT_NUMBER tell which one a page is. The assembler 
+ * decodes each page directly into the frame being built, drops torn frames (a missing or out of order 
+ * sub-capture) and publishes complete frames by pointer, so they are never copied again.
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf8828.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define TMF8828_FRAME_MAX_ZONES           64    /**< 8x8 */
+#define TMF8828_FRAME_MAX_PAGES           4     /**< sub-captures per 8x8 frame */
+#define TMF8828_FRAME_SLOTS_PER_PAGE      18    /**< result records per target in a page, the second target of slot s is in record s+18 */
+#define TMF8828_FRAME_TARGETS             2     /**< objects reported per zone */
+
+// ---------------------------------------------- types -------------------------------------------
+
+/** @brief One complete frame, zone index is row * cols + col. Per zone the device reports up to two 
+ * targets, target 0 is the one with the higher signal.
+ */
+typedef struct _tmf8828Frame
+{
+  uint32_t hostTimestamp;                                 /**< sys-tick when the first page of the frame was read */
+  uint32_t captureTimestamp;                              /**< sys-tick when the device captured the first page, see tmf8828DeviceTickToHost */
+  uint32_t sequence;                                      /**< RESULT_NUMBER of the first page, extended to 32 bit */
+  uint8_t resultNumber;                                   /**< RESULT_NUMBER of the first page */
+  int8_t temperature;                                     /**< device temperature in degree Celsius of the first page */
+  uint8_t rows;                                           /**< zone rows */
+  uint8_t cols;                                           /**< zone columns */
+  uint8_t nrZones;                                        /**< rows * cols */
+  uint16_t distance[ TMF8828_FRAME_TARGETS ][ TMF8828_FRAME_MAX_ZONES ];   /**< distance in mm, 0 if no object */
+  uint8_t confidence[ TMF8828_FRAME_TARGETS ][ TMF8828_FRAME_MAX_ZONES ];  /**< confidence of the distance */
+} tmf8828Frame;
+
+/** @brief Assembler state of one device.
+ */
+typedef struct _tmf8828FrameAssembler
+{
+  const uint8_t * slotToZone;                             /**< zone of each result slot within a page, 0xFF if unused */
+  uint8_t zonesPerPage;                                   /**< zone offset between two sub-captures */
+  uint8_t pages;                                          /**< pages per frame */
+  uint8_t nextPage;                                       /**< sub-capture expected next, pages if waiting for sub-capture 0 */
+  uint8_t building;                                       /**< which of the two frames is being filled */
+  uint8_t lastResultNumber;                               /**< RESULT_NUMBER of the last page, to extend it to 32 bit */
+  uint32_t sequence;                                      /**< extended RESULT_NUMBER of the last page */
+  tmf8828Frame frame[ 2 ];                                /**< one is filled while the other one is published */
+  uint32_t complete;                                      /**< number of published frames */
+  uint32_t torn;                                          /**< number of frames dropped because a page was missing */
+} tmf8828FrameAssembler;
+
+// ---------------------------------------------- functions ---------------------------------------
+
+/** @brief Function selects the zone layout for the given SPAD map and drops any partial frame.
+ * @param[in] fa ... the assembler
+ * @param[in] spadMapId ... SPAD map the device is configured with, map 15 is the 8x8 mode
+ */
+void tmf8828FrameInitialise( tmf8828FrameAssembler * fa, uint8_t spadMapId );
+
+/** @brief Function decodes one result page into the frame being built.
+ * @param[in] fa ... the assembler
+ * @param[in] page ... result page as read from TMF8828_COM_CONFIG_RESULT, use RESULT_REG() to index
+ * @param[in] hostTick ... sys-tick when the page was read
+ * @param[in] captureTick ... sys-tick when the device captured the page (its SYS_TICK mapped to the host)
+ * @param[in] clkCorrRatioUQ ... clock correction ratio in UQ1.15 applied to all distances while decoding, see tmf8828ClkCorrRatio
+ * \return the completed frame if this page completed one, else a 0-pointer. The frame stays valid 
+ * until the assembler publishes the next one.
+ */
+const tmf8828Frame * tmf8828FrameAddPage( tmf8828FrameAssembler * fa, const uint8_t * page, uint32_t hostTick, uint32_t captureTick, uint16_t clkCorrRatioUQ );
+
+#ifdef __cplusplus
+}
+#endif  
+
+#endif // TMF8828_FRAME_H
@@ -0,0 +1,185 @@
+/** @file Gesture events from the per-frame position of the hand.
+ * The engine is fed once per frame with the centroid and height of the close targets (or that there were none)
+ * and the filtered direction of the frame, and reports at most one event per frame:
+ *   swipe        'u', 'd', 'l', 'r'  the first frame of a filtered direction
+ *   double swipe 'U', 'D', 'L', 'R'  a swipe followed by the opposite one, upper case of the first direction
+ *   push         'p'                 the hand came closer by push_distance within push_window, with little sideways movement
+ *   pull         'o'                 the same away from the sensor
+ *   hover        'h'                 the hand stayed within hover_radius for hover_dwell
+ * An event carries the capture time of the frame that completed it. All state is part of the object, the last
+ * N close frames are kept for push and pull.
+ */
+
+#ifndef TMF8828_GESTURE_H
+#define TMF8828_GESTURE_H
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tmf8828_ring.h"
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define GESTURE_EVENT_NONE      '-'
+#define GESTURE_EVENT_PUSH      'p'
+#define GESTURE_EVENT_PULL      'o'
+#define GESTURE_EVENT_HOVER     'h'
+
+// ---------------------------------------------- types -------------------------------------------
+
+// Timing windows and distances of the events, times in us, distances in mm
+struct GestureTiming {
+    uint32_t swipe_window;      // the same direction again is a new swipe after this long without it
+    uint32_t double_window;     // the opposite swipe within this long after a swipe makes a double swipe
+    uint32_t push_window;       // push and pull have to cover push_distance within this long
+    uint32_t hover_dwell;       // the hand has to stay this long for a hover
+    uint16_t push_distance;
+    uint16_t hover_radius;      // also the sideways movement a push or pull may have
+};
+
+struct GestureEvent {
+    char type;                  // GESTURE_EVENT_NONE if the frame completed no gesture
+    uint32_t timestamp;         // capture time of the frame (us)
+};
+
+template <size_t N>
+class GestureEngine {
+public:
+    static_assert(N >= 2, "GestureEngine needs at least two frames");
+
+    explicit GestureEngine(const GestureTiming &timing) : timing(timing) { clear(); }
+
+    void configure(const GestureTiming &timing) {
+        this->timing = timing;
+        clear();
+    }
+
+    void clear() {
+        frames.clear();
+        swipe = GESTURE_EVENT_NONE;
+        swipe_time = 0;
+        swipe_start = 0;
+        double_armed = false;
+        hover_time = 0;
+        hover_done = false;
+    }
+
+    // Feed one frame. x, y: centroid of the close targets in 1/scale mm, z: their height in mm,
+    // close: there were close targets (x, y, z are ignored otherwise), direction: the filtered direction.
+    GestureEvent update(uint32_t timestamp, bool close, int32_t x, int32_t y, uint16_t z, int32_t scale, char direction) {
+        GestureEvent event = { GESTURE_EVENT_NONE, timestamp };
+        if (!close) {
+            frames.clear();                 // a double swipe may leave the field of view in between, keep the swipe
+            hover_done = false;
+            return event;
+        }
+        Frame &f = frames.push();
+        f.timestamp = timestamp;
+        f.x = x / scale;
+        f.y = y / scale;
+        f.z = z;
+
+        if (direction != GESTURE_EVENT_NONE) {
+            bool fresh = (direction != swipe || timestamp - swipe_time > timing.swipe_window);
+            bool opposite = (swipe != GESTURE_EVENT_NONE && direction == opposite_of(swipe));
+            if (fresh && double_armed && opposite && timestamp - swipe_start <= timing.double_window) {
+                event.type = (char)(swipe - 'a' + 'A');
+                double_armed = false;
+            } else if (fresh) {
+                event.type = direction;
+                double_armed = true;
+                swipe_start = timestamp;
+            }
+            swipe = direction;
+            swipe_time = timestamp;
+            if (event.type != GESTURE_EVENT_NONE) {
+                moved(f);
+                return event;
+            }
+        }
+
+        event.type = push_or_pull(f);
+        if (event.type != GESTURE_EVENT_NONE) {
+            moved(f);
+            return event;
+        }
+
+        if (frames.size() == 1 || !near(f, hover_anchor, timing.hover_radius)) {
+            hover_anchor = f;
+            hover_time = timestamp;
+            hover_done = false;
+        } else if (!hover_done && timestamp - hover_time >= timing.hover_dwell) {
+            hover_done = true;
+            event.type = GESTURE_EVENT_HOVER;
+        }
+        return event;
+    }
+
+private:
+    struct Frame {
+        uint32_t timestamp;
+        int32_t x;                  // mm
+        int32_t y;
+        int32_t z;
+    };
+
+    static char opposite_of(char direction) {
+        switch (direction) {
+        case 'u': return 'd';
+        case 'd': return 'u';
+        case 'l': return 'r';
+        case 'r': return 'l';
+        default:  return GESTURE_EVENT_NONE;
+        }
+    }
+
+    static int32_t abs32(int32_t v) { return v < 0 ? -v : v; }
+
+    static bool near(const Frame &a, const Frame &b, int32_t radius) {
+        return abs32(a.x - b.x) <= radius && abs32(a.y - b.y) <= radius && abs32(a.z - b.z) <= radius;
+    }
+
+    // Compares the newest frame with each frame of the last push_window that is within hover_radius
+    // sideways of it
+    char push_or_pull(const Frame &f) const {
+        for (size_t i = 0; i + 1 < frames.size(); i++) {
+            const Frame &old = frames[i];
+            if (f.timestamp - old.timestamp > timing.push_window) {
+                continue;
+            }
+            if (abs32(f.x - old.x) > timing.hover_radius || abs32(f.y - old.y) > timing.hover_radius) {
+                continue;
+            }
+            if (old.z - f.z >= timing.push_distance) {
+                return GESTURE_EVENT_PUSH;
+            }
+            if (f.z - old.z >= timing.push_distance) {
+                return GESTURE_EVENT_PULL;
+            }
+        }
+        return GESTURE_EVENT_NONE;
+    }
+
+    // After an event only the frames from now on count, and a hover starts over
+    void moved(const Frame &f) {
+        Frame last = f;
+        frames.clear();
+        frames.push(last);
+        hover_anchor = last;
+        hover_time = last.timestamp;
+        hover_done = false;
+    }
+
+    GestureTiming timing;
+    FrameRing<Frame, N> frames;     // close frames since the hand came or the last event
+    char swipe;                     // direction of the last swipe
+    uint32_t swipe_time;            // last frame with that direction
+    uint32_t swipe_start;           // frame that reported it
+    bool double_armed;              // the last swipe can be the first half of a double swipe
+    Frame hover_anchor;             // where the hand started to stay
+    uint32_t hover_time;
+    bool hover_done;                // the hover at the anchor was reported
+};
+
+#endif // TMF8828_GESTURE_H
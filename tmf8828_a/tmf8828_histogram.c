@@ -0,0 +1,179 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf8828_histogram.h"
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define HIST_TYPE_MASK          ( TMF8828_COM_HIST_DUMP__histogram__raw_24_bit_histogram | TMF8828_COM_HIST_DUMP__histogram__electrical_calibration_24_bit_histogram )
+#define STREAM_CHUNK            48      // bins serialised at once
+
+// ---------------------------------------------- functions -----------------------------------------
+
+void tmf8828HistogramInitialise ( tmf8828HistogramCapture * hc )
+{
+  hc->head = 0;
+  hc->count = 0;
+  hc->nextSubPacket = TMF8828_HIST_SUBPACKETS;
+  hc->sequence = 0;
+  hc->complete = 0;
+  hc->torn = 0;
+  hc->overwritten = 0;
+}
+
+const tmf8828Histogram * tmf8828HistogramAddPacket ( tmf8828HistogramCapture * hc, const uint8_t * packet, uint8_t i2cSlaveAddress, uint32_t hostTick )
+{
+  tmf8828Histogram * h = &( hc->ring[ hc->head ] );
+  uint8_t subPacket = packet[ RESULT_REG( SUBPACKET_NUMBER ) ];
+  uint8_t type = packet[0] & HIST_TYPE_MASK;
+  uint8_t cfgIdx = packet[ RESULT_REG( SUBPACKET_CFG_IDX ) ];
+  const uint8_t * payload = packet + RESULT_REG( SUBPACKET_PAYLOAD_0 );
+  uint32_t * bin;
+  uint8_t shift;
+  uint8_t i;
+
+  if ( subPacket == 0 )
+  {
+    if ( hc->nextSubPacket < TMF8828_HIST_SUBPACKETS )    // previous histogram did not get all its sub-packets
+    {
+      hc->torn++;
+    }
+    h->hostTimestamp = hostTick;
+    h->type = type;
+    h->cfgIdx = cfgIdx;
+    h->i2cSlaveAddress = i2cSlaveAddress;
+  }
+  else if ( subPacket != hc->nextSubPacket || type != h->type || cfgIdx != h->cfgIdx )
+  {
+    if ( hc->nextSubPacket < TMF8828_HIST_SUBPACKETS )    // lost a sub-packet, wait for the next sub-packet 0
+    {
+      hc->torn++;
+      hc->nextSubPacket = TMF8828_HIST_SUBPACKETS;
+    }
+    return 0;
+  }
+
+  bin = h->bin[ subPacket % TMF8828_HIST_CHANNELS ];
+  shift = 8 * ( subPacket / TMF8828_HIST_CHANNELS );
+  if ( shift == 0 )                                       // LSB comes first and initialises the bins
+  {
+    for ( i = 0; i < TMF8828_NUMBER_OF_BINS_PER_CHANNEL; i++ )
+    {
+      bin[i] = payload[i];
+    }
+  }
+  else
+  {
+    for ( i = 0; i < TMF8828_NUMBER_OF_BINS_PER_CHANNEL; i++ )
+    {
+      bin[i] |= (uint32_t)payload[i] << shift;
+    }
+  }
+
+  hc->nextSubPacket = subPacket + 1;
+  if ( hc->nextSubPacket < TMF8828_HIST_SUBPACKETS )
+  {
+    return 0;
+  }
+  h->sequence = hc->sequence++;
+  hc->complete++;
+  hc->head = ( hc->head + 1 ) % TMF8828_HIST_RING_SIZE;
+  if ( hc->count < TMF8828_HIST_RING_SIZE - 1 )          // the head slot is always free for the next histogram
+  {
+    hc->count++;
+  }
+  else
+  {
+    hc->overwritten++;
+  }
+  return h;
+}
+
+const tmf8828Histogram * tmf8828HistogramTake ( tmf8828HistogramCapture * hc )
+{
+  const tmf8828Histogram * h;
+  if ( hc->count == 0 )
+  {
+    return 0;
+  }
+  h = &( hc->ring[ ( hc->head + TMF8828_HIST_RING_SIZE - hc->count ) % TMF8828_HIST_RING_SIZE ] );
+  hc->count--;
+  return h;
+}
+
+// write bytes and update the fletcher-16 sums
+static void tmf8828HistogramWrite ( const uint8_t * data, uint16_t len, uint16_t * sum1, uint16_t * sum2 )
+{
+  uint16_t i;
+  for ( i = 0; i < len; i++ )
+  {
+    *sum1 = ( *sum1 + data[i] ) % 255;
+    *sum2 = ( *sum2 + *sum1 ) % 255;
+  }
+  writeBinary( data, len );
+}
+
+void tmf8828HistogramStream ( const tmf8828Histogram * h )
+{
+  uint8_t buf[ STREAM_CHUNK * TMF8828_HIST_BYTES_PER_BIN ];
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  uint8_t c;
+  uint8_t i;
+  buf[0] = TMF8828_HIST_SYNC_0;
+  buf[1] = TMF8828_HIST_SYNC_1;
+  buf[2] = h->type;
+  buf[3] = h->cfgIdx;
+  buf[4] = h->i2cSlaveAddress;
+  buf[5] = TMF8828_HIST_CHANNELS;
+  buf[6] = TMF8828_NUMBER_OF_BINS_PER_CHANNEL;
+  buf[7] = TMF8828_HIST_BYTES_PER_BIN;
+  buf[8] = (uint8_t)h->sequence;
+  buf[9] = (uint8_t)( h->sequence >> 8 );
+  buf[10] = (uint8_t)h->hostTimestamp;
+  buf[11] = (uint8_t)( h->hostTimestamp >> 8 );
+  buf[12] = (uint8_t)( h->hostTimestamp >> 16 );
+  buf[13] = (uint8_t)( h->hostTimestamp >> 24 );
+  tmf8828HistogramWrite( buf, TMF8828_HIST_RECORD_HEADER_SIZE, &sum1, &sum2 );
+  for ( c = 0; c < TMF8828_HIST_CHANNELS; c++ )
+  {
+    uint8_t start;
+    for ( start = 0; start < TMF8828_NUMBER_OF_BINS_PER_CHANNEL; start += STREAM_CHUNK )
+    {
+      uint8_t n = ( TMF8828_NUMBER_OF_BINS_PER_CHANNEL - start > STREAM_CHUNK ? STREAM_CHUNK : TMF8828_NUMBER_OF_BINS_PER_CHANNEL - start );
+      uint8_t * p = buf;
+      for ( i = 0; i < n; i++ )
+      {
+        uint32_t v = h->bin[c][ start + i ];
+        *p++ = (uint8_t)v;
+        *p++ = (uint8_t)( v >> 8 );
+        *p++ = (uint8_t)( v >> 16 );
+      }
+      tmf8828HistogramWrite( buf, n * TMF8828_HIST_BYTES_PER_BIN, &sum1, &sum2 );
+    }
+  }
+  buf[0] = (uint8_t)sum1;
+  buf[1] = (uint8_t)sum2;
+  writeBinary( buf, 2 );
+}
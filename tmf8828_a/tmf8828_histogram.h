@@ -0,0 +1,120 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+#ifndef TMF8828_HISTOGRAM_H
+#define TMF8828_HISTOGRAM_H
+
+/** @file Histogram capture: assembles the histogram sub-packets of one device into complete 24-bit 
+ * histograms and keeps the latest ones in a preallocated ring.
+ * A histogram dump is TMF8828_HIST_SUBPACKETS sub-packets of 128 bytes each. Sub-packet n carries byte 
+ * n / TMF8828_HIST_CHANNELS (LSB first) of all bins of channel n % TMF8828_HIST_CHANNELS. The sub-packets 
+ * of one histogram arrive in order with the same type and CFG_IDX, anything else drops the histogram.
+ * Complete histograms can be taken from the ring and written as a compact binary record, instead of 
+ * printing every sub-packet as text.
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf8828.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define TMF8828_HIST_CHANNELS             10    /**< 5 TDCs with 2 channels each */
+#define TMF8828_HIST_BYTES_PER_BIN        3     /**< 24-bit bins */
+#define TMF8828_HIST_SUBPACKETS           ( TMF8828_HIST_CHANNELS * TMF8828_HIST_BYTES_PER_BIN )
+
+#ifndef TMF8828_HIST_RING_SIZE
+#define TMF8828_HIST_RING_SIZE            4     /**< complete histograms kept, the oldest one is overwritten */
+#endif
+
+// binary record written by tmf8828HistogramStream, all fields little endian:
+// sync0, sync1, type, cfgIdx, i2cSlaveAddress, channels, bins, bytesPerBin, sequence (2), hostTimestamp (4),
+// channels * bins * bytesPerBin bytes (channel by channel, bin by bin, LSB first), fletcher-16 over all bytes before (2)
+#define TMF8828_HIST_SYNC_0               0xA5
+#define TMF8828_HIST_SYNC_1               0x5A
+#define TMF8828_HIST_RECORD_HEADER_SIZE   14
+
+// ---------------------------------------------- types -------------------------------------------
+
+/** @brief One complete histogram set of a device.
+ */
+typedef struct _tmf8828Histogram
+{
+  uint32_t hostTimestamp;                                 /**< sys-tick when the first sub-packet was read */
+  uint16_t sequence;                                      /**< counts the completed histograms of the capture */
+  uint8_t type;                                           /**< TMF8828_COM_HIST_DUMP__histogram__* */
+  uint8_t cfgIdx;                                         /**< CFG_IDX of the sub-packets */
+  uint8_t i2cSlaveAddress;                                /**< device the histogram was read from */
+  uint32_t bin[ TMF8828_HIST_CHANNELS ][ TMF8828_NUMBER_OF_BINS_PER_CHANNEL ];  /**< 24-bit bin values */
+} tmf8828Histogram;
+
+/** @brief Capture state and ring of one device.
+ */
+typedef struct _tmf8828HistogramCapture
+{
+  tmf8828Histogram ring[ TMF8828_HIST_RING_SIZE ];
+  uint8_t head;                                           /**< slot being filled */
+  uint8_t count;                                          /**< complete histograms in the ring, not yet taken */
+  uint8_t nextSubPacket;                                  /**< expected next, TMF8828_HIST_SUBPACKETS if waiting for sub-packet 0 */
+  uint16_t sequence;                                      /**< sequence of the next completed histogram */
+  uint32_t complete;                                      /**< number of completed histograms */
+  uint32_t torn;                                          /**< histograms dropped because a sub-packet was missing */
+  uint32_t overwritten;                                   /**< complete histograms overwritten before they were taken */
+} tmf8828HistogramCapture;
+
+// ---------------------------------------------- functions ---------------------------------------
+
+/** @brief Function empties the ring and drops any partial histogram.
+ * @param[in] hc ... the capture
+ */
+void tmf8828HistogramInitialise( tmf8828HistogramCapture * hc );
+
+/** @brief Function adds one histogram packet.
+ * @param[in] hc ... the capture
+ * @param[in] packet ... packet as read from TMF8828_COM_CONFIG_RESULT, TMF8828_COM_HISTOGRAM_PACKET_SIZE bytes
+ * @param[in] i2cSlaveAddress ... device the packet was read from
+ * @param[in] hostTick ... sys-tick when the packet was read
+ * \return the completed histogram if this packet completed one, else a 0-pointer
+ */
+const tmf8828Histogram * tmf8828HistogramAddPacket( tmf8828HistogramCapture * hc, const uint8_t * packet, uint8_t i2cSlaveAddress, uint32_t hostTick );
+
+/** @brief Function takes the oldest complete histogram out of the ring.
+ * @param[in] hc ... the capture
+ * \return the histogram, it stays valid until TMF8828_HIST_RING_SIZE-1 further histograms are completed, 
+ * 0-pointer if the ring is empty
+ */
+const tmf8828Histogram * tmf8828HistogramTake( tmf8828HistogramCapture * hc );
+
+/** @brief Function writes a histogram as one binary record (see TMF8828_HIST_SYNC_0) with writeBinary.
+ * @param[in] h ... the histogram
+ */
+void tmf8828HistogramStream( const tmf8828Histogram * h );
+
+#ifdef __cplusplus
+}
+#endif  
+
+#endif // TMF8828_HISTOGRAM_H
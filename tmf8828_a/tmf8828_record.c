@@ -0,0 +1,134 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf8828_record.h"
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define RECORD_PAGE_SIZE_IDX    4       // position of the page size in the record
+
+// ---------------------------------------------- functions -----------------------------------------
+
+// update the fletcher-16 sums over len bytes
+static void tmf8828RecordSum ( const uint8_t * data, uint16_t len, uint16_t * sum1, uint16_t * sum2 )
+{
+  uint16_t i;
+  for ( i = 0; i < len; i++ )
+  {
+    *sum1 = ( *sum1 + data[i] ) % 255;
+    *sum2 = ( *sum2 + *sum1 ) % 255;
+  }
+}
+
+static void tmf8828RecordPutUint32 ( uint8_t * p, uint32_t v )
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)( v >> 8 );
+  p[2] = (uint8_t)( v >> 16 );
+  p[3] = (uint8_t)( v >> 24 );
+}
+
+void tmf8828RecordStream ( const tmf8828Record * record )
+{
+  uint8_t buf[ TMF8828_RECORD_HEADER_SIZE ];
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  buf[0] = TMF8828_RECORD_SYNC_0;
+  buf[1] = TMF8828_RECORD_SYNC_1;
+  buf[2] = record->device;
+  buf[3] = record->spadMapId;
+  buf[ RECORD_PAGE_SIZE_IDX ] = TMF8828_RECORD_PAGE_SIZE;
+  tmf8828RecordPutUint32( buf + 5, record->hostTimestamp );
+  tmf8828RecordPutUint32( buf + 9, record->captureTimestamp );
+  buf[13] = (uint8_t)record->clkCorrRatioUQ;
+  buf[14] = (uint8_t)( record->clkCorrRatioUQ >> 8 );
+  tmf8828RecordSum( buf, TMF8828_RECORD_HEADER_SIZE, &sum1, &sum2 );
+  tmf8828RecordSum( record->page, TMF8828_RECORD_PAGE_SIZE, &sum1, &sum2 );
+  writeBinary( buf, TMF8828_RECORD_HEADER_SIZE );
+  writeBinary( record->page, TMF8828_RECORD_PAGE_SIZE );
+  buf[0] = (uint8_t)sum1;
+  buf[1] = (uint8_t)sum2;
+  writeBinary( buf, 2 );
+}
+
+void tmf8828RecordParserInitialise ( tmf8828RecordParser * parser )
+{
+  parser->fill = 0;
+  parser->records = 0;
+  parser->dropped = 0;
+}
+
+// drop the record being collected and search the bytes after its sync bytes for the next one
+static void tmf8828RecordResync ( tmf8828RecordParser * parser )
+{
+  uint16_t n = parser->fill;
+  uint16_t i;
+  parser->dropped++;
+  parser->fill = 0;
+  for ( i = 2; i < n; i++ )               // the bytes move down in the buffer, never past the one being read
+  {
+    tmf8828RecordParse( parser, parser->buffer[i] );
+  }
+}
+
+const tmf8828Record * tmf8828RecordParse ( tmf8828RecordParser * parser, uint8_t byte )
+{
+  uint8_t * b = parser->buffer;
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  if ( parser->fill == 0 && byte != TMF8828_RECORD_SYNC_0 )
+  {
+    return 0;
+  }
+  if ( parser->fill == 1 && byte != TMF8828_RECORD_SYNC_1 )
+  {
+    parser->fill = ( byte == TMF8828_RECORD_SYNC_0 );      // b[0] is the sync byte already
+    return 0;
+  }
+  b[ parser->fill++ ] = byte;
+  if ( parser->fill == RECORD_PAGE_SIZE_IDX + 1 && byte != TMF8828_RECORD_PAGE_SIZE )
+  {
+    tmf8828RecordResync( parser );
+    return 0;
+  }
+  if ( parser->fill < TMF8828_RECORD_SIZE )
+  {
+    return 0;
+  }
+  tmf8828RecordSum( b, TMF8828_RECORD_SIZE - 2, &sum1, &sum2 );
+  if ( b[ TMF8828_RECORD_SIZE - 2 ] != sum1 || b[ TMF8828_RECORD_SIZE - 1 ] != sum2 )
+  {
+    tmf8828RecordResync( parser );
+    return 0;
+  }
+  parser->fill = 0;
+  parser->records++;
+  parser->record.device = b[2];
+  parser->record.spadMapId = b[3];
+  parser->record.hostTimestamp = tmf8828GetUint32( b + 5 );
+  parser->record.captureTimestamp = tmf8828GetUint32( b + 9 );
+  parser->record.clkCorrRatioUQ = (uint16_t)( b[13] | ( b[14] << 8 ) );
+  parser->record.page = b + TMF8828_RECORD_HEADER_SIZE;
+  return &( parser->record );
+}
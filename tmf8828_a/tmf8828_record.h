@@ -0,0 +1,103 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+#ifndef TMF8828_RECORD_H
+#define TMF8828_RECORD_H
+
+/** @file Record and replay of raw result pages.
+ * Every result page read by the array can be written as a compact binary record: the page exactly as read
+ * plus what the array derived from the device state when it read it (host and capture time, clock 
+ * correction, SPAD map). Feeding the records back with tmf8828ArrayReplay runs the same decoding and frame
+ * merging as the measurement, without any device, so captured sessions can be replayed on the host build 
+ * or on the target.
+ * The parser finds the records in a byte stream that may also contain text and histogram records.
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include "tmf8828.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  
+
+// ---------------------------------------------- defines -----------------------------------------
+
+// binary record written by tmf8828RecordStream, all fields little endian:
+// sync0, sync1, device, spadMapId, pageSize, hostTimestamp (4), captureTimestamp (4), clkCorrRatioUQ (2), 
+// pageSize bytes of the result page, fletcher-16 over all bytes before (2)
+#define TMF8828_RECORD_SYNC_0             0xA5
+#define TMF8828_RECORD_SYNC_1             0x52  /**< 'R', histogram records use 0x5A */
+#define TMF8828_RECORD_HEADER_SIZE        15
+#define TMF8828_RECORD_PAGE_SIZE          TMF8828_COM_CONFIG_RESULT__measurement_result_size
+#define TMF8828_RECORD_SIZE               ( TMF8828_RECORD_HEADER_SIZE + TMF8828_RECORD_PAGE_SIZE + 2 )
+
+// ---------------------------------------------- types -------------------------------------------
+
+/** @brief One result page with the state it is decoded with.
+ */
+typedef struct _tmf8828Record
+{
+  uint32_t hostTimestamp;                                 /**< sys-tick when the page was read */
+  uint32_t captureTimestamp;                              /**< sys-tick when the device captured the page */
+  uint16_t clkCorrRatioUQ;                                /**< clock correction ratio in UQ1.15 the distances are decoded with */
+  uint8_t device;                                         /**< index of the device in the array */
+  uint8_t spadMapId;                                      /**< SPAD map the device measured with, selects the frame layout */
+  const uint8_t * page;                                   /**< TMF8828_RECORD_PAGE_SIZE bytes as read from TMF8828_COM_CONFIG_RESULT */
+} tmf8828Record;
+
+/** @brief Parser state, collects the bytes of one record.
+ */
+typedef struct _tmf8828RecordParser
+{
+  uint8_t buffer[ TMF8828_RECORD_SIZE ];
+  uint16_t fill;                                          /**< bytes in the buffer, starting with the sync bytes */
+  tmf8828Record record;                                   /**< the last parsed record, its page points into buffer */
+  uint32_t records;                                       /**< records parsed */
+  uint32_t dropped;                                       /**< records dropped because of a wrong page size or checksum */
+} tmf8828RecordParser;
+
+// ---------------------------------------------- functions ---------------------------------------
+
+/** @brief Function writes one record (see TMF8828_RECORD_SYNC_0) with writeBinary.
+ * @param[in] record ... the record
+ */
+void tmf8828RecordStream( const tmf8828Record * record );
+
+/** @brief Function resets the parser and its counters.
+ * @param[in] parser ... the parser
+ */
+void tmf8828RecordParserInitialise( tmf8828RecordParser * parser );
+
+/** @brief Function adds one byte of the stream. Bytes outside of records are skipped, a record with a wrong 
+ * checksum is dropped and the search continues right after its sync bytes.
+ * @param[in] parser ... the parser
+ * @param[in] byte ... next byte of the stream
+ * \return the record if this byte completed one, else a 0-pointer. The record stays valid until the next call.
+ */
+const tmf8828Record * tmf8828RecordParse( tmf8828RecordParser * parser, uint8_t byte );
+
+#ifdef __cplusplus
+}
+#endif  
+
+#endif // TMF8828_RECORD_H
@@ -0,0 +1,56 @@
+/** @file Fixed-capacity ring buffer used for the measurement frame history.
+ * All storage is part of the object itself, pushing and clearing never touch the heap.
+ * When the ring is full the oldest element is overwritten.
+ */
+
+#ifndef TMF8828_RING_H
+#define TMF8828_RING_H
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include <stddef.h>
+
+// ---------------------------------------------- types -------------------------------------------
+
+template <typename T, size_t N>
+class FrameRing {
+public:
+    static_assert(N > 0, "FrameRing needs at least one slot");
+
+    FrameRing() : head(0), count(0) {}
+
+    // Returns the slot for the newest element. If the ring is full, this is the slot of
+    // the oldest element, which is dropped.
+    T &push() {
+        T &slot = items[head];
+        head = (head + 1) % N;
+        if (count < N) {
+            count++;
+        }
+        return slot;
+    }
+
+    void push(const T &item) {
+        push() = item;
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    static constexpr size_t capacity() { return N; }
+
+    // Index 0 is the oldest element, size()-1 the newest one
+    const T &operator[](size_t i) const { return items[(head + N - count + i) % N]; }
+    const T &back() const { return items[(head + N - 1) % N]; }
+
+private:
+    T items[N];
+    size_t head;    // next slot to be written
+    size_t count;   // number of valid elements
+};
+
+#endif // TMF8828_RING_H
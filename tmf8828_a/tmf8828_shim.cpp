@@ -22,11 +22,27 @@
 
 #include "tmf8828_shim.h"
 #include "tmf8828.h"
+#include "pico/sync.h"
+#include "hardware/dma.h"
+#include "hardware/structs/systick.h"
+#include "hardware/flash.h"
+#include "pico/flash.h"
+
+// handler registered with setInterruptHandler, one per interrupt pin
+typedef struct _interruptEntry
+{
+  void * dptr;                                       // 0-pointer if entry is free
+  interruptHandlerFn handler;
+  void * context;
+  uint8_t pin;
+} interruptEntry;
 
+static interruptEntry interruptHandlers[ MAX_INTERRUPT_HANDLERS ];
+static critical_section_t interruptSection;          // serialises the handler against disableInterrupts/enableInterrupts on both cores
 
 void delayInMicroseconds ( uint32_t wait )
 {
-    sleep_ms( wait );
+    sleep_us( wait );
 }
 
 uint32_t getSysTick ( )
@@ -35,6 +51,17 @@ uint32_t getSysTick ( )
   return (uint32_t) get_absolute_time();
 }
 
+uint32_t getCycleCount ( )
+{
+  if ( !( systick_hw->csr & M0PLUS_SYST_CSR_ENABLE_BITS ) )    // each core has its own SysTick, started on first use
+  {
+    systick_hw->rvr = CYCLE_COUNT_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+  }
+  return CYCLE_COUNT_MASK - systick_hw->cvr;                 // SysTick counts down
+}
+
 uint8_t readProgramMemoryByte ( const uint8_t * ptr )
 {
   uint32_t address = (uint32_t)ptr;
@@ -42,43 +69,69 @@ uint8_t readProgramMemoryByte ( const uint8_t * ptr )
   //return pgm_read_byte( address );
 }
 
+void readProgramMemory ( uint8_t * dst, const uint8_t * src, uint16_t len )
+{
+  memcpy( dst, src, len );
+}
+
+// bus and pins of the driver instance dptr points to
+static const tmf8828Platform * platformOf ( void * dptr )
+{
+  return &( ((tmf8828Driver *)dptr)->platform );
+}
+
 void enablePinHigh ( void * dptr )
 {
-  (void)dptr; // not used here
-  gpio_put(ENABLE_PIN, true);
+  gpio_put( platformOf( dptr )->enablePin, true );
 }
 
 void enablePinLow ( void * dptr )
 {
-  (void)dptr; // not used here
-  gpio_put(ENABLE_PIN, false);
+  gpio_put( platformOf( dptr )->enablePin, false );
 }
 
 void configurePins ( void * dptr )
 {
-  gpio_init(ENABLE_PIN);
-  gpio_set_dir(ENABLE_PIN, GPIO_OUT);
-  // gpio_init(INTERRUPT_PIN);
-  // gpio_set_dir(INTERRUPT_PIN, GPIO_IN);
-  // gpio_pull_up(INTERRUPT_PIN);
-  // gpio_init(TRIGGER_INTERRUPT_PIN);           // if interrupt PIN is used        
+  const tmf8828Platform * platform = platformOf( dptr );
+  gpio_init( platform->enablePin );
+  gpio_put( platform->enablePin, gpio_get( platform->enablePin ) );   // keep the level of the line, a device that is enabled (pulled up) stays on
+  gpio_set_dir( platform->enablePin, GPIO_OUT );
+  gpio_init( platform->interruptPin );
+  gpio_set_dir( platform->interruptPin, GPIO_IN );
+  gpio_pull_up( platform->interruptPin );       // interrupt line is open drain
+  if ( !critical_section_is_initialized( &interruptSection ) )
+  {
+    critical_section_init( &interruptSection );
+  }
 }
 
 
+#if ( defined( USE_I2C_DMA ) && ( USE_I2C_DMA != 0 ) )
+static void i2cDmaOpen( i2c_inst_t * i2c );
+static void i2cDmaClose( i2c_inst_t * i2c );
+#endif
+
+// several driver instances may share one bus, opening it again is harmless
 void i2cOpen ( void * dptr, uint32_t i2cClockSpeedInHz )
 {
-  (void)dptr; // not used here
-  i2c_init(i2c0,i2cClockSpeedInHz);
-  gpio_set_function(16, GPIO_FUNC_I2C);
-  gpio_set_function(17, GPIO_FUNC_I2C);
-  gpio_pull_up(16);
-  gpio_pull_up(17);
+  const tmf8828Platform * platform = platformOf( dptr );
+  i2c_init( platform->i2c, i2cClockSpeedInHz );
+  gpio_set_function( platform->sdaPin, GPIO_FUNC_I2C );
+  gpio_set_function( platform->sclPin, GPIO_FUNC_I2C );
+  gpio_pull_up( platform->sdaPin );
+  gpio_pull_up( platform->sclPin );
+#if ( defined( USE_I2C_DMA ) && ( USE_I2C_DMA != 0 ) )
+  i2cDmaOpen( platform->i2c );
+#endif
 }
 
 void i2cClose ( void * dptr )
 {
-  (void)dptr; // not used here
-  i2c_deinit(i2c0);
+  const tmf8828Platform * platform = platformOf( dptr );
+#if ( defined( USE_I2C_DMA ) && ( USE_I2C_DMA != 0 ) )
+  i2cDmaClose( platform->i2c );
+#endif
+  i2c_deinit( platform->i2c );
 }
 
 
@@ -113,6 +166,14 @@ void printLn ( void )
     printf("\n");
 }
 
+void writeBinary ( const uint8_t * data, uint16_t len )
+{
+  while ( len-- )
+  {
+    putchar_raw( *data++ );
+  }
+}
+
 
 // function prints a single result, and returns incremented pointer
 static uint8_t * print_result ( tmf8828Driver * driver, uint8_t * data )
@@ -243,28 +304,95 @@ void pinInput ( uint8_t pin )
   // No direct equivalent in stdio, typically handled by GPIO library
 }
 
-void setInterruptHandler( void (* handler)( void ) )
+// gpio callback runs on the core that registered the handler, wake up the other core with sev
+static void gpioInterruptCallback ( uint gpio, uint32_t events )
 {
-  // attachInterrupt( digitalPinToInterrupt( INTERRUPT_PIN ), handler, FALLING );
-  // No direct equivalent in stdio, typically handled by GPIO library
+  uint8_t i;
+  if ( events & GPIO_IRQ_EDGE_FALL )
+  {
+    critical_section_enter_blocking( &interruptSection );
+    for ( i = 0; i < MAX_INTERRUPT_HANDLERS; i++ )
+    {
+      if ( interruptHandlers[i].dptr && interruptHandlers[i].pin == gpio )
+      {
+        interruptHandlers[i].handler( interruptHandlers[i].dptr, interruptHandlers[i].context );
+      }
+    }
+    critical_section_exit( &interruptSection );
+    __sev( );
+  }
 }
 
-void disableInterruptHandler( uint8_t pin )
+void setInterruptHandler( void * dptr, interruptHandlerFn handler, void * context )
 {
-  // detachInterrupt( digitalPinToInterrupt( pin ) );
-  // No direct equivalent in stdio, typically handled by GPIO library
+  uint8_t i;
+  uint8_t pin = platformOf( dptr )->interruptPin;
+  clrInterruptHandler( dptr );                                    // at most one handler per device
+  for ( i = 0; i < MAX_INTERRUPT_HANDLERS; i++ )
+  {
+    if ( !interruptHandlers[i].dptr )
+    {
+      critical_section_enter_blocking( &interruptSection );
+      interruptHandlers[i].handler = handler;
+      interruptHandlers[i].context = context;
+      interruptHandlers[i].pin = pin;
+      interruptHandlers[i].dptr = dptr;
+      critical_section_exit( &interruptSection );
+      gpio_set_irq_enabled_with_callback( pin, GPIO_IRQ_EDGE_FALL, true, &gpioInterruptCallback );
+      return;
+    }
+  }
+}
+
+void clrInterruptHandler( void * dptr )
+{
+  uint8_t i;
+  for ( i = 0; i < MAX_INTERRUPT_HANDLERS; i++ )
+  {
+    if ( interruptHandlers[i].dptr == dptr )
+    {
+      gpio_set_irq_enabled( interruptHandlers[i].pin, GPIO_IRQ_EDGE_FALL, false );
+      critical_section_enter_blocking( &interruptSection );
+      interruptHandlers[i].dptr = 0;
+      critical_section_exit( &interruptSection );
+    }
+  }
 }
 
 void disableInterrupts ( void )
 {
-  // noInterrupts( );
-  // No direct equivalent in stdio, typically handled by system calls
+  critical_section_enter_blocking( &interruptSection );
 }
 
 void enableInterrupts ( void )
 {
-  // interrupts( );
-  // No direct equivalent in stdio, typically handled by system calls
+  critical_section_exit( &interruptSection );
+}
+
+int8_t waitForInterrupt ( void * dptr, volatile uint8_t * triggered, uint32_t timeoutInMs )
+{
+  return waitForAnyInterrupt( (tmf8828Driver *)dptr, 1, triggered, timeoutInMs );
+}
+
+int8_t waitForAnyInterrupt ( tmf8828Driver * drivers, uint8_t count, volatile uint8_t * triggered, uint32_t timeoutInMs )
+{
+  absolute_time_t timeout = make_timeout_time_ms( timeoutInMs );
+  uint8_t i;
+  while ( !*triggered )
+  {
+    for ( i = 0; i < count; i++ )
+    {
+      if ( !gpio_get( drivers[i].platform.interruptPin ) )   // line is still (or again) low, e.g. edge happened before handler was armed
+      {
+        return 1;
+      }
+    }
+    if ( best_effort_wfe_or_timeout( timeout ) )  // sleeps until any event (sev from the gpio callback) or timeout
+    {
+      return 0;
+    }
+  }
+  return 1;
 }
 
 char inputGetKey ( )  
@@ -274,131 +402,439 @@ char inputGetKey ( )
 }
 
 
+// ----------------------------------------- flash store ---------------------------------------
+
+// The reserved sectors sit at the very end of the flash, the linker places code and data from the start.
+#define FLASH_STORE_OFFSET      ( (uint32_t)( PICO_FLASH_SIZE_BYTES - FLASH_STORE_SECTORS * FLASH_STORE_SECTOR_SIZE ) )
+#define FLASH_STORE_TIMEOUT_MS  100        // how long to wait for the other core to park itself
+
+// parameters of one erase/program, executed with the other core locked out
+typedef struct _flashStoreOperation
+{
+  uint32_t offset;                          // offset from the start of the flash
+  const uint8_t * data;                     // 0-pointer to erase
+} flashStoreOperation;
+
+static void flashStoreExecute ( void * param )
+{
+  const flashStoreOperation * op = (const flashStoreOperation *)param;
+  if ( op->data )
+  {
+    flash_range_program( op->offset, op->data, FLASH_STORE_PAGE_SIZE );
+  }
+  else
+  {
+    flash_range_erase( op->offset, FLASH_STORE_SECTOR_SIZE );
+  }
+}
+
+const uint8_t * flashStoreSector ( uint8_t sector )
+{
+  if ( sector >= FLASH_STORE_SECTORS )
+  {
+    return 0;
+  }
+  return (const uint8_t *)( XIP_BASE + FLASH_STORE_OFFSET + sector * FLASH_STORE_SECTOR_SIZE );
+}
+
+int8_t flashStoreErase ( uint8_t sector )
+{
+  flashStoreOperation op = { FLASH_STORE_OFFSET + sector * FLASH_STORE_SECTOR_SIZE, 0 };
+  if ( sector >= FLASH_STORE_SECTORS )
+  {
+    return FLASH_ERR_PARAM;
+  }
+  return ( flash_safe_execute( flashStoreExecute, &op, FLASH_STORE_TIMEOUT_MS ) == PICO_OK ? FLASH_SUCCESS : FLASH_ERR_LOCKOUT );
+}
+
+int8_t flashStoreProgram ( uint8_t sector, uint16_t offset, const uint8_t * data )
+{
+  flashStoreOperation op = { FLASH_STORE_OFFSET + sector * FLASH_STORE_SECTOR_SIZE + offset, data };
+  if ( sector >= FLASH_STORE_SECTORS || offset >= FLASH_STORE_SECTOR_SIZE || ( offset % FLASH_STORE_PAGE_SIZE ) )
+  {
+    return FLASH_ERR_PARAM;
+  }
+  return ( flash_safe_execute( flashStoreExecute, &op, FLASH_STORE_TIMEOUT_MS ) == PICO_OK ? FLASH_SUCCESS : FLASH_ERR_LOCKOUT );
+}
+
+
 // ----------------------------------------- i2c ---------------------------------------
 
-static int8_t i2cTxOnly ( uint8_t logLevel, uint8_t slaveAddr, uint8_t regAddr, uint16_t toTx, const uint8_t * txData )
-{  // split long transfers into max of 32-bytes: 1 byte is register address, up to 31 are payload.
-  int8_t res = I2C_SUCCESS;
-  //printf("i2cTxOnly, slaveAddr: %x, regAddr: %x, toTx: %d, txData: %s\n", slaveAddr, regAddr, toTx, txData);
-  do 
+// All i2c state is kept per bus, so that instances on different buses never share anything.
+
+static i2cStatistics i2cStats[ NUM_I2CS ];      // accumulated bus statistics, see i2cGetStatistics
+
+// which i2c controller the device is connected to
+static i2c_inst_t * i2cBus ( void * dptr )
+{
+  return platformOf( dptr )->i2c;
+}
+
+static void i2cLogTransfer ( uint8_t logLevel, const char * dir, uint8_t slaveAddr, uint16_t len, const uint8_t * data )
+{
+  if ( logLevel & TMF8828_LOG_LEVEL_I2C ) 
   {
-    //printf("do start\n");
-    uint8_t tx;
-    if ( toTx > ARDUINO_MAX_I2C_TRANSFER - 1) 
-    {
-      tx = ARDUINO_MAX_I2C_TRANSFER - 1;
-    }
-    else 
+    PRINT_STR( dir );
+    PRINT_STR( " (0x" );
+    PRINT_UINT_HEX( slaveAddr );
+    PRINT_STR( ")" );
+    PRINT_STR( " len=" );
+    PRINT_INT( len );
+    if ( logLevel >= TMF8828_LOG_LEVEL_DEBUG ) 
     {
-      tx = toTx; // less than 31 bytes 
+      while ( len-- )
+      {
+        PRINT_STR( " 0x" );
+        PRINT_UINT_HEX( *data );
+        data++;
+      }
     }
-    if ( logLevel & TMF8828_LOG_LEVEL_I2C ) 
+    PRINT_LN( );
+  }
+}
+
+static void i2cAccount ( i2c_inst_t * i2c, uint16_t bytes, uint32_t start, uint32_t cpuBusy )
+{
+  i2cStatistics * stats = &i2cStats[ i2c_hw_index( i2c ) ];
+  stats->transactions++;
+  stats->bytes += bytes;
+  stats->busTimeUs += getSysTick( ) - start;
+  stats->cpuBusyTimeUs += cpuBusy;
+}
+
+// map pico sdk result to our return codes
+static int8_t i2cResult ( int res, uint16_t expected )
+{
+  if ( res == (int)expected )
+  {
+    return I2C_SUCCESS;
+  }
+  if ( res == PICO_ERROR_TIMEOUT )
+  {
+    return I2C_ERR_TIMEOUT;
+  }
+  if ( res == PICO_ERROR_GENERIC )
+  {
+    return I2C_ERR_SLAVE_ADDR_NAK;          // sdk reports address and data nak the same way
+  }
+  return I2C_ERR_OTHER;
+}
+
+// register address and payload are sent as one transaction
+static int8_t i2cTxOnly ( void * dptr, uint8_t logLevel, uint8_t slaveAddr, uint8_t regAddr, uint16_t toTx, const uint8_t * txData )
+{
+  uint8_t buffer[ I2C_MAX_TRANSFER + 1 ];
+  uint32_t start = getSysTick( );
+  int res;
+  if ( toTx > I2C_MAX_TRANSFER )
+  {
+    return I2C_ERR_DATA_TOO_LONG;
+  }
+  buffer[0] = regAddr;
+  memcpy( &buffer[1], txData, toTx );
+  i2cLogTransfer( logLevel, "I2C-TX", slaveAddr, toTx + 1, buffer );
+  res = i2c_write_blocking( i2cBus( dptr ), slaveAddr, buffer, toTx + 1, false );
+  i2cAccount( i2cBus( dptr ), toTx + 1, start, getSysTick( ) - start );
+  return i2cResult( res, toTx + 1 );
+}
+
+static int8_t i2cRxOnly ( void * dptr, uint8_t logLevel, uint8_t slaveAddr, uint16_t toRx, uint8_t * rxData )
+{
+  uint32_t start = getSysTick( );
+  int res = i2c_read_blocking( i2cBus( dptr ), slaveAddr, rxData, toRx, false );
+  i2cAccount( i2cBus( dptr ), toRx, start, getSysTick( ) - start );
+  i2cLogTransfer( logLevel, "I2C-RX", slaveAddr, toRx, rxData );
+  return i2cResult( res, toRx );
+}
+
+#if ( defined( USE_I2C_DMA ) && ( USE_I2C_DMA != 0 ) )
+
+// A register read is a single transaction: START, address+W, regAddr, RESTART, address+R, toRx bytes, STOP.
+// The TX channel feeds the controller with the command words, the RX channel collects the data.
+typedef struct _i2cDmaTransfer
+{
+  i2c_inst_t * i2c;
+  uint32_t cmd[ I2C_MAX_TRANSFER + 1 ];           // data_cmd words: 1 register address write + toRx read commands
+  int txChannel;
+  int rxChannel;
+  i2cDoneCallback done;                           // called from the DMA interrupt
+  void * context;
+  uint8_t * rxData;
+  uint16_t toRx;
+  uint8_t slaveAddr;
+  uint8_t logLevel;
+  uint32_t start;                                 // sys-tick when the transfer was started
+  uint32_t cpuBusy;                               // time spent setting up the transfer
+  volatile uint8_t busy;
+} i2cDmaTransfer;
+
+static i2cDmaTransfer i2cDma[ NUM_I2CS ] = { { .i2c = 0, .txChannel = -1, .rxChannel = -1 }, { .i2c = 0, .txChannel = -1, .rxChannel = -1 } };
+static critical_section_t i2cDmaSection;              // only one of the DMA interrupt, the tx abort interrupt and the timeout finishes a transfer
+
+static i2cDmaTransfer * i2cDmaOf ( i2c_inst_t * i2c )
+{
+  return &i2cDma[ i2c_hw_index( i2c ) ];
+}
+
+// the STOP condition may still be on the bus when the last byte was received
+static void i2cWaitIdle ( i2c_hw_t * hw )
+{
+  uint32_t start = getSysTick( );
+  while ( ( hw->status & I2C_IC_STATUS_ACTIVITY_BITS ) && ( getSysTick( ) - start ) < 1000 )
+  {
+    tight_loop_contents( );
+  }
+}
+
+static void i2cDmaFinish ( i2cDmaTransfer * t, int8_t result )
+{
+  i2cDoneCallback done = t->done;
+  i2c_get_hw( t->i2c )->intr_mask = 0;
+  i2cAccount( t->i2c, t->toRx + 1, t->start, t->cpuBusy );
+  t->busy = 0;
+  if ( done )
+  {
+    done( t->context, result );
+  }
+  __sev( );                                       // wake up a core waiting in i2cRxReg
+}
+
+static void i2cDmaIrqHandler ( void )
+{
+  uint8_t i;
+  for ( i = 0; i < NUM_I2CS; i++ )
+  {
+    i2cDmaTransfer * t = &i2cDma[ i ];
+    if ( t->rxChannel >= 0 && dma_channel_get_irq0_status( t->rxChannel ) )
     {
-      PRINT_STR( "I2C-TX (0x" );
-      PRINT_UINT_HEX( slaveAddr );
-      PRINT_STR( ")" );
-      PRINT_STR( " tx=" );
-      PRINT_INT( tx+1 );          // +1 for regAddr
-      PRINT_STR( " 0x" );
-      PRINT_UINT_HEX( regAddr );
-      if ( logLevel >= TMF8828_LOG_LEVEL_DEBUG ) 
+      critical_section_enter_blocking( &i2cDmaSection );
+      dma_channel_acknowledge_irq0( t->rxChannel );
+      if ( t->busy )
       {
-        uint8_t dumpTx = tx;
-        const uint8_t * dump = txData;
-        while ( dumpTx-- )
-        {
-          PRINT_STR( " 0x" );
-          PRINT_UINT_HEX( *dump );
-          dump++;
-        }
+        i2cDmaFinish( t, I2C_SUCCESS );
       }
-      PRINT_LN( );
+      critical_section_exit( &i2cDmaSection );
     }
+  }
+}
 
-    uint8_t buffer[ARDUINO_MAX_I2C_TRANSFER];
-    buffer[0] = regAddr;
-    memcpy(&buffer[1], txData, tx);
-    //printf("i2c write start\n");
-    res = i2c_write_blocking(i2c0, slaveAddr, buffer, tx + 1, false);
-    if (res != PICO_ERROR_GENERIC)
+// abort a transfer that did not complete, e.g. because the slave nak'ed. Runs in the tx abort interrupt and
+// on the core waiting in i2cRxReg, a transfer that already finished is left alone.
+static void i2cDmaAbort ( i2cDmaTransfer * t, i2c_inst_t * i2c, int8_t result )
+{
+  i2c_hw_t * hw = i2c_get_hw( i2c );
+  uint32_t start;
+  critical_section_enter_blocking( &i2cDmaSection );
+  if ( t->busy )
+  {
+    dma_channel_set_irq0_enabled( t->rxChannel, false );
+    dma_channel_abort( t->txChannel );
+    dma_channel_abort( t->rxChannel );
+    dma_channel_acknowledge_irq0( t->rxChannel );
+    dma_channel_set_irq0_enabled( t->rxChannel, true );
+    hw->dma_cr = 0;
+    if ( hw->status & I2C_IC_STATUS_ACTIVITY_BITS )
     {
-        res = I2C_SUCCESS;
+      hw->enable |= I2C_IC_ENABLE_ABORT_BITS;     // the controller may still clock queued command words, end with a STOP
+      start = getSysTick( );
+      while ( ( hw->enable & I2C_IC_ENABLE_ABORT_BITS ) && ( getSysTick( ) - start ) < 1000 )
+      {
+        tight_loop_contents( );
+      }
     }
-    //printf("i2c_write_blocking, slaveAddr: %x, buffer: %s, tx: %d, res: %d toTx: %d\n", slaveAddr, buffer, tx, res, toTx);
-    toTx -= tx;
-    txData += tx;
-    regAddr += tx;
-  } while ( toTx && res == I2C_SUCCESS );
-  //printf("i2cTxOnly done res: %d\n", res);
-  return res;
+    (void)hw->clr_tx_abrt;                        // reading clears the abort and flushes the FIFOs
+    i2cDmaFinish( t, result );
+  }
+  critical_section_exit( &i2cDmaSection );
 }
 
-static int8_t i2cRxOnly ( uint8_t logLevel, uint8_t slaveAddr, uint16_t toRx, uint8_t * rxData )
-{   // split long transfers into max of 32-bytes
-  uint8_t expected = 0;
-  uint8_t rx = 0;
-  int8_t res = I2C_SUCCESS;
-  //printf("i2cRxOnly, slaveAddr: %d, toRx: %d, rxData: %s\n", slaveAddr, toRx, rxData);
-  do 
+// the error code of a tx abort, the slave did not ack its address or a byte
+static int8_t i2cAbortResult ( i2c_hw_t * hw )
+{
+  return ( hw->tx_abrt_source & I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS ) ? I2C_ERR_SLAVE_ADDR_NAK : I2C_ERR_DATA_NAK;
+}
+
+// A nak'ed transfer never completes its RX channel, so the tx abort of the controller ends it. The interrupt is
+// only unmasked while a DMA transfer runs, the blocking SDK functions read the abort themselves.
+static void i2cAbortIrqHandler ( void )
+{
+  uint8_t i;
+  for ( i = 0; i < NUM_I2CS; i++ )
   {
-    uint8_t * dump = rxData; // in case we dump on uart, we need the pointer
-    if ( toRx > ARDUINO_MAX_I2C_TRANSFER ) 
+    i2cDmaTransfer * t = &i2cDma[ i ];
+    i2c_hw_t * hw;
+    if ( !t->i2c )
     {
-      expected = ARDUINO_MAX_I2C_TRANSFER;
+      continue;
     }
-    else 
+    hw = i2c_get_hw( t->i2c );
+    if ( hw->intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS )
     {
-      expected = toRx; // less than 32 bytes 
+      hw->intr_mask = 0;
+      i2cDmaAbort( t, t->i2c, i2cAbortResult( hw ) );
     }
-    res = i2c_read_blocking(i2c0, slaveAddr, rxData, expected, false);
-    //printf("rxdata: %s, expected: %d, rx: %d\n", *rxData, expected, rx);
-    rx = expected;
-    toRx -= expected;
-    rxData += expected;
-    if ( logLevel & TMF8828_LOG_LEVEL_I2C ) 
+  }
+}
+
+static void i2cDmaOpen ( i2c_inst_t * i2c )
+{
+  static uint8_t irqInstalled = 0;
+  i2cDmaTransfer * t = i2cDmaOf( i2c );
+  i2c_get_hw( i2c )->intr_mask = 0;              // i2c_init unmasks the reset set, only the tx abort is used
+  if ( t->rxChannel < 0 )
+  {
+    t->i2c = i2c;
+    t->txChannel = dma_claim_unused_channel( true );
+    t->rxChannel = dma_claim_unused_channel( true );
+    dma_channel_set_irq0_enabled( t->rxChannel, true );
+    if ( !irqInstalled )
     {
-      PRINT_STR( "I2C-RX (0x" );
-      PRINT_UINT_HEX( slaveAddr );
-      PRINT_STR( ")" );
-      PRINT_STR( " toRx=" );
-      PRINT_INT( rx );
-      if ( logLevel >= TMF8828_LOG_LEVEL_DEBUG ) 
-      {
-        uint8_t dumpRx = rx;
-        while ( dumpRx-- )
-        {
-          PRINT_STR( " 0x" );
-          PRINT_UINT_HEX( *dump );
-          dump++;
-        }
-      }
-      PRINT_LN( );
+      critical_section_init( &i2cDmaSection );
+      irq_add_shared_handler( DMA_IRQ_0, i2cDmaIrqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY );
+      irq_set_enabled( DMA_IRQ_0, true );
+      irqInstalled = 1;
     }
-  } while ( toRx && expected == rx );
-  if ( toRx || expected != rx )
+    irq_add_shared_handler( I2C0_IRQ + i2c_hw_index( i2c ), i2cAbortIrqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY );
+    irq_set_enabled( I2C0_IRQ + i2c_hw_index( i2c ), true );
+  }
+}
+
+static void i2cDmaClose ( i2c_inst_t * i2c )
+{
+  i2cDmaTransfer * t = i2cDmaOf( i2c );
+  if ( t->rxChannel >= 0 )
   {
-    res = I2C_ERR_TIMEOUT;
+    i2c_get_hw( i2c )->intr_mask = 0;
+    irq_set_enabled( I2C0_IRQ + i2c_hw_index( i2c ), false );
+    irq_remove_handler( I2C0_IRQ + i2c_hw_index( i2c ), i2cAbortIrqHandler );
+    dma_channel_set_irq0_enabled( t->rxChannel, false );
+    dma_channel_unclaim( t->txChannel );
+    dma_channel_unclaim( t->rxChannel );
+    t->txChannel = -1;
+    t->rxChannel = -1;
   }
-  //printf("i2cRxOnly done res: %d\n", res);
-  return res;
 }
 
-int8_t i2cTxReg ( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t toTx, const uint8_t * txData )
-{  // split long transfers into max of 32-bytes
+int8_t i2cRxRegAsync ( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t toRx, uint8_t * rxData, i2cDoneCallback done, void * context )
+{
   tmf8828Driver * driver = (tmf8828Driver *)dptr;
-  return i2cTxOnly( driver->logLevel, slaveAddr, regAddr, toTx, txData ); 
+  i2c_inst_t * i2c = i2cBus( dptr );
+  i2cDmaTransfer * t = i2cDmaOf( i2c );
+  i2c_hw_t * hw = i2c_get_hw( i2c );
+  dma_channel_config c;
+  uint16_t i;
+  if ( toRx == 0 || toRx > I2C_MAX_TRANSFER )
+  {
+    return I2C_ERR_DATA_TOO_LONG;
+  }
+  if ( t->busy )
+  {
+    return I2C_ERR_OTHER;
+  }
+  t->start = getSysTick( );
+  t->busy = 1;
+  t->done = done;
+  t->context = context;
+  t->rxData = rxData;
+  t->toRx = toRx;
+  t->slaveAddr = slaveAddr;
+  t->logLevel = driver->logLevel;
+
+  t->cmd[0] = regAddr;
+  for ( i = 1; i <= toRx; i++ )
+  {
+    t->cmd[i] = I2C_IC_DATA_CMD_CMD_BITS;         // read one byte
+  }
+  t->cmd[1] |= I2C_IC_DATA_CMD_RESTART_BITS;      // change direction with a repeated start
+  t->cmd[toRx] |= I2C_IC_DATA_CMD_STOP_BITS;      // and release the bus after the last byte
+
+  i2cWaitIdle( hw );
+  hw->enable = 0;
+  hw->tar = slaveAddr;
+  hw->enable = I2C_IC_ENABLE_ENABLE_BITS;
+  hw->dma_tdlr = 4;                               // refill tx fifo when it is half empty
+  hw->dma_rdlr = 0;                               // fetch every received byte
+  hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+
+  c = dma_channel_get_default_config( t->rxChannel );
+  channel_config_set_transfer_data_size( &c, DMA_SIZE_8 );
+  channel_config_set_read_increment( &c, false );
+  channel_config_set_write_increment( &c, true );
+  channel_config_set_dreq( &c, i2c_get_dreq( i2c, false ) );
+  dma_channel_configure( t->rxChannel, &c, rxData, &hw->data_cmd, toRx, false );
+
+  c = dma_channel_get_default_config( t->txChannel );
+  channel_config_set_transfer_data_size( &c, DMA_SIZE_32 );
+  channel_config_set_read_increment( &c, true );
+  channel_config_set_write_increment( &c, false );
+  channel_config_set_dreq( &c, i2c_get_dreq( i2c, true ) );
+  dma_channel_configure( t->txChannel, &c, &hw->data_cmd, t->cmd, toRx + 1, false );
+
+  t->cpuBusy = getSysTick( ) - t->start;
+  (void)hw->clr_tx_abrt;
+  hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS;   // a nak ends the transfer from i2cAbortIrqHandler
+  dma_start_channel_mask( ( 1u << t->rxChannel ) | ( 1u << t->txChannel ) );
+  return I2C_SUCCESS;
+}
+
+int8_t i2cIsBusy ( void * dptr )
+{
+  return i2cDmaOf( i2cBus( dptr ) )->busy;
+}
+
+// result of a blocking transfer, filled in by the completion callback
+static void i2cDmaBlockingDone ( void * context, int8_t result )
+{
+  *(volatile int8_t *)context = result;
 }
 
 int8_t i2cRxReg ( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t toRx, uint8_t * rxData )
-{   // split long transfers into max of 32-bytes
+{
+  i2cDmaTransfer * t = i2cDmaOf( i2cBus( dptr ) );
+  i2c_hw_t * hw = i2c_get_hw( i2cBus( dptr ) );
+  volatile int8_t result = I2C_ERR_TIMEOUT;
+  // 100kHz worst case: 9 bit-times per byte, plus address bytes and some margin
+  absolute_time_t timeout = make_timeout_time_us( 100ull * ( toRx + 3 ) + 1000 );
+  int8_t res = i2cRxRegAsync( dptr, slaveAddr, regAddr, toRx, rxData, i2cDmaBlockingDone, (void *)&result );
+  if ( res != I2C_SUCCESS )
+  {
+    return res;
+  }
+  while ( t->busy )                               // the DMA or the tx abort interrupt ends the transfer and wakes us
+  {
+    if ( best_effort_wfe_or_timeout( timeout ) )
+    {
+      i2cDmaAbort( t, i2cBus( dptr ), I2C_ERR_TIMEOUT );
+    }
+  }
+  hw->dma_cr = 0;
+  i2cWaitIdle( hw );
+  i2cLogTransfer( t->logLevel, "I2C-RX", slaveAddr, toRx, rxData );
+  return result;
+}
+
+#else
+
+int8_t i2cRxReg ( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t toRx, uint8_t * rxData )
+{
   tmf8828Driver * driver = (tmf8828Driver *)dptr;
-  int8_t res = i2cTxOnly( driver->logLevel, slaveAddr, regAddr, 0, 0 ); 
-  //printf( "Tx res %d\n", res );
-  if ( res == I2C_SUCCESS )
+  uint32_t start = getSysTick( );
+  int res = i2c_write_blocking( i2cBus( dptr ), slaveAddr, &regAddr, 1, true );    // keep the bus, read with a repeated start
+  if ( res == 1 )
   {
-    res = i2cRxOnly( driver->logLevel, slaveAddr, toRx, rxData );
+    res = i2c_read_blocking( i2cBus( dptr ), slaveAddr, rxData, toRx, false );
   }
-  return res;
+  i2cAccount( i2cBus( dptr ), toRx + 1, start, getSysTick( ) - start );
+  i2cLogTransfer( driver->logLevel, "I2C-RX", slaveAddr, toRx, rxData );
+  return i2cResult( res, toRx );
+}
+
+#endif
+
+int8_t i2cTxReg ( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t toTx, const uint8_t * txData )
+{
+  tmf8828Driver * driver = (tmf8828Driver *)dptr;
+  return i2cTxOnly( dptr, driver->logLevel, slaveAddr, regAddr, toTx, txData ); 
 }
 
 int8_t i2cTxRx ( void * dptr, uint8_t slaveAddr, uint16_t toTx, const uint8_t * txData, uint16_t toRx, uint8_t * rxData )
@@ -407,11 +843,21 @@ int8_t i2cTxRx ( void * dptr, uint8_t slaveAddr, uint16_t toTx, const uint8_t *
   int8_t res = I2C_SUCCESS;
   if ( toTx )
   {
-    res = i2cTxOnly( driver->logLevel, slaveAddr, *txData, toTx-1, txData+1 );
+    res = i2cTxOnly( dptr, driver->logLevel, slaveAddr, *txData, toTx-1, txData+1 );
   }
   if ( toRx && res == I2C_SUCCESS )
   {
-    res = i2cRxOnly( driver->logLevel, slaveAddr, toRx, rxData );
+    res = i2cRxOnly( dptr, driver->logLevel, slaveAddr, toRx, rxData );
   }
   return res;
 }
+
+void i2cGetStatistics ( void * dptr, i2cStatistics * stats )
+{
+  *stats = i2cStats[ i2c_hw_index( i2cBus( dptr ) ) ];
+}
+
+void i2cResetStatistics ( void * dptr )
+{
+  memset( &i2cStats[ i2c_hw_index( i2cBus( dptr ) ) ], 0, sizeof( i2cStatistics ) );
+}
@@ -35,10 +35,14 @@
 // #include <Arduino.h>
 #include <stdio.h>
 #include <string.h>
+#if defined( TMF8828_HOST )
+#include "tmf8828_host.h"                       // host build against simulated devices, see tmf8828_host/
+#else
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
 #include "hardware/gpio.h"
 #include "hardware/irq.h"
+#endif
 
 #if defined( __cplusplus)
 extern "C"
@@ -47,29 +51,50 @@ extern "C"
 
 // ---------------------------------------------- defines -----------------------------------------
 
-#define ARDUINO_MAX_I2C_TRANSFER                  32    /**< Arduino Uno can only handle up to 32 bytes in a single i2c tx/rx */
+#define I2C_MAX_TRANSFER                          256   /**< longest payload of a single i2c tx/rx (register address not included) */
+
+// reads of register blocks run as one DMA driven transaction, the waiting core sleeps meanwhile
+#define USE_I2C_DMA                               1     /**< set to 0 to use the blocking pico sdk i2c functions */
+
+#define I2C_SDA_PIN                               16    /**< i2c0 SDA */
+#define I2C_SCL_PIN                               17    /**< i2c0 SCL */
+#define ENABLE_PIN                                7     /**< the enable pin is connected to GPIO 7 */
+#define INTERRUPT_PIN                             9     /**< the (open drain, active low) interrupt is connected to GPIO 9 */
 
-#define ENABLE_PIN                                7     /**< on the arduino uno the enable pin is connected to digital 6 */
-#define INTERRUPT_PIN                             9     /**< interupt to digital 7 */
+// for 2nd tmf8828 the alternate enable pin is connected to GPIO 6, alternate interrupt to GPIO 8 (GPIO 4 drives the LED)
+#define ALT_ENABLE_PIN                            6
+#define ALT_INTERRUPT_PIN                         8
 
-// for 2nd tmf8828 on the arduino uno the alternate enable pin is connected to digital 4, alternate interrupt to digital 5
-#define ALT_ENABLE_PIN                            4
-#define ALT_INTERRUPT_PIN                         5
+#define MAX_INTERRUPT_HANDLERS                    4     /**< number of devices that can have an interrupt handler registered at the same time */
 
 // if only a single TMF882x is used we can also used interrupt pin
-#define USE_INTERRUPT_TO_TRIGGER_READ             0     /**< do not define this, or set to 0 to use i2c polling instead of interrupt pin */
+#define USE_INTERRUPT_TO_TRIGGER_READ             1     /**< set to 0 to use i2c polling instead of interrupt pin */
 #define TRIGGER_INTERRUPT_PIN                     2     /**< the arduino uno can only handle interrupts on pin 2, 3 so re-route your pin 7 also to pin2 if you want to use interrupt */
 
 // for clock correction insert here the number in relation to your host
 #define HOST_TICKS_PER_US                     1         // host counts ticks every microsecond
 #define TMF8828_TICKS_PER_US                  5         // tmf8828 counts ticks 0.2 mircoseconds (5x faster than host)               
+#define CYCLE_COUNT_MASK                      0x00FFFFFF  // getCycleCount has 24 bits, mask the difference of two counts with this
 
 
+// the last FLASH_STORE_SECTORS sectors of the program flash are kept free of code for persistent data
+#define FLASH_STORE_SECTORS                   2         /**< number of reserved sectors */
+#define FLASH_STORE_SECTOR_SIZE               4096      /**< erase granularity of the flash */
+#define FLASH_STORE_PAGE_SIZE                 256       /**< program granularity of the flash */
+
+#define FLASH_SUCCESS                         0         /**< flash operation executed */
+#define FLASH_ERR_PARAM                       -1        /**< sector or offset outside the reserved area */
+#define FLASH_ERR_LOCKOUT                     -2        /**< the other core could not be stopped during the operation */
+
 // ---------------------------------------------- macros ------------------------------------------
 /** @brief macros to cast a pointer to an address - adapt for your machine-word size
  */ 
 #define PTR_TO_UINT(ptr)                     ( (intptr_t)(ptr) )
 
+/** @brief macro to place a variable in RAM that is not cleared at startup, so it survives a watchdog/host reset 
+ */
+#define RETAINED_VARIABLE(name)              __uninitialized_ram( name )
+
 /** @brief macros to replace the platform specific printing
  */ 
 #define PRINT_CHAR(c)                         printChar( c )
@@ -88,6 +113,30 @@ extern "C"
 /** forward declaration of driver structure to avoid cyclic dependancies */
 typedef struct _tmf8828Driver tmf8828Driver;
 
+// ---------------------------------------------- types -------------------------------------------
+
+/** @brief Platform binding of one driver instance: which i2c controller and pins the device is 
+ * connected to. The shim functions get it through the driver pointer (dptr).
+ */
+typedef struct _tmf8828Platform
+{
+  i2c_inst_t * i2c;                                 /**< i2c controller (i2c0 or i2c1) */
+  uint8_t sdaPin;                                   /**< gpio used as SDA of that controller */
+  uint8_t sclPin;                                   /**< gpio used as SCL of that controller */
+  uint8_t enablePin;                                /**< gpio connected to the device enable pin */
+  uint8_t interruptPin;                             /**< gpio connected to the device interrupt pin */
+} tmf8828Platform;
+
+/** the first device of this board */
+#define TMF8828_PLATFORM_DEFAULT              { i2c0, I2C_SDA_PIN, I2C_SCL_PIN, ENABLE_PIN, INTERRUPT_PIN }
+/** a second device on the same bus, with its own enable and interrupt line */
+#define TMF8828_PLATFORM_ALT                  { i2c0, I2C_SDA_PIN, I2C_SCL_PIN, ALT_ENABLE_PIN, ALT_INTERRUPT_PIN }
+
+/** @brief Interrupt service routine, called with the driver instance whose interrupt line went low 
+ * and the context given to setInterruptHandler.
+ */
+typedef void (* interruptHandlerFn)( void * dptr, void * context );
+
 
 // ---------------------------------------------- functions ---------------------------------------
 
@@ -101,6 +150,13 @@ void delayInMicroseconds( uint32_t wait );
  */
 uint32_t getSysTick( );
 
+/** @brief Function returns a free running count of core clock cycles, for measuring short code sections.
+ * On the RP2040 this is the SysTick of the calling core, which only has 24 bits: differences masked with 
+ * CYCLE_COUNT_MASK are valid for up to 2^24 cycles (134 ms at 125 MHz).
+ * \return current cycle count
+ */
+uint32_t getCycleCount( );
+
 /** @brief Function reads a single byte from the given address. This is only needed on 
  * systems that have special memory access methods for constant segments. Like e.g. Arduino Uno
  *  @param[in] ptr to memory to read from
@@ -108,6 +164,14 @@ uint32_t getSysTick( );
  */
 uint8_t readProgramMemoryByte( const uint8_t * ptr );
 
+/** @brief Function copies a block from program memory (e.g. the firmware image) to RAM. On the RP2040 the
+ * flash is memory mapped (XIP), so this is a plain memory copy.
+ *  @param[out] dst ram buffer to copy to
+ *  @param[in] src program memory to copy from
+ *  @param[in] len number of bytes to copy
+ */
+void readProgramMemory( uint8_t * dst, const uint8_t * src, uint16_t len );
+
 /** @brief Function sets the enable pin HIGH. Note that the enable pin must be configured
  * for output (with e.g. function pinOutput)
  * @param[in] dptr ... a pointer to a data structure the function needs for setting the enable pin, can
@@ -171,6 +235,12 @@ void printStr( char * str );
  */
 void printLn( void );
 
+/** @brief Function outputs binary data unchanged (no new-line translation). E.g. on a UART.
+ *  @param[in] data pointer to the bytes to be written
+ *  @param[in] len number of bytes
+ */
+void writeBinary( const uint8_t * data, uint16_t len );
+
 
 // ---------------------------------- I2C functions ---------------------------------------------
 
@@ -224,6 +294,56 @@ int8_t i2cRxReg( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t toRx,
  */ 
 int8_t i2cTxRx( void * dptr, uint8_t slaveAddr, uint16_t toTx, const uint8_t * txData, uint16_t toRx, uint8_t * rxData );
 
+/** @brief Completion callback of an asynchronous i2c transfer. Called from interrupt context.
+ * @param context ... the context pointer that was given when starting the transfer
+ * @param result ... I2C_SUCCESS or an error code
+ */
+typedef void (* i2cDoneCallback)( void * context, int8_t result );
+
+/** @brief I2C transmit register address and receive function that returns immediately and reports
+ * completion through the callback. Only available with USE_I2C_DMA. Only one transfer can be 
+ * pending, the rxData buffer must stay valid until the callback was called.
+ * @param dptr a pointer to a data structure the function needs for receiving, can
+ * be 0-pointer if the function does not need it
+ * @param slaveAddr the i2c slave address to be used (7-bit)
+ * @param regAddr the register address to start reading from
+ * @param toRx number of bytes in the buffer to receive (1..I2C_MAX_TRANSFER)
+ * @param rxData pointer to the buffer to be filled with received bytes
+ * @param done function called when all bytes were received or the slave nak'ed, can be 0-pointer
+ * @param context passed to the done function
+ * \return 0 when the transfer was started, else an error code
+ */
+int8_t i2cRxRegAsync( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t toRx, uint8_t * rxData, i2cDoneCallback done, void * context );
+
+/** @brief Function returns !=0 while an asynchronous transfer is pending.
+ * @param dptr a pointer to a data structure the function may need, can
+ * be 0-pointer if the function does not need it
+ */
+int8_t i2cIsBusy( void * dptr );
+
+/** @brief Bus statistics, e.g. to compare DMA and blocking transfers
+ */
+typedef struct _i2cStatistics
+{
+  uint32_t transactions;                            /**< number of i2c transactions (START .. STOP) */
+  uint32_t bytes;                                   /**< number of bytes transferred incl. register addresses */
+  uint32_t busTimeUs;                               /**< time from start to completion of all transfers */
+  uint32_t cpuBusyTimeUs;                           /**< time the cpu was busy with the transfers (not sleeping) */
+} i2cStatistics;
+
+/** @brief Function copies the accumulated i2c statistics
+ * @param dptr a pointer to a data structure the function may need, can
+ * be 0-pointer if the function does not need it
+ * @param stats ... pointer to the structure to be filled
+ */
+void i2cGetStatistics( void * dptr, i2cStatistics * stats );
+
+/** @brief Function clears the accumulated i2c statistics
+ * @param dptr a pointer to a data structure the function may need, can
+ * be 0-pointer if the function does not need it
+ */
+void i2cResetStatistics( void * dptr );
+
 
 
 /* --------------------- functions used by the application only (not driver) -------------------------------- */
@@ -262,14 +382,17 @@ void pinOutput( uint8_t pin );
 void pinInput( uint8_t pin );
 
 /** @brief Function registers given function handler as Interrupt Handler function for the
- *  interrupt pin
+ *  interrupt pin of the given device. Each device can have its own handler.
+ * @param[in] dptr a pointer to the driver instance, its interrupt pin is used
  *  @param[in] handler pointer to the interrupt service routine   
+ *  @param[in] context is passed to the handler unchanged
  */
-void setInterruptHandler( void (* handler)( void ) );
+void setInterruptHandler( void * dptr, interruptHandlerFn handler, void * context );
 
-/** @brief Function removes any Interrupt Handler function
+/** @brief Function removes the Interrupt Handler function of the given device
+ * @param[in] dptr a pointer to the driver instance
  */
-void clrInterruptHandler( void );
+void clrInterruptHandler( void * dptr );
 
 /** @brief Function globally disables interrupts
  */
@@ -279,6 +402,50 @@ void disableInterrupts( void );
  */
 void enableInterrupts( void );
 
+/** @brief Function puts the calling core to sleep until the interrupt handler has set the given
+ * flag, the interrupt pin is low, or the timeout expired. Can be called from the core that did not 
+ * register the interrupt handler.
+ * @param[in] dptr a pointer to a data structure the function may need, can
+ * be 0-pointer if the function does not need it
+ * @param[in] triggered ... flag that is set by the interrupt handler
+ * @param[in] timeoutInMs ... maximum time to sleep
+ * \return 1 if the interrupt was triggered, 0 on timeout
+ */
+int8_t waitForInterrupt( void * dptr, volatile uint8_t * triggered, uint32_t timeoutInMs );
+
+/** @brief Same as waitForInterrupt, but for several devices: returns as soon as the flag is set or 
+ * the interrupt pin of any of the devices is low.
+ * @param[in] drivers ... array of driver instances
+ * @param[in] count ... number of driver instances in the array
+ * @param[in] triggered ... flag (or bit-mask) that is set by the interrupt handlers
+ * @param[in] timeoutInMs ... maximum time to sleep
+ * \return 1 if an interrupt was triggered, 0 on timeout
+ */
+int8_t waitForAnyInterrupt( tmf8828Driver * drivers, uint8_t count, volatile uint8_t * triggered, uint32_t timeoutInMs );
+
+/** @brief Function returns a pointer to the memory mapped content of a reserved flash sector. The content 
+ * can be read directly, e.g. with readProgramMemory.
+ * @param[in] sector ... 0..FLASH_STORE_SECTORS-1
+ * \return pointer to the first byte of the sector, 0-pointer if the sector does not exist
+ */
+const uint8_t * flashStoreSector( uint8_t sector );
+
+/** @brief Function erases a reserved flash sector (all bytes read 0xFF afterwards). Code execution from flash
+ * is suspended on both cores while the function runs, so it must not be called from an interrupt handler.
+ * @param[in] sector ... 0..FLASH_STORE_SECTORS-1
+ * \return FLASH_SUCCESS or an error code FLASH_ERR_*
+ */
+int8_t flashStoreErase( uint8_t sector );
+
+/** @brief Function programs one page of a reserved flash sector. The page must be erased before. Code 
+ * execution from flash is suspended on both cores while the function runs.
+ * @param[in] sector ... 0..FLASH_STORE_SECTORS-1
+ * @param[in] offset ... byte offset in the sector, multiple of FLASH_STORE_PAGE_SIZE
+ * @param[in] data ... FLASH_STORE_PAGE_SIZE bytes to be programmed, must not point into flash
+ * \return FLASH_SUCCESS or an error code FLASH_ERR_*
+ */
+int8_t flashStoreProgram( uint8_t sector, uint16_t offset, const uint8_t * data );
+
 /** @brief Function to print the results in a kind of CSV like format
  * @param[in] dptr a pointer to a data structure the function may need, can
  * be 0-pointer if the function does not need it
@@ -0,0 +1,87 @@
+/** @file Sliding-window least-squares slope, updated with a few integer operations per point.
+ * The window keeps the last N points (x, y) and the running sums of t, t², x, y, t·x and t·y, where t is the
+ * position of a point in the window (0 is the oldest). When the window is full, pushing a point evicts the
+ * oldest one and moves all others down to t-1, which the sums follow without visiting the points:
+ *   Σ(t-1)x = Σtx - Σx, Σ(t-1)² = Σt² - 2Σt + n, Σ(t-1) = Σt - n.
+ * Everything is int32_t, which holds the products of the sums for |x|, |y| < 2^31 / N³, e.g. 268000 for N = 20.
+ */
+
+#ifndef TMF8828_SLOPE_H
+#define TMF8828_SLOPE_H
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tmf8828_ring.h"
+
+// ---------------------------------------------- types -------------------------------------------
+
+template <size_t N>
+class SlopeWindow {
+public:
+    static_assert(N >= 2 && N <= 64, "SlopeWindow needs 2..64 points");
+
+    SlopeWindow() { clear(); }
+
+    void push(int32_t x, int32_t y) {
+        if (points.size() == N) {           // evict the oldest point (t = 0), the others move down by one
+            const Point &oldest = points[0];
+            int32_t n = N - 1;
+            sum_x -= oldest.x;
+            sum_y -= oldest.y;
+            sum_tx -= sum_x;
+            sum_ty -= sum_y;
+            sum_tt -= 2 * sum_t - n;
+            sum_t -= n;
+        }
+        int32_t t = (int32_t)(points.size() < N ? points.size() : N - 1);
+        Point &p = points.push();
+        p.x = x;
+        p.y = y;
+        sum_t += t;
+        sum_tt += t * t;
+        sum_x += x;
+        sum_y += y;
+        sum_tx += t * x;
+        sum_ty += t * y;
+    }
+
+    void clear() {
+        points.clear();
+        sum_t = 0;
+        sum_tt = 0;
+        sum_x = 0;
+        sum_y = 0;
+        sum_tx = 0;
+        sum_ty = 0;
+    }
+
+    size_t size() const { return points.size(); }
+
+    // Least squares slope of x and y per point, in the units of x and y. 0 with fewer than 2 points.
+    int32_t slope_x() const { return slope(sum_tx, sum_x); }
+    int32_t slope_y() const { return slope(sum_ty, sum_y); }
+
+private:
+    struct Point {
+        int32_t x;
+        int32_t y;
+    };
+
+    int32_t slope(int32_t sum_tv, int32_t sum_v) const {
+        int32_t n = (int32_t)points.size();
+        int32_t den = n * sum_tt - sum_t * sum_t;
+        return den ? (n * sum_tv - sum_t * sum_v) / den : 0;
+    }
+
+    FrameRing<Point, N> points;
+    int32_t sum_t;
+    int32_t sum_tt;
+    int32_t sum_x;
+    int32_t sum_y;
+    int32_t sum_tx;
+    int32_t sum_ty;
+};
+
+#endif // TMF8828_SLOPE_H
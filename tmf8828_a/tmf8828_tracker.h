@@ -0,0 +1,109 @@
+/** @file Constant-velocity alpha-beta tracker of the hand position, in fixed point.
+ * Each measured frame first moves the state ahead by the time since the last one (position += velocity * dt),
+ * then corrects it by alpha times the residual, and the velocity by beta times the residual over dt. The
+ * time comes from the capture timestamps, so frames that are late or missing give a longer dt and not a
+ * wrong velocity. A residual beyond the gate (the hand came in somewhere else) or a gap longer than the
+ * timeout restarts the track at the measurement.
+ * The published TrackState is plain data: the reader extrapolates it to its own time with track_predict.
+ */
+
+#ifndef TMF8828_TRACKER_H
+#define TMF8828_TRACKER_H
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include <stdint.h>
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define TRACK_SCALE     16          // position and velocity are in 1/TRACK_SCALE mm, and mm per s
+#define TRACK_AXES      3           // x, y, z
+
+// ---------------------------------------------- types -------------------------------------------
+
+struct TrackState {
+    uint32_t timestamp;                 // capture time of the last measurement (us)
+    int32_t position[TRACK_AXES];       // 1/TRACK_SCALE mm, see keystone::Point for the axes
+    int32_t velocity[TRACK_AXES];       // 1/TRACK_SCALE mm per s
+    bool valid;                         // there was a measurement within the timeout
+};
+
+// Position of an axis at time t (us) in mm, extrapolated by at most max_ahead us
+inline int32_t track_predict(const TrackState &state, int axis, uint32_t t, uint32_t max_ahead) {
+    int32_t ahead = (int32_t)(t - state.timestamp);
+    ahead = (ahead < 0 ? 0 : (uint32_t)ahead > max_ahead ? (int32_t)max_ahead : ahead);
+    return (int32_t)((state.position[axis] + (int64_t)state.velocity[axis] * ahead / 1000000) / TRACK_SCALE);
+}
+
+class HandTracker {
+public:
+    // alpha, beta: Q8 gains (256 is 1.0), timeout: us, gate: mm
+    HandTracker(uint16_t alpha, uint16_t beta, uint32_t timeout, uint16_t gate) {
+        configure(alpha, beta, timeout, gate);
+    }
+
+    void configure(uint16_t alpha, uint16_t beta, uint32_t timeout, uint16_t gate) {
+        this->alpha = alpha;
+        this->beta = beta;
+        this->timeout = timeout;
+        this->gate = (int32_t)gate * TRACK_SCALE;
+        clear();
+    }
+
+    void clear() {
+        state.timestamp = 0;
+        state.valid = false;
+        for (int i = 0; i < TRACK_AXES; i++) {
+            state.position[i] = 0;
+            state.velocity[i] = 0;
+        }
+    }
+
+    // A frame with a measurement at time t (us), x, y, z in mm
+    const TrackState &update(uint32_t t, int32_t x, int32_t y, int32_t z) {
+        const int32_t measured[TRACK_AXES] = { x * TRACK_SCALE, y * TRACK_SCALE, z * TRACK_SCALE };
+        uint32_t dt = t - state.timestamp;
+        int32_t residual[TRACK_AXES];
+        bool restart = !state.valid || dt > timeout;
+        for (int i = 0; i < TRACK_AXES && !restart; i++) {
+            state.position[i] += (int32_t)((int64_t)state.velocity[i] * dt / 1000000);
+            residual[i] = measured[i] - state.position[i];
+            restart = (residual[i] > gate || residual[i] < -gate);
+        }
+        if (restart) {
+            for (int i = 0; i < TRACK_AXES; i++) {
+                state.position[i] = measured[i];
+                state.velocity[i] = 0;
+            }
+        } else {
+            for (int i = 0; i < TRACK_AXES; i++) {
+                state.position[i] += residual[i] * alpha / 256;
+                if (dt > 0) {
+                    state.velocity[i] += (int32_t)((int64_t)residual[i] * beta * 1000000 / (256 * (int64_t)dt));
+                }
+            }
+        }
+        state.timestamp = t;
+        state.valid = true;
+        return state;
+    }
+
+    // A frame without a measurement at time t (us), the track ends after the timeout
+    const TrackState &coast(uint32_t t) {
+        if (state.valid && t - state.timestamp > timeout) {
+            state.valid = false;
+        }
+        return state;
+    }
+
+    const TrackState &get() const { return state; }
+
+private:
+    TrackState state;
+    uint16_t alpha;
+    uint16_t beta;
+    uint32_t timeout;
+    int32_t gate;               // 1/TRACK_SCALE mm
+};
+
+#endif // TMF8828_TRACKER_H
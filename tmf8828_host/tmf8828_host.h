@@ -0,0 +1,88 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+#ifndef TMF8828_HOST_H
+#define TMF8828_HOST_H
+
+/** @file Stands in for the pico sdk when the driver is built for a PC (TMF8828_HOST defined), it is included
+ * by tmf8828_shim.h. The shim functions (tmf8828_host_shim.cpp) connect the driver, the array manager and 
+ * the application unchanged to simulated devices (tmf882x_sim.h) on one i2c bus.
+ * Time is virtual: it only advances with delays, i2c transfers and waits for an interrupt, and a wait skips
+ * ahead to the next event of a device. The time the host itself spends in the code is not counted, so 
+ * seconds of measurement run in milliseconds.
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tmf882x_sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define HOST_MAX_DEVICES                  4
+
+#define i2c0                              ( &hostI2c0 )
+#define __uninitialized_ram( name )       name      /**< there is no reset of the host, a warm start is a second setup */
+
+// ---------------------------------------------- types -------------------------------------------
+
+typedef struct _i2c_inst
+{
+  uint32_t clockHz;                                 /**< sets the duration of the transfers */
+} i2c_inst_t;
+
+// ---------------------------------------------- variables ---------------------------------------
+
+extern i2c_inst_t hostI2c0;
+
+// ---------------------------------------------- functions ---------------------------------------
+
+/** @brief Connects a simulated device to the bus i2c0 and to the given enable and interrupt pins
+ */
+void hostAttachDevice( tmf882xSim * sim, uint8_t enablePin, uint8_t interruptPin );
+
+/** @brief Virtual time in microseconds since the start of the program
+ */
+uint64_t hostTimeUs( void );
+
+/** @brief Suppresses all PRINT_* and writeBinary output if quiet is not 0
+ */
+void hostSetQuiet( uint8_t quiet );
+
+/** @brief Selects the file inputGetKey reads from, it returns no key at the end of the file
+ */
+void hostSetInput( FILE * input );
+
+/** @brief Sends all writeBinary output to the given file, also when quiet. 0-pointer: stdout
+ */
+void hostSetBinaryOutput( FILE * output );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TMF8828_HOST_H
@@ -0,0 +1,201 @@
+/* Host benchmark of the sensor side of the game: the driver, the array manager and the gesture pipeline 
+ * of tmf8828_app.cpp run against simulated devices in virtual time (see tmf8828_host.h).
+ * The scene repeats every 4 s: nothing but the table, a hand swiping along x, a hand swiping along y, and
+ * a hand moving up and down over the sensor.
+ * Reports cold and warm boot time, frames, capture-to-processed latency, detected directions and gesture
+ * events (swipes, double swipes, pushes, pulls, hovers) in virtual time, and how much faster than real time all of it ran.
+ * Usage: tmf8828_host_bench [seconds] [-v] [-f] [-r file]
+ *   -v ... show the output of the application
+ *   -f ... inject faults: 100 ms without acknowledge at 5 s, hang at 9 s, brown-out at 13 s (first sensor)
+ *   -r ... record the result pages of the run to file, for tmf8828_host_replay
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "tmf8828_app.h"
+#include "tmf8828_array.h"
+
+#define SCENE_PERIOD_US     4000000ULL
+#define HALF_FOV_DEG        22.0            // half opening angle of the zone grid
+#define TABLE_MM            700
+#define HAND_HALF_SIZE_MM   30
+#define SWIPE_US            600000.0
+#define SWIPE_MM            180.0
+#define SWIPE_HEIGHT_MM     70.0            // below GESTURE_MAX_DISTANCE, only close hands are tracked
+
+extern tmf8828Array sensorArray;
+
+// hand position of the scene at time t, returns 0 if there is no hand
+static int hand_at(uint64_t t, double *hx, double *hy, double *h)
+{
+    double s = (double)(t % SCENE_PERIOD_US) / 1e6;
+    *hx = 0.0;
+    *hy = 0.0;
+    *h = SWIPE_HEIGHT_MM;
+    if (s >= 1.0 && s < 1.0 + SWIPE_US / 1e6) {
+        *hx = -SWIPE_MM / 2 + SWIPE_MM * (s - 1.0) * 1e6 / SWIPE_US;
+        return 1;
+    }
+    if (s >= 2.0 && s < 2.0 + SWIPE_US / 1e6) {
+        *hy = -SWIPE_MM / 2 + SWIPE_MM * (s - 2.0) * 1e6 / SWIPE_US;
+        return 1;
+    }
+    if (s >= 3.0) {
+        *h = 100.0 + 200.0 * (s < 3.5 ? s - 3.0 : 4.0 - s) * 2.0;
+        return 1;
+    }
+    return 0;
+}
+
+static void scene(void *context, uint64_t timeUs, uint8_t rows, uint8_t cols,
+                  uint16_t distance[TMF882X_SIM_TARGETS][TMF882X_SIM_MAX_ZONES],
+                  uint8_t confidence[TMF882X_SIM_TARGETS][TMF882X_SIM_MAX_ZONES])
+{
+    double hx, hy, h;
+    int hand = hand_at(timeUs, &hx, &hy, &h);
+    (void)context;
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            int z = r * cols + c;
+            double tx = tan(((c + 0.5) / cols - 0.5) * 2.0 * HALF_FOV_DEG * M_PI / 180.0);
+            double ty = tan(((r + 0.5) / rows - 0.5) * 2.0 * HALF_FOV_DEG * M_PI / 180.0);
+            double stretch = sqrt(1.0 + tx * tx + ty * ty);          // distance along the ray per mm of height
+            if (hand && fabs(h * tx - hx) <= HAND_HALF_SIZE_MM && fabs(h * ty - hy) <= HAND_HALF_SIZE_MM) {
+                distance[0][z] = (uint16_t)(h * stretch);
+                confidence[0][z] = 220;
+                distance[1][z] = (uint16_t)(TABLE_MM * stretch);   // the table behind the fingers
+                confidence[1][z] = 60;
+            } else {
+                distance[0][z] = (uint16_t)(TABLE_MM * stretch);
+                confidence[0][z] = 180;
+            }
+        }
+    }
+}
+
+static double wall_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    static tmf882xSim sim[NR_OF_TMF8828];
+    static const uint8_t enable_pin[2] = { ENABLE_PIN, ALT_ENABLE_PIN };
+    static const uint8_t interrupt_pin[2] = { INTERRUPT_PIN, ALT_INTERRUPT_PIN };
+    double seconds = 20.0;
+    bool verbose = false;
+    bool faults = false;
+    FILE *record = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v")) {
+            verbose = true;
+        } else if (!strcmp(argv[i], "-f")) {
+            faults = true;
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            record = fopen(argv[++i], "wb");
+            if (!record) {
+                perror(argv[i]);
+                return 1;
+            }
+        } else {
+            seconds = atof(argv[i]);
+        }
+    }
+
+    for (int i = 0; i < NR_OF_TMF8828; i++) {
+        tmf882xSimInitialise(&sim[i], 0x00A50000 + i);
+        sim[i].clockErrorPpm = (i ? -80 : 120);
+        tmf882xSimSetScene(&sim[i], scene, 0);
+        hostAttachDevice(&sim[i], enable_pin[i], interrupt_pin[i]);
+    }
+    hostSetQuiet(!verbose);
+
+    double wall_start = wall_ms();
+    uint64_t start = hostTimeUs();
+    setupforTMF882x();
+    uint64_t cold_us = hostTimeUs() - start;
+    if (record) {
+        hostSetBinaryOutput(record);
+        recordTMF882x(1);
+    }
+    uint64_t end = hostTimeUs() + (uint64_t)(seconds * 1e6);
+
+    uint32_t frames = 0;
+    uint32_t last_sequence = 0;
+    uint64_t latency_sum = 0;
+    uint32_t latency_max = 0;
+    uint32_t directions[4] = { 0, 0, 0, 0 };
+    char last_direction = '-';
+    uint32_t gestures[5] = { 0, 0, 0, 0, 0 };
+    int fault_step = 0;
+    while (hostTimeUs() < end) {
+        SensorData sensor_data;
+        loopFnforTMF882x(&sensor_data);
+        if (sensor_data.timestamp && sensor_data.sequence != last_sequence) {
+            uint32_t latency = getSysTick() - sensor_data.timestamp;
+            last_sequence = sensor_data.sequence;
+            frames++;
+            latency_sum += latency;
+            latency_max = (latency > latency_max ? latency : latency_max);
+            if (sensor_data.direction != '-' && sensor_data.direction != last_direction) {
+                const char *p = strchr("udlr", sensor_data.direction);
+                if (p) {
+                    directions[p - "udlr"]++;
+                }
+            }
+            last_direction = sensor_data.direction;
+            if (sensor_data.gesture != '-') {
+                gestures[strchr("udlr", sensor_data.gesture) ? 0 : strchr("UDLR", sensor_data.gesture) ? 1 :
+                         sensor_data.gesture == 'p' ? 2 : sensor_data.gesture == 'o' ? 3 : 4]++;
+            }
+        }
+        if (faults) {
+            static const uint8_t fault[3] = { TMF882X_SIM_FAULT_NAK, TMF882X_SIM_FAULT_HANG, TMF882X_SIM_FAULT_BROWNOUT };
+            static const uint32_t duration[3] = { 100000, 30000000, 0 };
+            if (fault_step < 3 && hostTimeUs() - start >= (5 + 4 * fault_step) * 1000000ULL) {
+                tmf882xSimInjectFault(&sim[0], fault[fault_step], duration[fault_step], hostTimeUs());
+                fault_step++;
+            }
+        }
+        waitForTMF882x();
+    }
+    double run_ms = wall_ms() - wall_start;
+    if (record) {
+        recordTMF882x(0);
+        fclose(record);
+        hostSetBinaryOutput(0);
+    }
+    double virtual_s = (hostTimeUs() - start) / 1e6;
+
+    uint32_t faults_seen = sensorArray.faults;  // the restart initialises the array again
+    uint32_t recovered[TMF8828_RECOVER_ACTIONS];
+    memcpy(recovered, sensorArray.recovered, sizeof(recovered));
+
+    uint64_t warm_start = hostTimeUs();
+    setupforTMF882x();                          // host restart, the devices keep running
+    uint64_t warm_us = hostTimeUs() - warm_start;
+
+    uint32_t results = 0;
+    uint32_t dropped = 0;
+    for (int i = 0; i < NR_OF_TMF8828; i++) {
+        results += sim[i].stats.results;
+        dropped += sim[i].stats.dropped;
+    }
+    hostSetQuiet(0);
+    fflush(stdout);
+    printf("#Bench,sensors,%d\n", NR_OF_TMF8828);
+    printf("#Bench,boot,%llu,%llu\n", (unsigned long long)cold_us, (unsigned long long)warm_us);
+    printf("#Bench,run,%.1f,%.1f,%.0f\n", virtual_s, run_ms, virtual_s * 1e3 / run_ms);
+    printf("#Bench,frames,%u,%.1f,%llu,%u,%u,%u\n", frames, frames / virtual_s,
+           (unsigned long long)(frames ? latency_sum / frames : 0), latency_max, results, dropped);
+    printf("#Bench,directions,%u,%u,%u,%u\n", directions[0], directions[1], directions[2], directions[3]);
+    printf("#Bench,gestures,%u,%u,%u,%u,%u\n", gestures[0], gestures[1], gestures[2], gestures[3], gestures[4]);
+    printf("#Bench,recovery,%u,%u,%u,%u,%u\n", faults_seen, recovered[0], recovered[1], recovered[2], recovered[3]);
+    return 0;
+}
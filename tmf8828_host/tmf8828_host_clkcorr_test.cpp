@@ -0,0 +1,106 @@
+/* Host test of the clock correction in the binary result path. Random result pages are decoded by the frame
+ * assembler (tmf8828FrameAddPage with tmf8828ClkCorrRatio, as the array does) and corrected in place by
+ * tmf8828CorrectResultRecords (as tmf8828ReadResults does). Every distance of both paths has to equal
+ * tmf8828CorrectDistance of the raw distance. The ratios include 1.0 (0x8000), the ends of the UQ1.15 range,
+ * ratios that saturate large distances and random ones, each with clock correction on and off.
+ * Prints the first mismatch and exits with 1, else prints #Test,clkcorr,<pages>,<compared distances> and exits with 0.
+ * Usage: tmf8828_host_clkcorr_test [pages per ratio] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include "tmf8828.h"
+#include "tmf8828_frame.h"
+#include "tmf8828_record.h"
+
+#define RECORDS     ( 2 * TMF8828_FRAME_SLOTS_PER_PAGE )        // both targets of a page
+
+static const uint16_t fixed_ratios[] = { 0x8000, 0x0000, 0x0001, 0x7FFF, 0x8001, 0x8100, 0xC000, 0xFFFE, 0xFFFF };
+
+static uint16_t raw_distance(const uint8_t *record)
+{
+    return (uint16_t)(((uint16_t)record[2] << 8) | record[1]);
+}
+
+static bool mismatch(const char *path, uint16_t ratio, uint8_t enable, int slot, uint16_t raw, uint16_t got, uint16_t expected)
+{
+    if (got == expected) {
+        return false;
+    }
+    printf("#Fail,%s,ratio=0x%04X,enable=%u,slot=%d,raw=%u,got=%u,expected=%u\n", path, ratio, enable, slot, raw, got, expected);
+    return true;
+}
+
+// One page through both paths, the 3x6 map (SPAD map 10) uses every slot of a page
+static bool check_page(tmf8828Driver *driver, tmf8828FrameAssembler *fa, const uint8_t *page, uint64_t *distances)
+{
+    const uint8_t *records = page + RESULT_REG(RES_CONFIDENCE_0);
+    uint8_t corrected[RECORDS * 3];
+    memcpy(corrected, records, sizeof(corrected));
+    tmf8828CorrectResultRecords(driver, corrected, RECORDS);
+
+    const tmf8828Frame *frame = tmf8828FrameAddPage(fa, page, 0, 0, tmf8828ClkCorrRatio(driver));
+    if (!frame) {
+        printf("#Fail,frame,no frame from a single page\n");
+        return false;
+    }
+    for (int i = 0; i < RECORDS; i++) {
+        int t = i / TMF8828_FRAME_SLOTS_PER_PAGE;
+        int z = i % TMF8828_FRAME_SLOTS_PER_PAGE;
+        uint16_t raw = raw_distance(records + 3 * i);
+        uint16_t expected = tmf8828CorrectDistance(driver, raw);
+        if (mismatch("records", driver->clkCorrRatioUQ, driver->clkCorrectionEnable, i, raw, raw_distance(corrected + 3 * i), expected)
+            || mismatch("frame", driver->clkCorrRatioUQ, driver->clkCorrectionEnable, i, raw, frame->distance[t][z], expected)) {
+            return false;
+        }
+        if (frame->confidence[t][z] != records[3 * i] || corrected[3 * i] != records[3 * i]) {
+            printf("#Fail,confidence,slot=%d\n", i);
+            return false;
+        }
+        (*distances) += 2;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int pages = (argc > 1 ? atoi(argv[1]) : 200);
+    uint32_t seed = (argc > 2 ? (uint32_t)atoi(argv[2]) : 1);
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_int_distribution<int> any_ratio(0, 0xFFFF);
+    static tmf8828Driver driver;
+    static tmf8828FrameAssembler fa;
+    uint8_t page[TMF8828_RECORD_PAGE_SIZE];
+    uint64_t tested_pages = 0;
+    uint64_t distances = 0;
+
+    const int nr_fixed = (int)(sizeof(fixed_ratios) / sizeof(fixed_ratios[0]));
+    for (int r = 0; r < nr_fixed + 32; r++) {
+        uint16_t ratio = (r < nr_fixed ? fixed_ratios[r] : (uint16_t)any_ratio(rng));
+        for (uint8_t enable = 0; enable < 2; enable++) {
+            driver.clkCorrRatioUQ = ratio;
+            driver.clkCorrectionEnable = enable;
+            tmf8828FrameInitialise(&fa, TMF8828_COM_SPAD_MAP_ID__spad_map_id__map_no_10);
+            for (int p = 0; p < pages; p++) {
+                for (size_t i = 0; i < sizeof(page); i++) {
+                    page[i] = (uint8_t)byte(rng);
+                }
+                if (p == 0) {                   // the largest distances, saturate for every ratio above 1.0
+                    for (int i = 0; i < RECORDS; i++) {
+                        page[RESULT_REG(RES_CONFIDENCE_0) + 3 * i + 1] = 0xFF;
+                        page[RESULT_REG(RES_CONFIDENCE_0) + 3 * i + 2] = 0xFF;
+                    }
+                }
+                if (!check_page(&driver, &fa, page, &distances)) {
+                    return 1;
+                }
+                tested_pages++;
+            }
+        }
+    }
+    printf("#Test,clkcorr,%llu,%llu\n", (unsigned long long)tested_pages, (unsigned long long)distances);
+    return 0;
+}
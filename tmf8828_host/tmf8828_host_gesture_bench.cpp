@@ -0,0 +1,261 @@
+/* Host benchmark of the gesture detection on synthetic hand trajectories. The frames are generated directly
+ * (no device simulation) and go through processFrameTMF882x, the same descattering, keystone projection,
+ * centroid, direction regression, DirectionFilter and gesture engine the game runs on the frames of the sensor.
+ * Each configuration (grid, frame rate, speed, height, noise, dropout) runs
+ *   - swipes in the four directions across the whole field of view, 1 s without a hand in between
+ *   - still trials without swipe: the hand held over the sensor for 2 s, and a push and pull at the same speed
+ * and prints
+ *   #Bench,gesture,<grid>,<fps>,<speed mm/s>,<height mm>,<noise mm>,<dropout %>,<swipes>,<detected>,<wrong>,
+ *          <avg frames>,<max frames>,<avg ms>,<max ms>,<still trials>,<false swipes>,<ns per frame>
+ * detected: the swipe event of the expected direction came during the trial, wrong: other swipe events during a
+ * swipe trial, frames/ms: from the first frame the hand is in the field of view to the frame with the event,
+ * false swipes: swipe events during the still trials, ns per frame: host CPU time in processFrameTMF882x.
+ * Without options a sweep over both grids and four speeds runs, each option fixes one parameter.
+ * Usage: tmf8828_host_gesture_bench [-g 3|8] [-f fps] [-s speed] [-z height] [-n noise] [-d dropout %] [-t trials] [-r seed]
+ * The game runs 3x3 at 33 ms (the default -f 30). With GAME_8X8_MODE set a frame takes 4 sub-captures of 132 ms,
+ * about 2 frames/s, -g 8 -f 2 shows what that means.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include "tmf8828_app.h"
+#include "tmf8828.h"
+#include "tmf8828_host.h"
+
+#define HALF_FOV_DEG        22.0            // half opening angle of the zone grid
+#define TABLE_MM            700
+#define HAND_HALF_SIZE_MM   30
+#define HAND_CONFIDENCE     220
+#define TABLE_CONFIDENCE    180
+#define GAP_US              1000000.0       // no hand between two trials
+#define HOLD_US             2000000.0       // still trial: hand held over the sensor
+#define PUSH_MM             30.0            // still trial: push and pull by this much around the height
+
+struct Config {
+    int grid;
+    double fps;
+    double speed;
+    double height;
+    double noise;
+    double dropout;                         // percent of the hand zones without a target
+};
+
+struct Result {
+    uint32_t swipes;
+    uint32_t detected;
+    uint32_t wrong;
+    uint32_t latency_sum;                   // frames
+    uint32_t latency_max;
+    uint32_t still;
+    uint32_t false_swipes;
+    uint64_t frames;
+    double ns;
+};
+
+// hand position over time within a trial, returns false if there is no hand
+typedef bool (*Trajectory)(const Config &config, double t, int param, double *hx, double *hy, double *h, bool *done);
+
+static const char SWIPE_EVENTS[] = "udlrUDLR";
+
+// the game maps a movement along +x to 'd' and along +y to 'r', see get_arrow
+static const struct {
+    double dx;
+    double dy;
+    char arrow;
+} swipe_direction[4] = { { 1, 0, 'd' }, { -1, 0, 'u' }, { 0, 1, 'r' }, { 0, -1, 'l' } };
+
+static bool swipe(const Config &config, double t, int param, double *hx, double *hy, double *h, bool *done)
+{
+    double reach = config.height * tan(HALF_FOV_DEG * M_PI / 180.0) + HAND_HALF_SIZE_MM + 20.0;
+    double s = -reach + config.speed * t / 1e6;
+    *hx = s * swipe_direction[param].dx;
+    *hy = s * swipe_direction[param].dy;
+    *h = config.height;
+    *done = (s > reach);
+    return !*done;
+}
+
+static bool still(const Config &config, double t, int param, double *hx, double *hy, double *h, bool *done)
+{
+    *hx = 0.0;
+    *hy = 0.0;
+    *h = config.height;
+    if (param == 0) {                       // hold
+        *done = (t >= HOLD_US);
+    } else {                                // push down and pull back up
+        double travel = config.speed * t / 1e6;
+        *h = config.height + PUSH_MM - (travel < 2 * PUSH_MM ? travel : 4 * PUSH_MM - travel);
+        *done = (travel >= 4 * PUSH_MM);
+    }
+    return !*done;
+}
+
+// Fills the zones of the frame, returns true if the hand covers at least one of them
+static bool make_frame(const Config &config, bool hand, double hx, double hy, double h, std::mt19937 &rng, tmf8828Frame *frame)
+{
+    bool visible = false;
+    std::normal_distribution<double> noise(0.0, config.noise > 0 ? config.noise : 1e-9);
+    std::uniform_real_distribution<double> percent(0.0, 100.0);
+    frame->rows = (uint8_t)config.grid;
+    frame->cols = (uint8_t)config.grid;
+    frame->nrZones = (uint8_t)(config.grid * config.grid);
+    for (int r = 0; r < config.grid; r++) {
+        for (int c = 0; c < config.grid; c++) {
+            int z = r * config.grid + c;
+            double tx = tan(((c + 0.5) / config.grid - 0.5) * 2.0 * HALF_FOV_DEG * M_PI / 180.0);
+            double ty = tan(((r + 0.5) / config.grid - 0.5) * 2.0 * HALF_FOV_DEG * M_PI / 180.0);
+            double stretch = sqrt(1.0 + tx * tx + ty * ty);          // distance along the ray per mm of height
+            frame->distance[1][z] = 0;
+            frame->confidence[1][z] = 0;
+            if (hand && fabs(h * tx - hx) <= HAND_HALF_SIZE_MM && fabs(h * ty - hy) <= HAND_HALF_SIZE_MM) {
+                bool dropped = percent(rng) < config.dropout;
+                visible = true;
+                frame->distance[0][z] = (uint16_t)(dropped ? 0 : fmax(1.0, (h + noise(rng)) * stretch));
+                frame->confidence[0][z] = (dropped ? 0 : HAND_CONFIDENCE);
+                frame->distance[1][z] = (uint16_t)(TABLE_MM * stretch);   // the table behind the fingers
+                frame->confidence[1][z] = 60;
+            } else {
+                frame->distance[0][z] = (uint16_t)((TABLE_MM + noise(rng)) * stretch);
+                frame->confidence[0][z] = TABLE_CONFIDENCE;
+            }
+        }
+    }
+    return visible;
+}
+
+// Runs one trial after GAP_US without a hand. Returns the number of frames from the first one with the hand
+// in the field of view to the one with the expected event, -1 if it did not come. Other swipe events are counted in wrong.
+static int trial(const Config &config, Trajectory trajectory, int param, char expected, std::mt19937 &rng,
+                 double *t_us, uint32_t *sequence, Result *result, uint32_t *wrong)
+{
+    static tmf8828Frame frame;
+    const uint8_t spad_map = (config.grid == 8 ? TMF8828_COM_SPAD_MAP_ID__spad_map_id__map_no_15
+                                                : TMF8828_COM_SPAD_MAP_ID__spad_map_id__map_no_1);
+    const double frame_us = 1e6 / config.fps;
+    int entered = -1;
+    int latency = -1;
+    int k = 0;
+    for (double t = -GAP_US; ; t += frame_us, *t_us += frame_us) {
+        double hx = 0.0;
+        double hy = 0.0;
+        double h = 0.0;
+        bool done = false;
+        bool hand = (t >= 0.0 && trajectory(config, t, param, &hx, &hy, &h, &done));
+        if (done) {
+            break;
+        }
+        bool visible = make_frame(config, hand, hx, hy, h, rng, &frame);
+        frame.captureTimestamp = (uint32_t)*t_us;
+        frame.hostTimestamp = frame.captureTimestamp;
+        frame.sequence = ++*sequence;
+        if (visible && entered < 0) {
+            entered = k;
+        }
+
+        SensorData sensor_data;
+        auto t0 = std::chrono::steady_clock::now();
+        processFrameTMF882x(&frame, spad_map, &sensor_data);
+        auto t1 = std::chrono::steady_clock::now();
+        result->ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        result->frames++;
+
+        if (sensor_data.gesture == expected && latency < 0 && entered >= 0) {
+            latency = k - entered;
+        } else if (sensor_data.gesture != '-' && strchr(SWIPE_EVENTS, sensor_data.gesture)) {
+            (*wrong)++;
+        }
+        if (t >= 0.0) {
+            k++;
+        }
+    }
+    return latency;
+}
+
+static void run(const Config &config, int trials, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    Result result = {};
+    double t_us = 0.0;
+    uint32_t sequence = 0;
+    for (int i = 0; i < trials; i++) {
+        for (int d = 0; d < 4; d++) {
+            int latency = trial(config, swipe, d, swipe_direction[d].arrow, rng, &t_us, &sequence, &result, &result.wrong);
+            result.swipes++;
+            if (latency >= 0) {
+                result.detected++;
+                result.latency_sum += latency;
+                result.latency_max = (latency > (int)result.latency_max ? latency : result.latency_max);
+            }
+        }
+        for (int p = 0; p < 2; p++) {
+            trial(config, still, p, 0, rng, &t_us, &sequence, &result, &result.false_swipes);
+            result.still++;
+        }
+    }
+    double frame_ms = 1e3 / config.fps;
+    double avg = (result.detected ? (double)result.latency_sum / result.detected : 0.0);
+    printf("#Bench,gesture,%d,%.0f,%.0f,%.0f,%.1f,%.0f,%u,%u,%u,%.1f,%u,%.0f,%.0f,%u,%u,%.0f\n",
+           config.grid, config.fps, config.speed, config.height, config.noise, config.dropout,
+           result.swipes, result.detected, result.wrong, avg, result.latency_max, avg * frame_ms,
+           result.latency_max * frame_ms, result.still, result.false_swipes, result.ns / result.frames);
+}
+
+int main(int argc, char *argv[])
+{
+    int grid = 0;
+    double fps = 30.0;
+    double speed = 0.0;
+    double height = 70.0;                   // below GESTURE_MAX_DISTANCE, only close hands are tracked
+    double noise = 3.0;
+    double dropout = 5.0;
+    int trials = 10;
+    uint32_t seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        double v = atof(argv[i + 1]);
+        if (!strcmp(argv[i], "-g")) {
+            grid = (int)v;
+        } else if (!strcmp(argv[i], "-f")) {
+            fps = v;
+        } else if (!strcmp(argv[i], "-s")) {
+            speed = v;
+        } else if (!strcmp(argv[i], "-z")) {
+            height = v;
+        } else if (!strcmp(argv[i], "-n")) {
+            noise = v;
+        } else if (!strcmp(argv[i], "-d")) {
+            dropout = v;
+        } else if (!strcmp(argv[i], "-t")) {
+            trials = (int)v;
+        } else if (!strcmp(argv[i], "-r")) {
+            seed = (uint32_t)v;
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if ((grid != 0 && grid != 3 && grid != 8) || fps <= 0.0 || speed < 0.0 || trials <= 0) {
+        fprintf(stderr, "usage: %s [-g 3|8] [-f fps] [-s speed] [-z height] [-n noise] [-d dropout %%] [-t trials] [-r seed]\n", argv[0]);
+        return 1;
+    }
+    hostSetQuiet(1);
+
+    static const int grids[2] = { 3, 8 };
+    static const double speeds[4] = { 150.0, 300.0, 600.0, 1000.0 };
+    for (int g = 0; g < 2; g++) {
+        if (grid && grid != grids[g]) {
+            continue;
+        }
+        for (int s = 0; s < 4; s++) {
+            if (speed > 0.0 && s > 0) {
+                break;
+            }
+            Config config = { grids[g], fps, speed > 0.0 ? speed : speeds[s], height, noise, dropout };
+            run(config, trials, seed);
+        }
+    }
+    return 0;
+}
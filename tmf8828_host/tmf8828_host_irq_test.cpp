@@ -0,0 +1,118 @@
+/* Host test of the interrupt dispatch of the shim against a simulated device.
+ * First the game path (setupforTMF882x, loopFnforTMF882x, waitForTMF882x) runs in interrupt mode; frames have to keep
+ * coming, no gap between two frames may reach the interrupt wait timeout.
+ * Then the Arduino path on the first device (setupFn, enable, measure, loopFn): a falling edge of INT has to run the
+ * handler registered by setupFn and set irqTriggered, an edge that comes while disableInterrupts is held has to be
+ * delivered by enableInterrupts, and every result has to be signalled this way.
+ * Prints the first failure and exits with 1, else prints #Test,irq,<game frames>,<arduino results> and exits with 0.
+ * Usage: tmf8828_host_irq_test [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tmf8828_app.h"
+#include "tmf8828_image.h"
+
+#define GAME_MAX_GAP_US         1000000ULL      // IRQ_WAIT_TIMEOUT_MS, a frame that only comes with the timeout is stalled
+#define GAME_MIN_FPS            3               // below the idle rate of 4 fps (RATE_IDLE_PERIOD_MS)
+#define ARDUINO_MIN_FPS         6               // the first tmf8828 configuration runs at 132 ms per result
+
+extern volatile uint8_t irqTriggered;
+extern tmf8828Driver tmf8828[];
+void enable( uint32_t imageStartAddress, const unsigned char * image, int32_t imageSizeInBytes );
+void measure( );
+
+static int fail(const char *what)
+{
+    hostSetQuiet(0);
+    fflush(stdout);
+    printf("#Fail,%s,%llu\n", what, (unsigned long long)hostTimeUs());
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    static tmf882xSim sim[NR_OF_TMF8828];
+    static const uint8_t enable_pin[2] = { ENABLE_PIN, ALT_ENABLE_PIN };
+    static const uint8_t interrupt_pin[2] = { INTERRUPT_PIN, ALT_INTERRUPT_PIN };
+    double seconds = (argc > 1 ? atof(argv[1]) : 3.0);
+    uint64_t run_us = (uint64_t)(seconds * 1e6);
+
+    for (int i = 0; i < NR_OF_TMF8828; i++) {
+        tmf882xSimInitialise(&sim[i], 0x00A50000 + i);
+        hostAttachDevice(&sim[i], enable_pin[i], interrupt_pin[i]);
+    }
+    hostSetQuiet(1);
+
+    // game path, the array waits for the interrupts of its devices
+    setupforTMF882x();
+    uint32_t frames = 0;
+    uint32_t last_sequence = 0;
+    uint64_t last_frame = hostTimeUs();
+    uint64_t end = hostTimeUs() + run_us;
+    while (hostTimeUs() < end) {
+        SensorData sensor_data;
+        loopFnforTMF882x(&sensor_data);
+        if (sensor_data.timestamp && sensor_data.sequence != last_sequence) {
+            last_sequence = sensor_data.sequence;
+            last_frame = hostTimeUs();
+            frames++;
+        }
+        if (hostTimeUs() - last_frame >= GAME_MAX_GAP_US) {
+            return fail("game,stalled");
+        }
+        waitForTMF882x();
+    }
+    if (frames < seconds * GAME_MIN_FPS) {
+        return fail("game,frames");
+    }
+
+    // Arduino path, interruptHandler sets irqTriggered
+    setupFn(0, 115200, 1000000);
+    enable(tmf8828_image_start, tmf8828_image, tmf8828_image_length);
+    measure();
+    if (irqTriggered) {
+        return fail("arduino,early");
+    }
+    waitForInterrupt(&tmf8828[0], &irqTriggered, 1000);
+    if (!irqTriggered) {
+        return fail("arduino,handler");
+    }
+    loopFn();                                   // reads the result and clears INT and irqTriggered
+    if (irqTriggered) {
+        return fail("arduino,clear");
+    }
+
+    disableInterrupts();
+    waitForInterrupt(&tmf8828[0], &irqTriggered, 1000);   // returns with the line low
+    if (irqTriggered) {
+        enableInterrupts();
+        return fail("deferred,early");
+    }
+    enableInterrupts();
+    if (!irqTriggered) {
+        return fail("deferred,lost");
+    }
+    loopFn();
+
+    uint32_t results = 0;
+    end = hostTimeUs() + run_us;
+    while (hostTimeUs() < end) {
+        if (waitForInterrupt(&tmf8828[0], &irqTriggered, 1000) && !irqTriggered) {
+            return fail("arduino,no handler");
+        }
+        if (!irqTriggered) {
+            return fail("arduino,stalled");
+        }
+        results++;
+        loopFn();
+    }
+    if (results < seconds * ARDUINO_MIN_FPS) {
+        return fail("arduino,results");
+    }
+
+    hostSetQuiet(0);
+    fflush(stdout);
+    printf("#Test,irq,%u,%u\n", frames, results);
+    return 0;
+}
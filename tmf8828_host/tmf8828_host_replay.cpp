@@ -0,0 +1,82 @@
+/* Host replay of recorded result pages (tmf8828_record.h) through the sensor side of the game: the records
+ * are fed to loopFnforTMF882x built with GAME_REPLAY, so they take the same decoding, merging, descattering,
+ * height and gesture detection as live frames. For reproducing field issues and for comparing algorithm
+ * changes on the same captured session.
+ * Records come from the firmware built with GAME_RECORD (USB CDC output saved to a file; text lines in 
+ * between are skipped) or from tmf8828_host_bench -r.
+ * Prints one line per frame: #Frame,<sequence>,<capture us>,<height>,<valid>,<direction>,<gesture>
+ * and a summary: #Replay,<records>,<dropped>,<frames>,<u>,<d>,<l>,<r>,<wall ms>,<frames per s>
+ * Usage: tmf8828_host_replay file [-v]
+ *   -v ... show the output of the application
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "tmf8828_app.h"
+#include "tmf8828_record.h"
+
+extern tmf8828RecordParser replayParser;
+
+static double wall_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *name = 0;
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v")) {
+            verbose = true;
+        } else {
+            name = argv[i];
+        }
+    }
+    if (!name) {
+        fprintf(stderr, "usage: %s file [-v]\n", argv[0]);
+        return 1;
+    }
+    FILE *input = fopen(name, "rb");
+    if (!input) {
+        perror(name);
+        return 1;
+    }
+    hostSetQuiet(!verbose);
+    hostSetInput(input);
+
+    double wall_start = wall_ms();
+    setupforTMF882x();
+    uint32_t frames = 0;
+    uint32_t directions[4] = { 0, 0, 0, 0 };
+    char last_direction = '-';
+    for (;;) {
+        SensorData sensor_data;
+        loopFnforTMF882x(&sensor_data);
+        if (sensor_data.timestamp) {
+            frames++;
+            printf("#Frame,%u,%u,%d,%d,%c,%c\n", (unsigned)sensor_data.sequence, (unsigned)sensor_data.timestamp,
+                   sensor_data.average_height, sensor_data.valid, sensor_data.direction, sensor_data.gesture);
+            if (sensor_data.direction != '-' && sensor_data.direction != last_direction) {
+                const char *p = strchr("udlr", sensor_data.direction);
+                if (p) {
+                    directions[p - "udlr"]++;
+                }
+            }
+            last_direction = sensor_data.direction;
+        } else if (feof(input)) {
+            break;
+        }
+        waitForTMF882x();
+    }
+    double run_ms = wall_ms() - wall_start;
+    fclose(input);
+
+    printf("#Replay,%u,%u,%u,%u,%u,%u,%u,%.1f,%.0f\n", (unsigned)replayParser.records, (unsigned)replayParser.dropped,
+           frames, directions[0], directions[1], directions[2], directions[3], run_ms,
+           run_ms > 0 ? frames * 1e3 / run_ms : 0.0);
+    return 0;
+}
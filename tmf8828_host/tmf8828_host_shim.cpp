@@ -0,0 +1,724 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+// Shim for the host build, see tmf8828_host.h. Single threaded: the interrupt handlers run from 
+// whichever call advances the virtual time past the falling edge of an interrupt line.
+
+#include "tmf8828_shim.h"
+#include "tmf8828.h"
+#include <chrono>
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+#define I2C_BITS_PER_BYTE       9           // 8 data bits and the acknowledge
+#define I2C_FRAME_BITS          2           // start and stop condition
+
+// handler registered with setInterruptHandler, one per interrupt pin
+typedef struct _interruptEntry
+{
+  void * dptr;                                       // 0-pointer if entry is free
+  interruptHandlerFn handler;
+  void * context;
+  uint8_t pin;
+} interruptEntry;
+
+// a simulated device and the pins it is connected to
+typedef struct _hostDevice
+{
+  tmf882xSim * sim;
+  uint8_t enablePin;
+  uint8_t interruptPin;
+  uint8_t line;                                      // last level of the interrupt line, for the edge detection
+} hostDevice;
+
+i2c_inst_t hostI2c0 = { 100000 };
+
+static hostDevice devices[ HOST_MAX_DEVICES ];
+static uint8_t deviceCount;
+static interruptEntry interruptHandlers[ MAX_INTERRUPT_HANDLERS ];
+static uint8_t interruptsDisabled;                   // nesting depth of disableInterrupts
+static uint8_t deferredEdges;                        // devices whose edge came while interrupts were disabled
+static uint64_t hostNowUs;
+static uint8_t hostQuiet;
+static FILE * hostInput;                             // read by inputGetKey, 0-pointer for no input
+static FILE * hostBinaryOutput;                      // written by writeBinary, 0-pointer for stdout
+static i2cStatistics i2cStats;
+static uint8_t flashStore[ FLASH_STORE_SECTORS ][ FLASH_STORE_SECTOR_SIZE ];
+static uint8_t flashStoreErased;
+
+// ----------------------------------------- virtual time ---------------------------------------
+
+static void hostDispatch ( uint8_t idx )
+{
+  uint8_t i;
+  for ( i = 0; i < MAX_INTERRUPT_HANDLERS; i++ )
+  {
+    if ( interruptHandlers[i].dptr && interruptHandlers[i].pin == devices[idx].interruptPin )
+    {
+      interruptHandlers[i].handler( interruptHandlers[i].dptr, interruptHandlers[i].context );
+    }
+  }
+}
+
+// a falling edge of an interrupt line calls the handlers of that pin
+static void hostCheckInterrupts ( )
+{
+  uint8_t i;
+  for ( i = 0; i < deviceCount; i++ )
+  {
+    uint8_t line = tmf882xSimInterruptLine( devices[i].sim );
+    if ( devices[i].line && !line )
+    {
+      if ( interruptsDisabled )
+      {
+        deferredEdges |= (uint8_t)( 1 << i );
+      }
+      else
+      {
+        hostDispatch( i );
+      }
+    }
+    devices[i].line = line;
+  }
+}
+
+static uint64_t hostNextEvent ( )
+{
+  uint64_t next = TMF882X_SIM_NEVER;
+  uint8_t i;
+  for ( i = 0; i < deviceCount; i++ )
+  {
+    uint64_t t = tmf882xSimNextEvent( devices[i].sim );
+    if ( t < next )
+    {
+      next = t;
+    }
+  }
+  return next;
+}
+
+static void hostRunDevices ( )
+{
+  uint8_t i;
+  for ( i = 0; i < deviceCount; i++ )
+  {
+    tmf882xSimRun( devices[i].sim, hostNowUs );
+  }
+  hostCheckInterrupts( );
+}
+
+// advance the virtual time, the devices see all their events in order
+static void hostRunUntil ( uint64_t untilUs )
+{
+  uint64_t next;
+  while ( ( next = hostNextEvent( ) ) <= untilUs )
+  {
+    if ( next > hostNowUs )
+    {
+      hostNowUs = next;
+    }
+    hostRunDevices( );
+  }
+  if ( untilUs > hostNowUs )
+  {
+    hostNowUs = untilUs;
+  }
+  hostRunDevices( );
+}
+
+// level of the interrupt line of a pin, 1 if no device is connected
+static uint8_t hostInterruptLine ( uint8_t pin )
+{
+  uint8_t i;
+  for ( i = 0; i < deviceCount; i++ )
+  {
+    if ( devices[i].interruptPin == pin )
+    {
+      return tmf882xSimInterruptLine( devices[i].sim );
+    }
+  }
+  return 1;
+}
+
+void hostAttachDevice ( tmf882xSim * sim, uint8_t enablePin, uint8_t interruptPin )
+{
+  if ( deviceCount < HOST_MAX_DEVICES )
+  {
+    devices[ deviceCount ].sim = sim;
+    devices[ deviceCount ].enablePin = enablePin;
+    devices[ deviceCount ].interruptPin = interruptPin;
+    devices[ deviceCount ].line = 1;
+    deviceCount++;
+  }
+}
+
+uint64_t hostTimeUs ( void )
+{
+  return hostNowUs;
+}
+
+void hostSetQuiet ( uint8_t quiet )
+{
+  hostQuiet = quiet;
+}
+
+void hostSetInput ( FILE * input )
+{
+  hostInput = input;
+}
+
+void hostSetBinaryOutput ( FILE * output )
+{
+  hostBinaryOutput = output;
+}
+
+void delayInMicroseconds ( uint32_t wait )
+{
+  hostRunUntil( hostNowUs + wait );
+}
+
+uint32_t getSysTick ( )
+{
+  return (uint32_t)hostNowUs;
+}
+
+// the time stamp counter of the PC where there is one, else nanoseconds
+uint32_t getCycleCount ( )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+  return (uint32_t)__rdtsc( ) & CYCLE_COUNT_MASK;
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now( ).time_since_epoch( ) ).count( ) & CYCLE_COUNT_MASK;
+#endif
+}
+
+uint8_t readProgramMemoryByte ( const uint8_t * ptr )
+{
+  return *ptr;
+}
+
+void readProgramMemory ( uint8_t * dst, const uint8_t * src, uint16_t len )
+{
+  memcpy( dst, src, len );
+}
+
+// ----------------------------------------- pins ---------------------------------------
+
+// bus and pins of the driver instance dptr points to
+static const tmf8828Platform * platformOf ( void * dptr )
+{
+  return &( ((tmf8828Driver *)dptr)->platform );
+}
+
+static void enablePinSet ( void * dptr, uint8_t high )
+{
+  uint8_t i;
+  for ( i = 0; i < deviceCount; i++ )
+  {
+    if ( devices[i].enablePin == platformOf( dptr )->enablePin )
+    {
+      tmf882xSimSetEnable( devices[i].sim, high, hostNowUs );
+    }
+  }
+  hostCheckInterrupts( );
+}
+
+void enablePinHigh ( void * dptr )
+{
+  enablePinSet( dptr, 1 );
+}
+
+void enablePinLow ( void * dptr )
+{
+  enablePinSet( dptr, 0 );
+}
+
+void configurePins ( void * dptr )
+{
+  (void)dptr;
+}
+
+void i2cOpen ( void * dptr, uint32_t i2cClockSpeedInHz )
+{
+  platformOf( dptr )->i2c->clockHz = i2cClockSpeedInHz;
+}
+
+void i2cClose ( void * dptr )
+{
+  (void)dptr;
+}
+
+void pinOutput ( uint8_t pin )
+{
+  (void)pin;
+}
+
+void pinInput ( uint8_t pin )
+{ 
+  (void)pin;
+}
+
+// ----------------------------------------- output and input ---------------------------------------
+
+void printChar ( char c ) 
+{
+  if ( !hostQuiet )
+  {
+    printf( "%c", c );
+  }
+}
+
+void printInt ( int32_t i )
+{
+  if ( !hostQuiet )
+  {
+    printf( "%d", (int)i );
+  }
+}
+
+void printUint ( uint32_t i )
+{
+  if ( !hostQuiet )
+  {
+    printf( "%u", (unsigned)i );
+  }
+}
+
+void printUintHex ( uint32_t i )
+{
+  if ( !hostQuiet )
+  {
+    printf( "%X", (unsigned)i );
+  }
+}
+
+void printStr ( char * str )
+{
+  if ( !hostQuiet )
+  {
+    printf( "%s", str );
+  }
+}
+
+void printConstStr ( const char * str )
+{
+  if ( !hostQuiet )
+  {
+    printf( "%s", str );
+  }
+}
+
+void printLn ( void )
+{
+  if ( !hostQuiet )
+  {
+    printf( "\n" );
+  }
+}
+
+void writeBinary ( const uint8_t * data, uint16_t len )
+{
+  if ( hostBinaryOutput )
+  {
+    fwrite( data, 1, len, hostBinaryOutput );
+  }
+  else if ( !hostQuiet )
+  {
+    fwrite( data, 1, len, stdout );
+  }
+}
+
+// function prints a single result, and returns incremented pointer
+static uint8_t * print_result ( tmf8828Driver * driver, uint8_t * data )
+{
+  uint8_t confidence = data[0];               // 1st byte is confidence
+  uint16_t distance = data[2];                // 3rd byte is MSB distance
+  distance = (distance << 8) + data[1];       // 2nd byte is LSB distnace
+  distance = tmf8828CorrectDistance( driver, distance );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_INT( distance );
+  PRINT_CHAR( SEPARATOR );
+  PRINT_INT( confidence );
+  return data+3;                              // for convenience only, return the new pointer
+}
+
+// Results printing, same format as the target:
+// #Obj,<i2c_slave_address>,<result_number>,<temperature>,<number_valid_results>,<systick>,<distance_0_mm>,<confidence_0>,<distance_1_mm>,<distance_1>, ...
+void printResults ( void * dptr, uint8_t * data, uint8_t len )
+{
+  tmf8828Driver * driver = (tmf8828Driver *)dptr;  
+  if ( len >= TMF8828_COM_CONFIG_RESULT__measurement_result_size )
+  {
+    int8_t i;
+    uint32_t sysTick = tmf8828GetUint32( data + RESULT_REG( SYS_TICK_0 ) );
+    PRINT_STR( "#Obj" );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( driver->i2cSlaveAddress );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( data[ RESULT_REG( RESULT_NUMBER) ] );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( data[ RESULT_REG( TEMPERATURE )] );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( data[ RESULT_REG( NUMBER_VALID_RESULTS )] );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( sysTick );
+    data = data + RESULT_REG( RES_CONFIDENCE_0 );
+    for ( i = 0; i < PRINT_NUMBER_RESULTS ; i++ )
+    {
+      data = print_result( driver, data );
+    }
+    PRINT_LN( );
+  }
+  else // result structure too short
+  {
+    PRINT_STR( "#Err" );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_STR( "result too short" );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( len );
+    PRINT_LN( );
+  }
+}
+
+// Print histograms, same format as the target:
+// #Raw,<i2c_slave_address>,<sub_packet_number>,<data_0>,<data_1>,..,,<data_127>
+// #Cal,<i2c_slave_address>,<sub_packet_number>,<data_0>,<data_1>,..,,<data_127>
+void printHistogram ( void * dptr, uint8_t * data, uint8_t len )
+{
+  tmf8828Driver * driver = (tmf8828Driver *)dptr;  
+  if ( len >= TMF8828_COM_HISTOGRAM_PACKET_SIZE )
+  {
+    uint8_t i;
+    uint8_t * ptr = &( data[ RESULT_REG( SUBPACKET_PAYLOAD_0 ) ] );
+    if ( data[0] & TMF8828_COM_HIST_DUMP__histogram__raw_24_bit_histogram )
+    { 
+      PRINT_STR( "#Raw" );
+    }
+    else if ( data[0] & TMF8828_COM_HIST_DUMP__histogram__electrical_calibration_24_bit_histogram )
+    {
+      PRINT_STR( "#Cal" );
+    }
+    else 
+    {
+      PRINT_STR( "#???" );
+    }
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( driver->i2cSlaveAddress );
+    PRINT_CHAR( SEPARATOR );
+    PRINT_INT( data[ RESULT_REG( SUBPACKET_NUMBER ) ] );
+    for ( i = 0; i < TMF8828_NUMBER_OF_BINS_PER_CHANNEL ; i++, ptr++ )
+    {
+      PRINT_CHAR( SEPARATOR );
+      PRINT_INT( *ptr );
+    }
+    PRINT_LN( );
+  }
+}
+
+void inputOpen ( uint32_t baudrate )
+{
+  (void)baudrate;
+}
+
+void inputClose ( )
+{
+}
+
+// there is no serial input on the host, the application runs with its defaults
+int8_t inputGetKey ( char *c )
+{
+  int ch = ( hostInput ? fgetc( hostInput ) : EOF );
+  if ( ch == EOF )
+  {
+    return 0;
+  }
+  *c = (char)ch;
+  return 1;
+}
+
+// ----------------------------------------- interrupts ---------------------------------------
+
+void setInterruptHandler( void * dptr, interruptHandlerFn handler, void * context )
+{
+  uint8_t i;
+  clrInterruptHandler( dptr );                                    // at most one handler per device
+  for ( i = 0; i < MAX_INTERRUPT_HANDLERS; i++ )
+  {
+    if ( !interruptHandlers[i].dptr )
+    {
+      interruptHandlers[i].handler = handler;
+      interruptHandlers[i].context = context;
+      interruptHandlers[i].pin = platformOf( dptr )->interruptPin;
+      interruptHandlers[i].dptr = dptr;
+      return;
+    }
+  }
+}
+
+void clrInterruptHandler( void * dptr )
+{
+  uint8_t i;
+  for ( i = 0; i < MAX_INTERRUPT_HANDLERS; i++ )
+  {
+    if ( interruptHandlers[i].dptr == dptr )
+    {
+      interruptHandlers[i].dptr = 0;
+    }
+  }
+}
+
+void disableInterrupts ( void )
+{
+  interruptsDisabled++;
+}
+
+// edges that came while interrupts were disabled are handled now, as the NVIC would do
+void enableInterrupts ( void )
+{
+  uint8_t i;
+  if ( interruptsDisabled && --interruptsDisabled == 0 && deferredEdges )
+  {
+    uint8_t edges = deferredEdges;
+    deferredEdges = 0;
+    for ( i = 0; i < deviceCount; i++ )
+    {
+      if ( edges & ( 1 << i ) )
+      {
+        hostDispatch( i );
+      }
+    }
+  }
+}
+
+int8_t waitForInterrupt ( void * dptr, volatile uint8_t * triggered, uint32_t timeoutInMs )
+{
+  return waitForAnyInterrupt( (tmf8828Driver *)dptr, 1, triggered, timeoutInMs );
+}
+
+// instead of sleeping, skip ahead from one device event to the next
+int8_t waitForAnyInterrupt ( tmf8828Driver * drivers, uint8_t count, volatile uint8_t * triggered, uint32_t timeoutInMs )
+{
+  uint64_t timeoutUs = hostNowUs + timeoutInMs * 1000ULL;
+  uint8_t i;
+  while ( !*triggered )
+  {
+    uint64_t next = hostNextEvent( );
+    for ( i = 0; i < count; i++ )
+    {
+      if ( !hostInterruptLine( drivers[i].platform.interruptPin ) )   // line is still (or again) low
+      {
+        return 1;
+      }
+    }
+    if ( next > timeoutUs )
+    {
+      hostRunUntil( timeoutUs );
+      return !!*triggered;
+    }
+    hostRunUntil( next );
+  }
+  return 1;
+}
+
+// ----------------------------------------- flash store ---------------------------------------
+
+// the reserved sectors are kept in RAM, they start erased
+static void flashStoreOpen ( )
+{
+  if ( !flashStoreErased )
+  {
+    memset( flashStore, 0xFF, sizeof( flashStore ) );
+    flashStoreErased = 1;
+  }
+}
+
+const uint8_t * flashStoreSector ( uint8_t sector )
+{
+  if ( sector >= FLASH_STORE_SECTORS )
+  {
+    return 0;
+  }
+  flashStoreOpen( );
+  return flashStore[ sector ];
+}
+
+int8_t flashStoreErase ( uint8_t sector )
+{
+  if ( sector >= FLASH_STORE_SECTORS )
+  {
+    return FLASH_ERR_PARAM;
+  }
+  memset( flashStore[ sector ], 0xFF, FLASH_STORE_SECTOR_SIZE );
+  flashStoreErased = 1;
+  return FLASH_SUCCESS;
+}
+
+int8_t flashStoreProgram ( uint8_t sector, uint16_t offset, const uint8_t * data )
+{
+  uint16_t i;
+  if ( sector >= FLASH_STORE_SECTORS || offset >= FLASH_STORE_SECTOR_SIZE || ( offset % FLASH_STORE_PAGE_SIZE ) )
+  {
+    return FLASH_ERR_PARAM;
+  }
+  flashStoreOpen( );
+  for ( i = 0; i < FLASH_STORE_PAGE_SIZE; i++ )
+  {
+    flashStore[ sector ][ offset + i ] &= data[i];              // programming can only clear bits
+  }
+  return FLASH_SUCCESS;
+}
+
+// ----------------------------------------- i2c ---------------------------------------
+
+static void i2cLogTransfer ( uint8_t logLevel, const char * dir, uint8_t slaveAddr, uint16_t len, const uint8_t * data )
+{
+  if ( logLevel & TMF8828_LOG_LEVEL_I2C ) 
+  {
+    PRINT_STR( dir );
+    PRINT_STR( " (0x" );
+    PRINT_UINT_HEX( slaveAddr );
+    PRINT_STR( ")" );
+    PRINT_STR( " len=" );
+    PRINT_INT( len );
+    if ( logLevel >= TMF8828_LOG_LEVEL_DEBUG ) 
+    {
+      while ( len-- )
+      {
+        PRINT_STR( " 0x" );
+        PRINT_UINT_HEX( *data );
+        data++;
+      }
+    }
+    PRINT_LN( );
+  }
+}
+
+// the transfer takes the time of its bytes on the bus, a nak ends it after the address byte
+static void i2cAccount ( void * dptr, uint16_t bytes, uint16_t busBytes )
+{
+  uint32_t start = getSysTick( );
+  uint32_t bits = busBytes * I2C_BITS_PER_BYTE + I2C_FRAME_BITS;
+  hostRunUntil( hostNowUs + ( bits * 1000000ULL + platformOf( dptr )->i2c->clockHz - 1 ) / platformOf( dptr )->i2c->clockHz );
+  i2cStats.transactions++;
+  i2cStats.bytes += bytes;
+  i2cStats.busTimeUs += getSysTick( ) - start;
+  i2cStats.cpuBusyTimeUs += getSysTick( ) - start;          // blocking transfers
+}
+
+// all devices at the slave address take part, several of them drive the bus wired-and
+static int8_t i2cTransfer ( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t len, uint8_t * rxData, const uint8_t * txData )
+{
+  uint8_t buffer[ I2C_MAX_TRANSFER ];
+  uint8_t ack = 0;
+  uint8_t i;
+  uint16_t j;
+  if ( len > I2C_MAX_TRANSFER )
+  {
+    return I2C_ERR_DATA_TOO_LONG;
+  }
+  for ( i = 0; i < deviceCount; i++ )
+  {
+    if ( txData )
+    {
+      ack |= tmf882xSimWrite( devices[i].sim, slaveAddr, regAddr, txData, len, hostNowUs );
+    }
+    else if ( tmf882xSimRead( devices[i].sim, slaveAddr, regAddr, ack ? buffer : rxData, len, hostNowUs ) )
+    {
+      for ( j = 0; ack && j < len; j++ )
+      {
+        rxData[j] &= buffer[j];
+      }
+      ack = 1;
+    }
+  }
+  hostCheckInterrupts( );
+  if ( !ack )
+  {
+    i2cAccount( dptr, 1, 1 );
+    return I2C_ERR_SLAVE_ADDR_NAK;
+  }
+  i2cAccount( dptr, len + 1, len + ( txData ? 2 : 3 ) );   // a read has the address twice (repeated start)
+  return I2C_SUCCESS;
+}
+
+int8_t i2cTxReg ( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t toTx, const uint8_t * txData )
+{
+  tmf8828Driver * driver = (tmf8828Driver *)dptr;
+  if ( driver->logLevel & TMF8828_LOG_LEVEL_I2C )
+  {
+    uint8_t buffer[ I2C_MAX_TRANSFER + 1 ];
+    buffer[0] = regAddr;
+    memcpy( &buffer[1], txData, ( toTx > I2C_MAX_TRANSFER ? I2C_MAX_TRANSFER : toTx ) );
+    i2cLogTransfer( driver->logLevel, "I2C-TX", slaveAddr, toTx + 1, buffer );
+  }
+  return i2cTransfer( dptr, slaveAddr, regAddr, toTx, 0, txData );
+}
+
+int8_t i2cRxReg ( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t toRx, uint8_t * rxData )
+{
+  tmf8828Driver * driver = (tmf8828Driver *)dptr;
+  int8_t res = i2cTransfer( dptr, slaveAddr, regAddr, toRx, rxData, 0 );
+  i2cLogTransfer( driver->logLevel, "I2C-RX", slaveAddr, toRx, rxData );
+  return res;
+}
+
+int8_t i2cTxRx ( void * dptr, uint8_t slaveAddr, uint16_t toTx, const uint8_t * txData, uint16_t toRx, uint8_t * rxData )
+{
+  int8_t res = I2C_SUCCESS;
+  uint8_t regAddr = ( toTx ? txData[0] : 0 );
+  if ( toTx )
+  {
+    res = i2cTxReg( dptr, slaveAddr, regAddr, toTx-1, txData+1 );
+  }
+  if ( toRx && res == I2C_SUCCESS )
+  {
+    res = i2cRxReg( dptr, slaveAddr, regAddr, toRx, rxData );         // the register pointer is still at the written address
+  }
+  return res;
+}
+
+// there is no DMA on the host, the transfer is done when the function returns
+int8_t i2cRxRegAsync ( void * dptr, uint8_t slaveAddr, uint8_t regAddr, uint16_t toRx, uint8_t * rxData, i2cDoneCallback done, void * context )
+{
+  int8_t res = i2cRxReg( dptr, slaveAddr, regAddr, toRx, rxData );
+  done( context, res );
+  return I2C_SUCCESS;
+}
+
+int8_t i2cIsBusy ( void * dptr )
+{
+  (void)dptr;
+  return 0;
+}
+
+void i2cGetStatistics ( void * dptr, i2cStatistics * stats )
+{
+  (void)dptr;
+  *stats = i2cStats;
+}
+
+void i2cResetStatistics ( void * dptr )
+{
+  (void)dptr;
+  memset( &i2cStats, 0, sizeof( i2cStats ) );
+}
@@ -0,0 +1,120 @@
+/* Host benchmark of the direction regression: the two-pass float least squares over the gesture history that
+ * determine_direction used before, against the incremental fixed-point SlopeWindow it uses now.
+ * Both get the same centroid stream (swipes with noise, and gaps that clear the history like the game does).
+ * Reports time and cycles per frame (the time stamp counter on a PC) and the largest difference of the slopes.
+ * On the device the cost of the direction update is part of the periodic statistics: #Gesture,<updates>,<avg cycles>,<max cycles>
+ * Usage: tmf8828_host_slope_bench [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0ULL
+#endif
+#include "tmf8828_ring.h"
+#include "tmf8828_slope.h"
+
+#define HISTORY_FRAMES  20              // GESTURE_HISTORY_FRAMES
+#define POS_SCALE       16              // GESTURE_POS_SCALE
+
+struct Centroid {
+    float cx;
+    float cy;
+};
+
+// the previous determine_direction regression
+static void slope_two_pass(const FrameRing<Centroid, HISTORY_FRAMES> &buffer, float *x_slope, float *y_slope)
+{
+    size_t n = buffer.size();
+    float idx_mean = (n - 1) / 2.0f;
+    float cx_mean = 0.0f;
+    float cy_mean = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        cx_mean += buffer[i].cx;
+        cy_mean += buffer[i].cy;
+    }
+    cx_mean /= n;
+    cy_mean /= n;
+
+    float sxx = 0.0f;
+    float sx_cx = 0.0f;
+    float sx_cy = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float di = i - idx_mean;
+        sxx += di * di;
+        sx_cx += di * (buffer[i].cx - cx_mean);
+        sx_cy += di * (buffer[i].cy - cy_mean);
+    }
+    *x_slope = sx_cx / sxx;
+    *y_slope = sx_cy / sxx;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t frames = (argc > 1 ? strtoul(argv[1], 0, 0) : 1000000);
+    Centroid *stream = new Centroid[frames];
+    srand(1);
+    for (size_t i = 0; i < frames; i++) {
+        size_t phase = i % 90;                  // 60 frames of a swipe with noise, then 30 frames without a hand
+        float noise_x = (rand() % 200 - 100) / 50.0f;
+        float noise_y = (rand() % 200 - 100) / 50.0f;
+        stream[i].cx = (phase < 60 ? -60.0f + 2.0f * phase + noise_x : NAN);
+        stream[i].cy = (phase < 60 ? 10.0f + noise_y : NAN);
+    }
+
+    FrameRing<Centroid, HISTORY_FRAMES> history;
+    SlopeWindow<HISTORY_FRAMES> window;
+    float x_slope[2] = { 0.0f, 0.0f };         // of the last update, [0] before, [1] after
+    float y_slope[2] = { 0.0f, 0.0f };
+    float max_diff = 0.0f;
+    size_t updates = 0;
+    double ns[2];
+    double cycles[2];
+    for (int pass = 0; pass < 3; pass++) {      // before, after, both for the comparison
+        auto t0 = std::chrono::steady_clock::now();
+        unsigned long long c0 = CYCLES();
+        updates = 0;
+        history.clear();
+        window.clear();
+        for (size_t i = 0; i < frames; i++) {
+            if (isnan(stream[i].cx)) {
+                history.clear();
+                window.clear();
+                continue;
+            }
+            updates++;
+            if (pass != 1) {
+                history.push(stream[i]);
+                if (history.size() >= 3) {
+                    slope_two_pass(history, &x_slope[0], &y_slope[0]);
+                }
+            }
+            if (pass != 0) {
+                window.push((int32_t)lroundf(stream[i].cx * POS_SCALE), (int32_t)lroundf(stream[i].cy * POS_SCALE));
+                if (window.size() >= 3) {
+                    x_slope[1] = window.slope_x() / (float)POS_SCALE;
+                    y_slope[1] = window.slope_y() / (float)POS_SCALE;
+                }
+            }
+            if (pass == 2 && window.size() >= 3) {
+                max_diff = fmaxf(max_diff, fmaxf(fabsf(x_slope[0] - x_slope[1]), fabsf(y_slope[0] - y_slope[1])));
+            }
+        }
+        unsigned long long c1 = CYCLES();
+        auto t1 = std::chrono::steady_clock::now();
+        if (pass < 2) {
+            ns[pass] = std::chrono::duration<double, std::nano>(t1 - t0).count() / updates;
+            cycles[pass] = (double)(c1 - c0) / updates;
+        }
+    }
+    delete[] stream;
+
+    // #Slope,<updates>,<before ns>,<after ns>,<before cycles>,<after cycles>,<max slope difference mm per frame>
+    printf("#Slope,%zu,%.1f,%.1f,%.0f,%.0f,%.3f\n", updates, ns[0], ns[1], cycles[0], cycles[1], max_diff);
+    return 0;
+}
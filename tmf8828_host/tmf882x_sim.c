@@ -0,0 +1,911 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include <string.h>
+#include "tmf882x_sim.h"
+
+// ---------------------------------------------- defines -----------------------------------------
+
+// registers
+#define REG_APP_ID                  0x00
+#define REG_CMD_STAT                0x08
+#define REG_MODE                    0x10
+#define REG_SERIAL_NUMBER_0         0x1C
+#define REG_WINDOW                  0x20        // config, calibration and result pages
+#define REG_ENABLE                  0xE0
+#define REG_INT_STATUS              0xE1
+#define REG_INT_ENAB                0xE2
+#define REG_ID                      0xE3
+#define REG_REVID                   0xE4
+#define REG_CLOCK                   0xEC
+#define REG_RESETREASON             0xF0
+
+#define ENABLE_PON                  0x01
+#define ENABLE_CPU_READY            0x40
+#define ENABLE_CPU_RESET            0x80
+#define RESETREASON_SOFT_RESET      0x80
+#define RESETREASON_RRSN_SOFT_RESET 0x02
+#define RESETREASON_RRSN_COLDSTART  0x01
+
+#define CHIP_ID                     0x08
+#define CHIP_REVID                  0x01
+
+#define APP_ID_APPLICATION          0x03
+#define APP_ID_BOOTLOADER           0x80
+#define APP_VERSION_MAJOR           4
+#define APP_VERSION_MINOR           13
+#define APP_VERSION_PATCH           1
+
+#define MODE_TMF8821                0x00
+#define MODE_TMF8828                0x08
+
+// bootloader commands and status
+#define BL_CMD_RAMREMAP             0x11
+#define BL_CMD_W_RAM                0x41
+#define BL_CMD_ADDR_RAM             0x43
+#define BL_STAT_OK                  0x00
+#define BL_STAT_ERR_SIZE            0x01
+#define BL_STAT_ERR_CSUM            0x02
+#define BL_STAT_ERR_RANGE           0x07
+#define BL_HEADER                   2
+#define BL_RAM_SIZE                 0x8000
+
+// application commands and status
+#define CMD_MEASURE                 0x10
+#define CMD_WRITE_CONFIG            0x15
+#define CMD_LOAD_COMMON             0x16
+#define CMD_LOAD_FACTORY_CALIB      0x19
+#define CMD_RESET_FACTORY_CALIB     0x1F
+#define CMD_FACTORY_CALIB           0x20
+#define CMD_I2C_SLAVE_ADDRESS       0x21
+#define CMD_SWITCH_TMF8821_MODE     0x65
+#define CMD_SWITCH_TMF8828_MODE     0x6C
+#define CMD_STOP                    0xFF
+#define STAT_OK                     0x00
+#define STAT_ACCEPTED               0x01
+#define STAT_ERR_CONFIG             0x02
+#define STAT_ERR_UNKNOWN_CMD        0x0F
+
+// offsets in the common config page
+#define CFG_SIZE_LSB                0x02
+#define CFG_PERIOD_MS_LSB           0x04
+#define CFG_KILO_ITERATIONS_LSB     0x06
+#define CFG_SPAD_MAP_ID             0x14
+#define CFG_HIST_DUMP               0x19
+#define CFG_I2C_SLAVE_ADDRESS       0x1B
+
+// offsets in result pages and histogram sub-packets
+#define RESULT_PAGE_ID              0x10
+#define RESULT_SIZE                 0x84
+#define RES_RESULT_NUMBER           0x04
+#define RES_TEMPERATURE             0x05
+#define RES_NUMBER_VALID_RESULTS    0x06
+#define RES_SYS_TICK_0              0x14
+#define RES_RECORDS                 0x18
+#define RES_SLOTS                   18          // records per target
+#define HIST_SUBPACKET_HEADER       0x80
+#define HIST_SUBPACKET_NUMBER       0x04
+#define HIST_SUBPACKET_PAYLOAD      0x05
+#define HIST_SUBPACKET_CFG_IDX      0x06
+#define HIST_SUBPACKET_PAYLOAD_0    0x07
+#define HIST_CHANNELS               10
+#define HIST_BINS                   128
+#define HIST_SUBPACKETS             ( HIST_CHANNELS * 3 )
+#define HIST_MM_PER_BIN             25
+#define HIST_REFERENCE_BIN          8           // channel 0 sees the optical reference
+
+// interrupt status bits
+#define INT_RESULT                  0x02
+#define INT_RAW_HISTOGRAM           0x08
+
+#define SPAD_MAP_8X8                15
+#define SUB_CAPTURE_MASK            0x03
+#define NO_ZONE                     0xFF
+#define TICKS_PER_US                5
+#define TEMPERATURE                 28
+
+// execution times in microseconds
+#define CPU_READY_US                100
+#define BL_CMD_US                   20
+#define BL_RAMREMAP_US              2000
+#define CMD_LOAD_US                 200
+#define CMD_WRITE_US                300
+#define CMD_MEASURE_US              150
+#define CMD_STOP_US                 100
+#define CMD_I2C_SLAVE_ADDRESS_US    100
+#define CMD_SWITCH_MODE_US          500
+#define CMD_FACTORY_CALIB_US        400000
+#define CMD_DEFAULT_US              100
+#define US_PER_KILO_ITERATION       50          // integration time of 1024 iterations
+#define CAPTURE_OVERHEAD_US         1000
+#define ACK_TIMEOUT_US              5000        // a packet whose interrupt was cleared but that was never read is replaced after this time
+
+// ---------------------------------------------- constants -----------------------------------------
+
+// zone of each record of a result page, same layout as the device reports it
+static const uint8_t slotToZone3x3[ RES_SLOTS ] =
+{ 0, 1, 2, 3, 4, 5, 6, 7, 8
+, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE, NO_ZONE
+};
+
+static const uint8_t slotToZone3x6[ RES_SLOTS ] =
+{ 0, 1, 2, 3, 4, 5, 6, 7, 8
+, 9, 10, 11, 12, 13, 14, 15, 16, 17
+};
+
+static const uint8_t slotToZone4x4[ RES_SLOTS ] =
+{ 0, 1, 2, 3, 4, 5, 6, 7, NO_ZONE
+, 8, 9, 10, 11, 12, 13, 14, 15, NO_ZONE
+};
+
+// ---------------------------------------------- functions ---------------------------------------
+
+static uint16_t tmf882xSimGetUint16 ( const uint8_t * p )
+{
+  return (uint16_t)( p[0] | ( p[1] << 8 ) );
+}
+
+// device sys-tick at the given host time, the LSB marks a valid tick
+static uint32_t tmf882xSimTick ( const tmf882xSim * sim, uint64_t us )
+{
+  int64_t ticks = (int64_t)( us * TICKS_PER_US );
+  ticks += ticks * sim->clockErrorPpm / 1000000;
+  return (uint32_t)ticks | 1;
+}
+
+static void tmf882xSimClearQueue ( tmf882xSim * sim )
+{
+  sim->queueHead = 0;
+  sim->queueCount = 0;
+  sim->published = 0;
+}
+
+static tmf882xSimPacket * tmf882xSimEnqueue ( tmf882xSim * sim, uint8_t intMask, uint8_t len )
+{
+  tmf882xSimPacket * p;
+  if ( sim->queueCount >= TMF882X_SIM_QUEUE )
+  {
+    sim->stats.dropped++;
+    return 0;
+  }
+  p = &( sim->queue[ ( sim->queueHead + sim->queueCount ) % TMF882X_SIM_QUEUE ] );
+  sim->queueCount++;
+  p->intMask = intMask;
+  p->len = len;
+  memset( p->data, 0, sizeof( p->data ) );
+  return p;
+}
+
+// the oldest packet goes to the register window once the host is done with the previous one
+static void tmf882xSimPublish ( tmf882xSim * sim, uint64_t nowUs )
+{
+  const tmf882xSimPacket * p;
+  if ( sim->published )
+  {
+    if ( sim->reg[ REG_INT_STATUS ] & sim->published )                    // not yet acknowledged
+    {
+      return;
+    }
+    if ( !sim->publishedRead && nowUs - sim->ackUs < ACK_TIMEOUT_US )
+    {
+      return;
+    }
+    sim->published = 0;
+  }
+  if ( !sim->queueCount || sim->state != TMF882X_SIM_APP )
+  {
+    return;
+  }
+  p = &( sim->queue[ sim->queueHead ] );
+  sim->queueHead = ( sim->queueHead + 1 ) % TMF882X_SIM_QUEUE;
+  sim->queueCount--;
+  memcpy( sim->reg + REG_WINDOW, p->data, p->len );
+  sim->reg[ REG_INT_STATUS ] |= p->intMask;
+  sim->published = p->intMask;
+  sim->publishedRead = 0;
+  sim->pageLoaded = 0;
+}
+
+static void tmf882xSimDefaultConfig ( tmf882xSim * sim )
+{
+  memset( sim->config, 0, sizeof( sim->config ) );
+  sim->config[ 0 ] = CMD_LOAD_COMMON;
+  sim->config[ CFG_SIZE_LSB ] = TMF882X_SIM_PAGE_SIZE - 4;
+  sim->config[ CFG_PERIOD_MS_LSB ] = 33;
+  sim->config[ CFG_KILO_ITERATIONS_LSB ] = (uint8_t)537;
+  sim->config[ CFG_KILO_ITERATIONS_LSB + 1 ] = (uint8_t)( 537 >> 8 );
+  sim->config[ CFG_SPAD_MAP_ID ] = ( sim->mode8x8 ? SPAD_MAP_8X8 : 1 );
+  sim->config[ CFG_I2C_SLAVE_ADDRESS ] = (uint8_t)( sim->slaveAddr << 1 );
+}
+
+// state after the supply came up, the RAM content is undefined
+static void tmf882xSimPowerOn ( tmf882xSim * sim )
+{
+  memset( sim->reg, 0, sizeof( sim->reg ) );
+  sim->reg[ REG_ID ] = CHIP_ID;
+  sim->reg[ REG_REVID ] = CHIP_REVID;
+  sim->reg[ REG_RESETREASON ] = RESETREASON_RRSN_COLDSTART;
+  sim->state = TMF882X_SIM_STANDBY;
+  sim->slaveAddr = TMF882X_SIM_SLAVE_ADDR;
+  sim->appInRam = 0;
+  sim->mode8x8 = 0;
+  sim->calibIdx = 0;
+  memset( sim->calib, 0, sizeof( sim->calib ) );
+  tmf882xSimDefaultConfig( sim );
+}
+
+// start the bootloader, after power on, a soft reset or a brown-out
+static void tmf882xSimBoot ( tmf882xSim * sim, uint64_t nowUs )
+{
+  uint8_t enable = sim->reg[ REG_ENABLE ];
+  uint8_t resetReason = sim->reg[ REG_RESETREASON ];
+  memset( sim->reg, 0, sizeof( sim->reg ) );
+  sim->reg[ REG_ENABLE ] = enable;
+  sim->reg[ REG_RESETREASON ] = resetReason;
+  sim->reg[ REG_ID ] = CHIP_ID;
+  sim->reg[ REG_REVID ] = CHIP_REVID;
+  sim->reg[ REG_APP_ID ] = APP_ID_BOOTLOADER;
+  sim->state = TMF882X_SIM_BOOTLOADER;
+  sim->cpuReadyUs = nowUs + CPU_READY_US;
+  sim->ramAddr = 0;
+  sim->ramBytes = 0;
+  sim->appInRam = 0;
+  sim->cmd = 0;
+  sim->measuring = 0;
+  sim->pageLoaded = 0;
+  tmf882xSimClearQueue( sim );
+}
+
+// the measurement application takes over after the RAM remap
+static void tmf882xSimStartApp ( tmf882xSim * sim )
+{
+  sim->state = TMF882X_SIM_APP;
+  sim->appInRam = 1;
+  sim->reg[ REG_APP_ID ] = APP_ID_APPLICATION;
+  sim->reg[ REG_APP_ID + 1 ] = APP_VERSION_MAJOR;
+  sim->reg[ REG_APP_ID + 2 ] = APP_VERSION_MINOR;
+  sim->reg[ REG_APP_ID + 3 ] = APP_VERSION_PATCH;
+  sim->reg[ REG_CMD_STAT ] = STAT_OK;
+  sim->reg[ REG_MODE ] = ( sim->mode8x8 ? MODE_TMF8828 : MODE_TMF8821 );
+  sim->reg[ REG_SERIAL_NUMBER_0 ] = (uint8_t)sim->serialNumber;
+  sim->reg[ REG_SERIAL_NUMBER_0 + 1 ] = (uint8_t)( sim->serialNumber >> 8 );
+  sim->reg[ REG_SERIAL_NUMBER_0 + 2 ] = (uint8_t)( sim->serialNumber >> 16 );
+  sim->reg[ REG_SERIAL_NUMBER_0 + 3 ] = (uint8_t)( sim->serialNumber >> 24 );
+  sim->calibIdx = 0;
+  if ( sim->fault == TMF882X_SIM_FAULT_BROWNOUT )
+  {
+    sim->fault = TMF882X_SIM_FAULT_NONE;
+  }
+}
+
+static void tmf882xSimSetMode ( tmf882xSim * sim, uint8_t mode8x8 )
+{
+  sim->mode8x8 = mode8x8;
+  sim->reg[ REG_MODE ] = ( mode8x8 ? MODE_TMF8828 : MODE_TMF8821 );
+  if ( mode8x8 )
+  {
+    sim->config[ CFG_SPAD_MAP_ID ] = SPAD_MAP_8X8;
+  }
+  else if ( sim->config[ CFG_SPAD_MAP_ID ] == SPAD_MAP_8X8 )
+  {
+    sim->config[ CFG_SPAD_MAP_ID ] = 1;
+  }
+  sim->calibIdx = 0;
+}
+
+static uint8_t tmf882xSimCalibPages ( const tmf882xSim * sim )
+{
+  return ( sim->mode8x8 ? TMF882X_SIM_CALIB_PAGES : 1 );
+}
+
+static uint8_t tmf882xSimTimeMultiplexed ( uint8_t spadMapId )
+{
+  return spadMapId == 4 || spadMapId == 5 || spadMapId == 7 || spadMapId == 10 || spadMapId == 13;
+}
+
+// zone layout of the configured SPAD map: slot table, rows, columns and zones per result page
+static const uint8_t * tmf882xSimLayout ( const tmf882xSim * sim, uint8_t * rows, uint8_t * cols, uint8_t * zonesPerPage )
+{
+  uint8_t spadMapId = sim->config[ CFG_SPAD_MAP_ID ];
+  if ( sim->mode8x8 )
+  {
+    *rows = 8;
+    *cols = 8;
+    *zonesPerPage = 16;
+    return slotToZone4x4;
+  }
+  if ( spadMapId == 10 )
+  {
+    *rows = 6;
+    *cols = 3;
+    *zonesPerPage = 18;
+    return slotToZone3x6;
+  }
+  if ( tmf882xSimTimeMultiplexed( spadMapId ) )
+  {
+    *rows = 4;
+    *cols = 4;
+    *zonesPerPage = 16;
+    return slotToZone4x4;
+  }
+  *rows = 3;
+  *cols = 3;
+  *zonesPerPage = 9;
+  return slotToZone3x3;
+}
+
+// time from one result to the next: the period, or the integration if that takes longer
+static uint32_t tmf882xSimResultSpacing ( const tmf882xSim * sim )
+{
+  uint32_t periodUs = tmf882xSimGetUint16( sim->config + CFG_PERIOD_MS_LSB ) * 1000UL;
+  uint32_t captureUs = tmf882xSimGetUint16( sim->config + CFG_KILO_ITERATIONS_LSB ) * US_PER_KILO_ITERATION + CAPTURE_OVERHEAD_US;
+  if ( !sim->mode8x8 && tmf882xSimTimeMultiplexed( sim->config[ CFG_SPAD_MAP_ID ] ) )
+  {
+    captureUs *= 2;                                     // both halves of the SPAD map are measured one after the other
+  }
+  return ( captureUs > periodUs ? captureUs : periodUs );
+}
+
+// raw histograms of one capture: 10 channels of 128 24-bit bins, sent as 30 sub-packets LSB first
+static void tmf882xSimHistograms ( tmf882xSim * sim, uint16_t distance, uint8_t cfgIdx )
+{
+  uint8_t peak = ( distance ? (uint8_t)( distance / HIST_MM_PER_BIN ) : 0 );
+  uint8_t sp;
+  for ( sp = 0; sp < HIST_SUBPACKETS; sp++ )
+  {
+    tmf882xSimPacket * p = tmf882xSimEnqueue( sim, INT_RAW_HISTOGRAM, TMF882X_SIM_PACKET_SIZE );
+    uint8_t channel = sp % HIST_CHANNELS;
+    uint8_t shift = 8 * ( sp / HIST_CHANNELS );
+    uint8_t center = ( channel == 0 ? HIST_REFERENCE_BIN : peak );
+    uint8_t b;
+    if ( !p )
+    {
+      return;
+    }
+    p->data[ 0 ] = HIST_SUBPACKET_HEADER | ( sim->config[ CFG_HIST_DUMP ] & 0x3 );
+    p->data[ 2 ] = HIST_BINS + 3;
+    p->data[ HIST_SUBPACKET_NUMBER ] = sp;
+    p->data[ HIST_SUBPACKET_PAYLOAD ] = HIST_BINS;
+    p->data[ HIST_SUBPACKET_CFG_IDX ] = cfgIdx;
+    for ( b = 0; b < HIST_BINS; b++ )
+    {
+      uint32_t value = 100 + 3 * channel;                 // ambient
+      uint8_t d = ( b > center ? b - center : center - b );
+      if ( center && d < 4 )
+      {
+        value += ( 4 - d ) * 20000UL;
+      }
+      p->data[ HIST_SUBPACKET_PAYLOAD_0 + b ] = (uint8_t)( value >> shift );
+    }
+    sim->stats.histograms++;
+  }
+}
+
+// one capture: the histograms (if enabled) and the result page
+static void tmf882xSimCapture ( tmf882xSim * sim, uint64_t captureUs )
+{
+  uint16_t distance[ TMF882X_SIM_TARGETS ][ TMF882X_SIM_MAX_ZONES ];
+  uint8_t confidence[ TMF882X_SIM_TARGETS ][ TMF882X_SIM_MAX_ZONES ];
+  uint8_t rows, cols, zonesPerPage;
+  const uint8_t * slotToZone = tmf882xSimLayout( sim, &rows, &cols, &zonesPerPage );
+  uint8_t subCapture = ( sim->mode8x8 ? ( sim->resultNumber & SUB_CAPTURE_MASK ) : 0 );
+  uint32_t tick = tmf882xSimTick( sim, captureUs );
+  tmf882xSimPacket * p;
+  uint8_t * rec;
+  uint8_t valid = 0;
+  uint8_t t, i;
+
+  sim->nextCaptureUs = captureUs + tmf882xSimResultSpacing( sim );
+  if ( sim->fault == TMF882X_SIM_FAULT_HANG )
+  {
+    return;
+  }
+  memset( distance, 0, sizeof( distance ) );
+  memset( confidence, 0, sizeof( confidence ) );
+  if ( sim->scene )
+  {
+    sim->scene( sim->sceneContext, captureUs, rows, cols, distance, confidence );
+  }
+  if ( sim->config[ CFG_HIST_DUMP ] )
+  {
+    tmf882xSimHistograms( sim, distance[0][ subCapture * zonesPerPage + slotToZone[0] ], subCapture );
+  }
+  p = tmf882xSimEnqueue( sim, INT_RESULT, RESULT_SIZE );
+  sim->resultNumber++;
+  if ( !p )
+  {
+    return;
+  }
+  p->data[ 0 ] = RESULT_PAGE_ID;
+  p->data[ 2 ] = RESULT_SIZE - 4;
+  p->data[ RES_RESULT_NUMBER ] = (uint8_t)( sim->resultNumber - 1 );
+  p->data[ RES_TEMPERATURE ] = TEMPERATURE;
+  p->data[ RES_SYS_TICK_0 ] = (uint8_t)tick;
+  p->data[ RES_SYS_TICK_0 + 1 ] = (uint8_t)( tick >> 8 );
+  p->data[ RES_SYS_TICK_0 + 2 ] = (uint8_t)( tick >> 16 );
+  p->data[ RES_SYS_TICK_0 + 3 ] = (uint8_t)( tick >> 24 );
+  rec = p->data + RES_RECORDS;
+  for ( t = 0; t < TMF882X_SIM_TARGETS; t++ )            // records of the second target follow those of the first
+  {
+    for ( i = 0; i < RES_SLOTS; i++, rec += 3 )
+    {
+      uint8_t z = slotToZone[i];
+      if ( z != NO_ZONE && distance[t][ subCapture * zonesPerPage + z ] )
+      {
+        // the device measures the time of flight with its own clock
+        int64_t d = distance[t][ subCapture * zonesPerPage + z ];
+        d += d * sim->clockErrorPpm / 1000000;
+        d = ( d > 0xFFFF ? 0xFFFF : d );
+        rec[0] = confidence[t][ subCapture * zonesPerPage + z ];
+        rec[1] = (uint8_t)d;
+        rec[2] = (uint8_t)( d >> 8 );
+        valid++;
+      }
+    }
+  }
+  p->data[ RES_NUMBER_VALID_RESULTS ] = valid;
+  sim->stats.results++;
+}
+
+// deterministic calibration data, different for every device and page
+static void tmf882xSimFactoryCalibration ( tmf882xSim * sim )
+{
+  uint8_t k;
+  uint8_t i;
+  for ( k = 0; k < TMF882X_SIM_CALIB_PAGES; k++ )
+  {
+    sim->calib[k][0] = CMD_LOAD_FACTORY_CALIB;
+    for ( i = 1; i < TMF882X_SIM_PAGE_SIZE; i++ )
+    {
+      sim->calib[k][i] = (uint8_t)( sim->serialNumber * 31 + k * 7 + i );
+    }
+  }
+  sim->calibIdx = 0;
+}
+
+static void tmf882xSimBootloaderCommand ( tmf882xSim * sim )
+{
+  const uint8_t * frame = sim->cmdFrame;
+  uint8_t len = frame[1];
+  uint8_t sum = 0;
+  uint8_t stat = BL_STAT_OK;
+  uint16_t i;
+  for ( i = 0; i < BL_HEADER + len; i++ )
+  {
+    sum += frame[i];
+  }
+  sum = sum ^ 0xFF;
+  if ( sum != frame[ BL_HEADER + len ] )
+  {
+    stat = BL_STAT_ERR_CSUM;
+  }
+  else if ( frame[0] == BL_CMD_ADDR_RAM )
+  {
+    if ( len != 2 )
+    {
+      stat = BL_STAT_ERR_SIZE;
+    }
+    else
+    {
+      sim->ramAddr = tmf882xSimGetUint16( frame + BL_HEADER );
+    }
+  }
+  else if ( frame[0] == BL_CMD_W_RAM )
+  {
+    if ( (uint32_t)sim->ramAddr + len > BL_RAM_SIZE )
+    {
+      stat = BL_STAT_ERR_RANGE;
+    }
+    else
+    {
+      sim->ramAddr += len;
+      sim->ramBytes += len;
+      sim->stats.downloadBytes += len;
+    }
+  }
+  else if ( frame[0] == BL_CMD_RAMREMAP && sim->ramBytes )
+  {
+    tmf882xSimStartApp( sim );                          // the bootloader does not answer a successful remap
+    return;
+  }
+  else
+  {
+    stat = BL_STAT_ERR_RANGE;
+  }
+  sim->reg[ REG_CMD_STAT ] = stat;
+  sim->reg[ REG_CMD_STAT + 1 ] = 0;
+  sim->reg[ REG_CMD_STAT + 2 ] = 0xFF;
+}
+
+static void tmf882xSimAppCommand ( tmf882xSim * sim, uint8_t cmd, uint64_t nowUs )
+{
+  uint8_t stat = STAT_OK;
+  switch ( cmd )
+  {
+    case CMD_LOAD_COMMON:
+      memcpy( sim->reg + REG_WINDOW, sim->config, TMF882X_SIM_PAGE_SIZE );
+      sim->pageLoaded = CMD_LOAD_COMMON;
+      break;
+    case CMD_LOAD_FACTORY_CALIB:
+      sim->calib[ sim->calibIdx ][0] = CMD_LOAD_FACTORY_CALIB;
+      memcpy( sim->reg + REG_WINDOW, sim->calib[ sim->calibIdx ], TMF882X_SIM_PAGE_SIZE );
+      sim->calibLoaded = sim->calibIdx;
+      sim->calibIdx = ( sim->calibIdx + 1 ) % tmf882xSimCalibPages( sim );
+      sim->pageLoaded = CMD_LOAD_FACTORY_CALIB;
+      break;
+    case CMD_WRITE_CONFIG:
+      if ( sim->pageLoaded == CMD_LOAD_COMMON )
+      {
+        uint8_t spadMapId = sim->reg[ REG_WINDOW + CFG_SPAD_MAP_ID ];
+        if ( sim->mode8x8 ? spadMapId != SPAD_MAP_8X8 : ( spadMapId < 1 || spadMapId > 13 ) )
+        {
+          stat = STAT_ERR_CONFIG;
+          break;
+        }
+        memcpy( sim->config, sim->reg + REG_WINDOW, TMF882X_SIM_PAGE_SIZE );
+        sim->config[0] = CMD_LOAD_COMMON;
+      }
+      else if ( sim->pageLoaded == CMD_LOAD_FACTORY_CALIB )
+      {
+        memcpy( sim->calib[ sim->calibLoaded ], sim->reg + REG_WINDOW, TMF882X_SIM_PAGE_SIZE );
+      }
+      else
+      {
+        stat = STAT_ERR_CONFIG;
+      }
+      break;
+    case CMD_MEASURE:
+      if ( !sim->measuring )
+      {
+        sim->measuring = 1;
+        sim->resultNumber = ( sim->resultNumber + SUB_CAPTURE_MASK ) & ~SUB_CAPTURE_MASK;   // 8x8 frames start with sub-capture 0
+        sim->nextCaptureUs = nowUs + tmf882xSimResultSpacing( sim );
+      }
+      if ( sim->fault == TMF882X_SIM_FAULT_HANG )
+      {
+        sim->fault = TMF882X_SIM_FAULT_NONE;
+      }
+      stat = STAT_ACCEPTED;
+      break;
+    case CMD_STOP:
+      sim->measuring = 0;
+      tmf882xSimClearQueue( sim );
+      break;
+    case CMD_FACTORY_CALIB:
+      tmf882xSimFactoryCalibration( sim );
+      break;
+    case CMD_RESET_FACTORY_CALIB:
+      sim->calibIdx = 0;
+      break;
+    case CMD_I2C_SLAVE_ADDRESS:
+      if ( ( sim->config[ CFG_I2C_SLAVE_ADDRESS ] >> 1 ) == 0 )
+      {
+        stat = STAT_ERR_CONFIG;
+      }
+      else
+      {
+        sim->slaveAddr = sim->config[ CFG_I2C_SLAVE_ADDRESS ] >> 1;
+      }
+      break;
+    case CMD_SWITCH_TMF8821_MODE:
+      tmf882xSimSetMode( sim, 0 );
+      break;
+    case CMD_SWITCH_TMF8828_MODE:
+      tmf882xSimSetMode( sim, 1 );
+      break;
+    default:
+      stat = STAT_ERR_UNKNOWN_CMD;
+      break;
+  }
+  sim->reg[ REG_CMD_STAT ] = stat;
+}
+
+static uint32_t tmf882xSimCommandTime ( uint8_t state, uint8_t cmd )
+{
+  if ( state == TMF882X_SIM_BOOTLOADER )
+  {
+    return ( cmd == BL_CMD_RAMREMAP ? BL_RAMREMAP_US : BL_CMD_US );
+  }
+  switch ( cmd )
+  {
+    case CMD_LOAD_COMMON:
+    case CMD_LOAD_FACTORY_CALIB:    return CMD_LOAD_US;
+    case CMD_WRITE_CONFIG:          return CMD_WRITE_US;
+    case CMD_MEASURE:               return CMD_MEASURE_US;
+    case CMD_STOP:                  return CMD_STOP_US;
+    case CMD_FACTORY_CALIB:         return CMD_FACTORY_CALIB_US;
+    case CMD_I2C_SLAVE_ADDRESS:     return CMD_I2C_SLAVE_ADDRESS_US;
+    case CMD_SWITCH_TMF8821_MODE:
+    case CMD_SWITCH_TMF8828_MODE:   return CMD_SWITCH_MODE_US;
+    default:                        return CMD_DEFAULT_US;
+  }
+}
+
+// a write to CMD_STAT starts a command, until it is done the register reads back the command
+static void tmf882xSimStartCommand ( tmf882xSim * sim, const uint8_t * data, uint16_t len, uint64_t nowUs )
+{
+  if ( len > sizeof( sim->cmdFrame ) )
+  {
+    len = sizeof( sim->cmdFrame );
+  }
+  memset( sim->cmdFrame, 0, sizeof( sim->cmdFrame ) );
+  memcpy( sim->cmdFrame, data, len );
+  if ( sim->state == TMF882X_SIM_BOOTLOADER && ( len < BL_HEADER + 1 || len != BL_HEADER + data[1] + 1 ) )
+  {
+    sim->reg[ REG_CMD_STAT ] = BL_STAT_ERR_SIZE;
+    return;
+  }
+  sim->cmd = data[0];
+  sim->cmdDoneUs = nowUs + tmf882xSimCommandTime( sim->state, sim->cmd );
+  sim->reg[ REG_CMD_STAT ] = sim->cmd;
+  sim->stats.commands++;
+}
+
+static void tmf882xSimWriteEnable ( tmf882xSim * sim, uint8_t value, uint64_t nowUs )
+{
+  if ( value & ENABLE_CPU_RESET )
+  {
+    tmf882xSimBoot( sim, nowUs );
+    return;
+  }
+  sim->reg[ REG_ENABLE ] = value & ~ENABLE_CPU_READY;
+  if ( sim->state == TMF882X_SIM_STANDBY && ( value & ENABLE_PON ) )
+  {
+    if ( sim->appInRam )
+    {
+      sim->state = TMF882X_SIM_APP;
+      sim->cpuReadyUs = nowUs + CPU_READY_US;
+    }
+    else
+    {
+      tmf882xSimBoot( sim, nowUs );
+    }
+  }
+  else if ( sim->state != TMF882X_SIM_STANDBY && !( value & ENABLE_PON ) )
+  {
+    sim->state = TMF882X_SIM_STANDBY;
+    sim->measuring = 0;
+    sim->cmd = 0;
+    tmf882xSimClearQueue( sim );
+  }
+}
+
+// a NAK fault ends by itself, it does not need an event of its own
+static uint8_t tmf882xSimAnswers ( tmf882xSim * sim, uint8_t slaveAddr, uint64_t nowUs )
+{
+  if ( sim->state == TMF882X_SIM_OFF || slaveAddr != sim->slaveAddr )
+  {
+    return 0;
+  }
+  if ( sim->fault == TMF882X_SIM_FAULT_NAK )
+  {
+    if ( nowUs < sim->faultUntilUs )
+    {
+      sim->stats.naks++;
+      return 0;
+    }
+    sim->fault = TMF882X_SIM_FAULT_NONE;
+  }
+  return 1;
+}
+
+void tmf882xSimInitialise ( tmf882xSim * sim, uint32_t serialNumber )
+{
+  memset( sim, 0, sizeof( *sim ) );
+  sim->serialNumber = serialNumber;
+  sim->state = TMF882X_SIM_OFF;
+  sim->slaveAddr = TMF882X_SIM_SLAVE_ADDR;
+}
+
+void tmf882xSimSetScene ( tmf882xSim * sim, tmf882xSimSceneFn scene, void * context )
+{
+  sim->scene = scene;
+  sim->sceneContext = context;
+}
+
+void tmf882xSimSetEnable ( tmf882xSim * sim, uint8_t high, uint64_t nowUs )
+{
+  tmf882xSimRun( sim, nowUs );
+  if ( !high )
+  {
+    sim->state = TMF882X_SIM_OFF;
+    sim->appInRam = 0;
+    sim->measuring = 0;
+    sim->cmd = 0;
+    sim->fault = TMF882X_SIM_FAULT_NONE;
+    tmf882xSimClearQueue( sim );
+  }
+  else if ( sim->state == TMF882X_SIM_OFF )
+  {
+    tmf882xSimPowerOn( sim );
+  }
+}
+
+uint8_t tmf882xSimWrite ( tmf882xSim * sim, uint8_t slaveAddr, uint8_t regAddr, const uint8_t * data, uint16_t len, uint64_t nowUs )
+{
+  uint16_t i;
+  tmf882xSimRun( sim, nowUs );
+  if ( !tmf882xSimAnswers( sim, slaveAddr, nowUs ) )
+  {
+    return 0;
+  }
+  if ( regAddr == REG_CMD_STAT && len && sim->state >= TMF882X_SIM_BOOTLOADER )
+  {
+    tmf882xSimStartCommand( sim, data, len, nowUs );
+    return 1;
+  }
+  for ( i = 0; i < len && regAddr + i < 0x100; i++ )
+  {
+    uint8_t r = (uint8_t)( regAddr + i );
+    switch ( r )
+    {
+      case REG_ENABLE:
+        tmf882xSimWriteEnable( sim, data[i], nowUs );
+        break;
+      case REG_INT_STATUS:
+        if ( sim->published & data[i] & sim->reg[ REG_INT_STATUS ] )
+        {
+          sim->ackUs = nowUs;
+        }
+        sim->reg[ REG_INT_STATUS ] &= ~data[i];
+        break;
+      case REG_RESETREASON:
+        if ( ( data[i] & RESETREASON_SOFT_RESET ) && sim->state != TMF882X_SIM_STANDBY )
+        {
+          sim->reg[ REG_RESETREASON ] = RESETREASON_RRSN_SOFT_RESET;
+          tmf882xSimBoot( sim, nowUs );
+        }
+        break;
+      case REG_INT_ENAB:
+      case REG_CLOCK:
+        sim->reg[ r ] = data[i];
+        break;
+      default:
+        if ( sim->state == TMF882X_SIM_APP && r >= REG_WINDOW && r < REG_WINDOW + TMF882X_SIM_PAGE_SIZE )
+        {
+          sim->reg[ r ] = data[i];
+        }
+        break;
+    }
+  }
+  tmf882xSimPublish( sim, nowUs );
+  return 1;
+}
+
+uint8_t tmf882xSimRead ( tmf882xSim * sim, uint8_t slaveAddr, uint8_t regAddr, uint8_t * data, uint16_t len, uint64_t nowUs )
+{
+  uint16_t i;
+  tmf882xSimRun( sim, nowUs );
+  if ( !tmf882xSimAnswers( sim, slaveAddr, nowUs ) )
+  {
+    return 0;
+  }
+  for ( i = 0; i < len; i++ )
+  {
+    uint8_t r = (uint8_t)( regAddr + i );                 // the register address wraps around
+    if ( r == REG_ENABLE )
+    {
+      data[i] = sim->reg[ REG_ENABLE ] & ~ENABLE_CPU_READY;
+      if ( sim->state != TMF882X_SIM_STANDBY && nowUs >= sim->cpuReadyUs )
+      {
+        data[i] |= ENABLE_CPU_READY;
+      }
+    }
+    else if ( sim->state == TMF882X_SIM_STANDBY && r < REG_ENABLE )
+    {
+      data[i] = 0;
+    }
+    else
+    {
+      data[i] = sim->reg[ r ];
+    }
+    if ( r == REG_WINDOW && sim->published )
+    {
+      sim->publishedRead = 1;
+    }
+  }
+  tmf882xSimPublish( sim, nowUs );
+  return 1;
+}
+
+void tmf882xSimRun ( tmf882xSim * sim, uint64_t nowUs )
+{
+  while ( sim->state >= TMF882X_SIM_BOOTLOADER )
+  {
+    uint64_t cmdUs = ( sim->cmd ? sim->cmdDoneUs : TMF882X_SIM_NEVER );
+    uint64_t captureUs = ( sim->measuring ? sim->nextCaptureUs : TMF882X_SIM_NEVER );
+    if ( cmdUs <= nowUs && cmdUs <= captureUs )
+    {
+      uint8_t cmd = sim->cmd;
+      sim->cmd = 0;
+      if ( sim->state == TMF882X_SIM_BOOTLOADER )
+      {
+        tmf882xSimBootloaderCommand( sim );
+      }
+      else
+      {
+        tmf882xSimAppCommand( sim, cmd, cmdUs );
+      }
+    }
+    else if ( captureUs <= nowUs )
+    {
+      tmf882xSimCapture( sim, captureUs );
+    }
+    else
+    {
+      break;
+    }
+  }
+  if ( sim->fault == TMF882X_SIM_FAULT_HANG && nowUs >= sim->faultUntilUs )
+  {
+    sim->fault = TMF882X_SIM_FAULT_NONE;
+  }
+  tmf882xSimPublish( sim, nowUs );
+}
+
+uint64_t tmf882xSimNextEvent ( const tmf882xSim * sim )
+{
+  uint64_t next = TMF882X_SIM_NEVER;
+  if ( sim->state < TMF882X_SIM_BOOTLOADER )
+  {
+    return next;
+  }
+  if ( sim->cmd && sim->cmdDoneUs < next )
+  {
+    next = sim->cmdDoneUs;
+  }
+  if ( sim->measuring && sim->nextCaptureUs < next )
+  {
+    next = sim->nextCaptureUs;
+  }
+  if (  sim->published && !sim->publishedRead && sim->queueCount 
+     && !( sim->reg[ REG_INT_STATUS ] & sim->published ) && sim->ackUs + ACK_TIMEOUT_US < next )
+  {
+    next = sim->ackUs + ACK_TIMEOUT_US;
+  }
+  if ( sim->fault == TMF882X_SIM_FAULT_HANG && sim->faultUntilUs < next )
+  {
+    next = sim->faultUntilUs;
+  }
+  return next;
+}
+
+uint8_t tmf882xSimInterruptLine ( const tmf882xSim * sim )
+{
+  return !( sim->state == TMF882X_SIM_APP && ( sim->reg[ REG_INT_STATUS ] & sim->reg[ REG_INT_ENAB ] ) );
+}
+
+void tmf882xSimInjectFault ( tmf882xSim * sim, uint8_t fault, uint32_t durationUs, uint64_t nowUs )
+{
+  tmf882xSimRun( sim, nowUs );
+  sim->fault = fault;
+  sim->faultUntilUs = nowUs + durationUs;
+  if ( fault == TMF882X_SIM_FAULT_BROWNOUT && sim->state != TMF882X_SIM_OFF )
+  {
+    uint8_t enable = sim->reg[ REG_ENABLE ];
+    tmf882xSimPowerOn( sim );
+    sim->reg[ REG_ENABLE ] = enable;
+    tmf882xSimBoot( sim, nowUs );
+  }
+}
@@ -0,0 +1,194 @@
+/*
+ *****************************************************************************
+ * Copyright by ams OSRAM AG                                                       *
+ * All rights are reserved.                                                  *
+ *                                                                           *
+ * IMPORTANT - PLEASE READ CAREFULLY BEFORE COPYING, INSTALLING OR USING     *
+ * THE SOFTWARE.                                                             *
+ *                                                                           *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       *
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         *
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS         *
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT  *
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,     *
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT          *
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     *
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY     *
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT       *
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE     *
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.      *
+ *****************************************************************************
+ */
+
+#ifndef TMF882X_SIM_H
+#define TMF882X_SIM_H
+
+/** @file Register level model of a tmf8828/tmf882x for the host build.
+ * The model answers i2c register reads and writes the way the device does: the bootloader with its 
+ * RAM download commands, the measurement application with config and factory calibration pages, the 
+ * mode switch, the i2c address change, result pages with the sub-capture numbering of the 8x8 mode and 
+ * raw histogram sub-packets. Commands take time, results are produced at the configured period and are
+ * signalled on the (active low) interrupt line. Time is given by the caller in microseconds, the model 
+ * itself never waits, so it runs as fast as the host can execute the driver.
+ * The distances of the zones come from a scene callback, faults can be injected to exercise the recovery.
+ */
+
+// ---------------------------------------------- includes ----------------------------------------
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  
+
+// ---------------------------------------------- defines -----------------------------------------
+
+#define TMF882X_SIM_SLAVE_ADDR            0x41  /**< i2c address after enable */
+#define TMF882X_SIM_MAX_ZONES             64
+#define TMF882X_SIM_TARGETS               2
+#define TMF882X_SIM_PAGE_SIZE             0xC0  /**< config and calibration pages, 0x20..0xDF */
+#define TMF882X_SIM_CALIB_PAGES           4     /**< one per 8x8 sub-capture */
+#define TMF882X_SIM_PACKET_SIZE           ( 4 + 3 + 128 )   /**< largest packet, a histogram sub-packet */
+#define TMF882X_SIM_QUEUE                 40    /**< packets of one result with all its histograms fit */
+#define TMF882X_SIM_NEVER                 UINT64_MAX
+
+/** device states */
+#define TMF882X_SIM_OFF                   0     /**< enable pin low, does not answer */
+#define TMF882X_SIM_STANDBY               1     /**< PON=0, only the registers from 0xE0 answer */
+#define TMF882X_SIM_BOOTLOADER            2
+#define TMF882X_SIM_APP                   3     /**< measurement application running from RAM */
+
+/** faults, see tmf882xSimInjectFault */
+#define TMF882X_SIM_FAULT_NONE            0
+#define TMF882X_SIM_FAULT_NAK             1     /**< the device does not acknowledge its address */
+#define TMF882X_SIM_FAULT_HANG            2     /**< the application answers but produces no results */
+#define TMF882X_SIM_FAULT_BROWNOUT        3     /**< the device falls back to the bootloader, the application is lost */
+
+// ---------------------------------------------- types -------------------------------------------
+
+/** @brief Fills the true distance (mm, 0 = no target) and confidence of both targets of every zone. Zones
+ * are numbered row by row as in tmf8828Frame.
+ */
+typedef void (* tmf882xSimSceneFn)( void * context, uint64_t timeUs, uint8_t rows, uint8_t cols, 
+                                    uint16_t distance[ TMF882X_SIM_TARGETS ][ TMF882X_SIM_MAX_ZONES ], 
+                                    uint8_t confidence[ TMF882X_SIM_TARGETS ][ TMF882X_SIM_MAX_ZONES ] );
+
+typedef struct _tmf882xSimPacket
+{
+  uint8_t intMask;                                  /**< INT_STATUS bit raised when the packet is published */
+  uint8_t len;
+  uint8_t data[ TMF882X_SIM_PACKET_SIZE ];          /**< content of the registers from 0x20 */
+} tmf882xSimPacket;
+
+typedef struct _tmf882xSimStatistics
+{
+  uint32_t commands;                                /**< application and bootloader commands executed */
+  uint32_t downloadBytes;                           /**< image bytes written to RAM */
+  uint32_t results;                                 /**< result pages produced */
+  uint32_t histograms;                              /**< histogram sub-packets produced */
+  uint32_t dropped;                                 /**< packets lost because the host did not read them in time */
+  uint32_t naks;                                    /**< transfers not acknowledged */
+} tmf882xSimStatistics;
+
+typedef struct _tmf882xSim
+{
+  // set up by the caller
+  uint32_t serialNumber;
+  int32_t clockErrorPpm;                            /**< the device oscillator runs this much faster than the host */
+  tmf882xSimSceneFn scene;
+  void * sceneContext;
+
+  uint8_t state;                                    /**< TMF882X_SIM_* */
+  uint8_t slaveAddr;
+  uint8_t reg[ 256 ];                               /**< i2c register file */
+  uint64_t cpuReadyUs;                              /**< cpu_ready is set from this time on */
+
+  // bootloader
+  uint16_t ramAddr;
+  uint32_t ramBytes;                                /**< bytes downloaded since the last reset */
+  uint8_t appInRam;                                 /**< a standby keeps the application, a reset does not */
+
+  // command in execution
+  uint8_t cmd;                                      /**< 0 if idle */
+  uint8_t cmdFrame[ 3 + 128 ];                      /**< bootloader command as written */
+  uint64_t cmdDoneUs;
+
+  // application
+  uint8_t config[ TMF882X_SIM_PAGE_SIZE ];          /**< common config page */
+  uint8_t calib[ TMF882X_SIM_CALIB_PAGES ][ TMF882X_SIM_PAGE_SIZE ];
+  uint8_t calibIdx;                                 /**< calibration page the next load command shows */
+  uint8_t calibLoaded;                              /**< calibration page in the register window */
+  uint8_t pageLoaded;                               /**< load command of the page in the window, 0 if none */
+  uint8_t mode8x8;
+
+  // measurement
+  uint8_t measuring;
+  uint8_t resultNumber;
+  uint64_t nextCaptureUs;
+
+  // packets waiting for the host, the oldest one is in the register window once published
+  tmf882xSimPacket queue[ TMF882X_SIM_QUEUE ];
+  uint8_t queueHead;
+  uint8_t queueCount;
+  uint8_t published;                                /**< INT_STATUS bit of the packet in the window, 0 if none */
+  uint8_t publishedRead;                            /**< the host read the packet */
+  uint64_t ackUs;                                   /**< time the host cleared the interrupt of the packet */
+
+  // fault injection
+  uint8_t fault;                                    /**< TMF882X_SIM_FAULT_* */
+  uint64_t faultUntilUs;
+
+  tmf882xSimStatistics stats;
+} tmf882xSim;
+
+// ---------------------------------------------- functions ---------------------------------------
+
+/** @brief Initialises the model of a powered off device
+ * @param[in] sim ... model instance
+ * @param[in] serialNumber ... reported in the SERIAL_NUMBER registers, also seeds the calibration data
+ */
+void tmf882xSimInitialise( tmf882xSim * sim, uint32_t serialNumber );
+
+/** @brief Sets the function that provides the distances of the zones
+ */
+void tmf882xSimSetScene( tmf882xSim * sim, tmf882xSimSceneFn scene, void * context );
+
+/** @brief Drives the enable pin. A falling edge powers the device off and all state is lost, a rising 
+ * edge brings it up in standby with the bootloader at TMF882X_SIM_SLAVE_ADDR.
+ */
+void tmf882xSimSetEnable( tmf882xSim * sim, uint8_t high, uint64_t nowUs );
+
+/** @brief i2c write of len bytes to regAddr.
+ * \return 1 if the device acknowledged its address, 0 if not (or if it is not addressed)
+ */
+uint8_t tmf882xSimWrite( tmf882xSim * sim, uint8_t slaveAddr, uint8_t regAddr, const uint8_t * data, uint16_t len, uint64_t nowUs );
+
+/** @brief i2c read of len bytes from regAddr.
+ * \return 1 if the device acknowledged its address and filled data, 0 if not
+ */
+uint8_t tmf882xSimRead( tmf882xSim * sim, uint8_t slaveAddr, uint8_t regAddr, uint8_t * data, uint16_t len, uint64_t nowUs );
+
+/** @brief Executes everything that is due until nowUs: finished commands, captures, publishing of packets.
+ * Call it with a non-decreasing time, at least at every time returned by tmf882xSimNextEvent.
+ */
+void tmf882xSimRun( tmf882xSim * sim, uint64_t nowUs );
+
+/** @brief Time of the next internal event, TMF882X_SIM_NEVER if the device waits for the host
+ */
+uint64_t tmf882xSimNextEvent( const tmf882xSim * sim );
+
+/** @brief Level of the open drain interrupt line
+ * \return 0 if the device pulls the line low (an enabled interrupt is pending), 1 else
+ */
+uint8_t tmf882xSimInterruptLine( const tmf882xSim * sim );
+
+/** @brief Injects a fault. NAK lasts for durationUs, HANG until durationUs passed or the measurement is 
+ * started again, a brown-out happens at once and lasts until the host downloads the firmware again.
+ */
+void tmf882xSimInjectFault( tmf882xSim * sim, uint8_t fault, uint32_t durationUs, uint64_t nowUs );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TMF882X_SIM_H